@@ -5,6 +5,7 @@
 
 #include "AdsDef.h"
 
+#include <algorithm>
 #include <ostream>
 #include <sstream>
 #include <stdlib.h>
@@ -52,3 +53,73 @@ AmsNetId make_AmsNetId(const std::string &addr)
 	}
 	return id;
 }
+
+namespace bhf
+{
+namespace ads
+{
+/** values below 2 * SUB_BUCKETS get a bucket of their own */
+static size_t BucketIndex(uint64_t value)
+{
+	const auto linear = 2 * LatencyHistogram::SUB_BUCKETS;
+	if (value < linear) {
+		return static_cast<size_t>(value);
+	}
+	size_t shift = 0;
+	while ((value >> shift) >= linear) {
+		++shift;
+	}
+	const auto index =
+		shift * LatencyHistogram::SUB_BUCKETS + (value >> shift);
+	return std::min(index, LatencyHistogram::NUM_BUCKETS - 1);
+}
+
+static uint64_t BucketUpperBound(size_t index)
+{
+	const auto linear = 2 * LatencyHistogram::SUB_BUCKETS;
+	if (index < linear) {
+		return index;
+	}
+	const auto shift = index / LatencyHistogram::SUB_BUCKETS - 1;
+	const uint64_t sub = index % LatencyHistogram::SUB_BUCKETS +
+			     LatencyHistogram::SUB_BUCKETS;
+	return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(const uint64_t usec)
+{
+	++buckets[BucketIndex(usec)];
+	min = count ? std::min(min, usec) : usec;
+	max = std::max(max, usec);
+	sum += usec;
+	++count;
+}
+
+void LatencyHistogram::Add(const LatencyHistogram &other)
+{
+	if (!other.count) {
+		return;
+	}
+	for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+		buckets[i] += other.buckets[i];
+	}
+	min = count ? std::min(min, other.min) : other.min;
+	max = std::max(max, other.max);
+	sum += other.sum;
+	count += other.count;
+}
+
+uint64_t LatencyHistogram::Percentile(const double percentile) const
+{
+	const auto rank = static_cast<uint64_t>(percentile / 100 * count);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+		seen += buckets[i];
+		if (seen > rank) {
+			return std::min(BucketUpperBound(i), max);
+		}
+	}
+	return max;
+}
+}
+}
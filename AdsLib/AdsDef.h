@@ -11,6 +11,7 @@
 #include "standalone/AdsDef.h"
 #endif
 
+#include <array>
 #include <iosfwd>
 bool operator<(const AmsNetId &lhs, const AmsNetId &rhs);
 bool operator<(const AmsAddr &lhs, const AmsAddr &rhs);
@@ -24,5 +25,91 @@ namespace ads
 enum nSystemServiceOpenFile : uint32_t {
 	SYSTEMSERVICE_OPENGENERIC /*[[deprecated]]*/ = 1,
 };
+
+/**
+ * What happens to a notification frame, which doesn't fit into the
+ * notification buffer anymore, because the callbacks fall behind.
+ */
+enum NotificationOverflow : uint32_t {
+	/** drop the new frame */
+	NOTIFICATION_DROP_NEWEST = 0,
+	/** drop the oldest frames, which weren't dispatched yet */
+	NOTIFICATION_DROP_OLDEST = 1,
+	/** stop receiving, until the callbacks caught up */
+	NOTIFICATION_BLOCK = 2,
+	/** exceed the capacity of the buffer */
+	NOTIFICATION_GROW = 3,
+};
+
+/**
+ * Priority of the requests of an Ads port on their way to the ADS server.
+ * Requests waiting to be sent over a connection are sent by class, requests
+ * of the same class in order.
+ */
+enum TrafficClass : uint32_t {
+	/** control writes and setpoints, which have to pass in bounded time */
+	TRAFFIC_REALTIME = 0,
+	/** default of all ports */
+	TRAFFIC_INTERACTIVE = 1,
+	/** file transfers, uploads and other large requests */
+	TRAFFIC_BULK = 2,
+};
+static const size_t NUM_TRAFFIC_CLASSES = 3;
+
+struct NotificationBufferConfig {
+	/** number of bytes, which may be queued for the callbacks */
+	size_t capacity;
+	NotificationOverflow overflow;
+};
+
+struct NotificationStats {
+	/** frames lost, because the buffer was full */
+	uint64_t droppedFrames;
+	uint64_t droppedBytes;
+	/** highest number of bytes queued at once */
+	uint64_t maxQueuedBytes;
+};
+
+/**
+ * Histogram of latencies in microseconds. Like HdrHistogram every power of
+ * two is split into equally sized buckets, so the recorded values keep a
+ * relative precision of 1/16 from a microsecond up to more than an hour.
+ */
+struct LatencyHistogram {
+	static const size_t SUB_BUCKETS = 16;
+	static const size_t NUM_BUCKETS = 30 * SUB_BUCKETS;
+
+	std::array<uint64_t, NUM_BUCKETS> buckets{};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t min = 0;
+	uint64_t max = 0;
+
+	void Record(uint64_t usec);
+	void Add(const LatencyHistogram &other);
+
+	/**
+	 * @param[in] percentile in the range 0.0 to 100.0
+	 * @return upper bound of the bucket containing the percentile, 0 if empty
+	 */
+	uint64_t Percentile(double percentile) const;
+};
+
+/**
+ * Latencies of the requests with one command id to one ADS server. Only
+ * requests, which received a response, are recorded.
+ */
+struct RequestLatency {
+	AmsAddr target;
+	uint16_t cmdId;
+	/** from issuing the request until it was written to the socket */
+	LatencyHistogram send;
+	/** from issuing the request until the receiver matched its response */
+	LatencyHistogram response;
+	/** from matching the response until the waiting thread woke up or the completion was invoked */
+	LatencyHistogram wakeup;
+	/** from issuing the request until the waiting thread woke up or the completion was invoked */
+	LatencyHistogram total;
+};
 }
 }
@@ -6,7 +6,10 @@
 #include "AdsDevice.h"
 #include "AdsException.h"
 #include "AdsLib.h"
+#include "SymbolHandleCache.h"
+#include <cstring>
 #include <limits>
+#include <mutex>
 
 static AmsNetId *AddRoute(AmsNetId ams, const char *ip)
 {
@@ -17,6 +20,101 @@ static AmsNetId *AddRoute(AmsNetId ams, const char *ip)
 	return new AmsNetId{ ams };
 }
 
+static void InvokeCompletion(long errorCode, uint32_t bytesRead,
+			     void *pContext)
+{
+	const std::unique_ptr<AdsDevice::Completion> completion{
+		static_cast<AdsDevice::Completion *>(pContext)
+	};
+	(*completion)(errorCode, bytesRead);
+}
+
+template <typename T> struct Fulfill;
+
+template <> struct Fulfill<uint32_t> {
+	static void Value(std::promise<uint32_t> &promise, uint32_t bytesRead)
+	{
+		promise.set_value(bytesRead);
+	}
+};
+
+template <> struct Fulfill<void> {
+	static void Value(std::promise<void> &promise, uint32_t)
+	{
+		promise.set_value();
+	}
+};
+
+template <typename T>
+static std::future<T> MakeFuture(
+	const std::function<long(AdsDevice::Completion)> &asyncRequest)
+{
+	const auto promise = std::make_shared<std::promise<T> >();
+	auto future = promise->get_future();
+	const auto error =
+		asyncRequest([promise](long errorCode, uint32_t bytesRead) {
+			if (errorCode) {
+				promise->set_exception(std::make_exception_ptr(
+					AdsException(errorCode)));
+			} else {
+				Fulfill<T>::Value(*promise, bytesRead);
+			}
+		});
+	if (error) {
+		throw AdsException(error);
+	}
+	return future;
+}
+
+static void AppendLe(std::vector<uint8_t> &buffer, const uint32_t value)
+{
+	const auto le = bhf::ads::htole(value);
+	const auto bytes = reinterpret_cast<const uint8_t *>(&le);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(le));
+}
+
+/**
+ * Split items into chunks, which fit into one sum command, and pass them to
+ * request() together with the expected sizes of the request and response
+ * data. The sizes returned by requestSize() and responseSize() include the
+ * per item overhead of the sum command.
+ */
+template <typename Item, typename RequestSize, typename ResponseSize,
+	  typename Request>
+static long ForEachSumChunk(std::vector<Item> &items,
+			    const size_t maxFrameSize,
+			    RequestSize requestSize, ResponseSize responseSize,
+			    Request request)
+{
+	auto first = items.begin();
+	while (first != items.end()) {
+		auto last = first;
+		size_t requestBytes = 0;
+		size_t responseBytes = 0;
+		do {
+			requestBytes += requestSize(*last);
+			responseBytes += responseSize(*last);
+			++last;
+		} while ((last != items.end()) &&
+			 (static_cast<size_t>(last - first) <
+			  SUM_COMMAND_MAX_ITEMS) &&
+			 (requestBytes + requestSize(*last) <= maxFrameSize) &&
+			 (responseBytes + responseSize(*last) <= maxFrameSize));
+
+		const long error =
+			request(&*first, static_cast<size_t>(last - first),
+				requestBytes, responseBytes);
+		if (error) {
+			for (; first != items.end(); ++first) {
+				first->error = error;
+			}
+			return error;
+		}
+		first = last;
+	}
+	return 0;
+}
+
 AdsDevice::AdsDevice(const std::string &ipV4, AmsNetId netId, uint16_t port)
 	: m_NetId(AddRoute(netId, ipV4.c_str()), { [](AmsNetId ams) {
 			  bhf::ads::DelLocalRoute(ams);
@@ -24,6 +122,9 @@ AdsDevice::AdsDevice(const std::string &ipV4, AmsNetId netId, uint16_t port)
 		  } })
 	, m_Addr({ netId, port })
 	, m_LocalPort(new long{ AdsPortOpenEx() }, { AdsPortCloseEx })
+	, m_SymbolHandles(std::make_shared<bhf::ads::SymbolHandleCache>(
+		  *m_LocalPort, m_Addr))
+	, m_MaxFrameSize(DEFAULT_MAX_FRAME_SIZE)
 {
 }
 
@@ -85,6 +186,99 @@ AdsHandle AdsDevice::GetHandle(const std::string &symbolName) const
 			     std::placeholders::_1) } };
 }
 
+bhf::ads::SymbolHandleCache &AdsDevice::GetSymbolHandleCache() const
+{
+	return *m_SymbolHandles;
+}
+
+/**
+ * Symbol handles acquired by one GetHandles() call. While their AdsHandles
+ * are destroyed the handles are only collected. They are released together,
+ * when the last AdsHandle of the batch is gone.
+ */
+struct SymbolHandleBatch {
+	/* AdsDevice might be moved, so only its port and address are kept */
+	SymbolHandleBatch(const long __port, const AmsAddr &__addr,
+			  const size_t __maxFrameSize)
+		: port(__port)
+		, addr(__addr)
+		, maxFrameSize(__maxFrameSize)
+	{
+	}
+
+	~SymbolHandleBatch()
+	{
+		bhf::ads::ReleaseSymbolHandles(port, addr, handles,
+					       maxFrameSize);
+	}
+
+	long Add(const uint32_t handle)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handles.push_back(handle);
+		return 0;
+	}
+
+    private:
+	const long port;
+	const AmsAddr addr;
+	const size_t maxFrameSize;
+	std::mutex mutex;
+	std::vector<uint32_t> handles;
+};
+
+std::vector<AdsHandle>
+AdsDevice::GetHandles(const std::vector<std::string> &symbolNames) const
+{
+	std::vector<uint32_t> handles(symbolNames.size());
+	std::vector<ReadWriteItem> items;
+	items.reserve(symbolNames.size());
+	for (size_t i = 0; i < symbolNames.size(); ++i) {
+		items.push_back({ ADSIGRP_SYM_HNDBYNAME, 0, sizeof(handles[i]),
+				  &handles[i],
+				  static_cast<uint32_t>(symbolNames[i].size()),
+				  symbolNames[i].c_str() });
+	}
+
+	const auto error = SumReadWrite(items);
+	if (error) {
+		throw AdsException(error);
+	}
+
+	const auto batch = std::make_shared<SymbolHandleBatch>(
+		GetLocalPort(), m_Addr, m_MaxFrameSize);
+	const auto deleter = ResourceDeleter<uint32_t>{
+		[batch](uint32_t handle) { return batch->Add(handle); }
+	};
+	std::vector<AdsHandle> result;
+	result.reserve(items.size());
+	for (size_t i = 0; i < items.size(); ++i) {
+		if (!items[i].error &&
+		    (sizeof(handles[i]) == items[i].bytesRead)) {
+			result.emplace_back(
+				new uint32_t{ bhf::ads::letoh(handles[i]) },
+				deleter);
+		}
+	}
+
+	/* already acquired handles are released by the destructor of result */
+	for (const auto &item : items) {
+		if (item.error) {
+			throw AdsException(item.error);
+		}
+		if (sizeof(uint32_t) != item.bytesRead) {
+			throw AdsException(ADSERR_DEVICE_INVALIDSIZE);
+		}
+	}
+	return result;
+}
+
+long AdsDevice::ReleaseSymbolHandles(const std::vector<uint32_t> &handles) const
+{
+	return bhf::ads::ReleaseSymbolHandles(GetLocalPort(), m_Addr, handles,
+					      m_MaxFrameSize);
+}
+
 AdsHandle
 AdsDevice::GetHandle(const uint32_t indexGroup, const uint32_t indexOffset,
 		     const AdsNotificationAttrib &notificationAttributes,
@@ -148,6 +342,16 @@ void AdsDevice::SetTimeout(const uint32_t timeout) const
 	}
 }
 
+void AdsDevice::SetTrafficClass(
+	const bhf::ads::TrafficClass trafficClass) const
+{
+	const auto error =
+		bhf::ads::SetTrafficClass(GetLocalPort(), trafficClass);
+	if (error) {
+		throw AdsException(error);
+	}
+}
+
 uint32_t AdsDevice::GetTimeout() const
 {
 	uint32_t timeout = 0;
@@ -214,3 +418,316 @@ long AdsDevice::WriteReqEx(uint32_t group, uint32_t offset, size_t length,
 	return AdsSyncWriteReqEx(GetLocalPort(), &m_Addr, group, offset,
 				 static_cast<uint32_t>(length), buffer);
 }
+
+long AdsDevice::ReadReqAsync(uint32_t group, uint32_t offset, size_t length,
+			     void *buffer, Completion completion) const
+{
+	if (length > std::numeric_limits<uint32_t>::max()) {
+		return ADSERR_DEVICE_INVALIDSIZE;
+	}
+	std::unique_ptr<Completion> context{ new Completion{ completion } };
+	const auto error = AdsReadReqAsync(*m_LocalPort, &m_Addr, group, offset,
+					   static_cast<uint32_t>(length),
+					   buffer, InvokeCompletion,
+					   context.get());
+	if (!error) {
+		/* ownership was passed to InvokeCompletion() */
+		context.release();
+	}
+	return error;
+}
+
+long AdsDevice::ReadWriteReqAsync(uint32_t indexGroup, uint32_t indexOffset,
+				  size_t readLength, void *readData,
+				  size_t writeLength, const void *writeData,
+				  Completion completion) const
+{
+	if (readLength > std::numeric_limits<uint32_t>::max()) {
+		return ADSERR_DEVICE_INVALIDSIZE;
+	}
+	if (writeLength > std::numeric_limits<uint32_t>::max()) {
+		return ADSERR_DEVICE_INVALIDSIZE;
+	}
+	std::unique_ptr<Completion> context{ new Completion{ completion } };
+	const auto error = AdsReadWriteReqAsync(
+		*m_LocalPort, &m_Addr, indexGroup, indexOffset,
+		static_cast<uint32_t>(readLength), readData,
+		static_cast<uint32_t>(writeLength), writeData,
+		InvokeCompletion, context.get());
+	if (!error) {
+		/* ownership was passed to InvokeCompletion() */
+		context.release();
+	}
+	return error;
+}
+
+long AdsDevice::WriteReqAsync(uint32_t group, uint32_t offset, size_t length,
+			      const void *buffer, Completion completion) const
+{
+	if (length > std::numeric_limits<uint32_t>::max()) {
+		return ADSERR_DEVICE_INVALIDSIZE;
+	}
+	std::unique_ptr<Completion> context{ new Completion{ completion } };
+	const auto error = AdsWriteReqAsync(*m_LocalPort, &m_Addr, group,
+					    offset,
+					    static_cast<uint32_t>(length),
+					    buffer, InvokeCompletion,
+					    context.get());
+	if (!error) {
+		/* ownership was passed to InvokeCompletion() */
+		context.release();
+	}
+	return error;
+}
+
+std::future<uint32_t> AdsDevice::ReadReqAsync(uint32_t group, uint32_t offset,
+					      size_t length,
+					      void *buffer) const
+{
+	return MakeFuture<uint32_t>([&](Completion completion) {
+		return ReadReqAsync(group, offset, length, buffer, completion);
+	});
+}
+
+std::future<uint32_t>
+AdsDevice::ReadWriteReqAsync(uint32_t indexGroup, uint32_t indexOffset,
+			     size_t readLength, void *readData,
+			     size_t writeLength, const void *writeData) const
+{
+	return MakeFuture<uint32_t>([&](Completion completion) {
+		return ReadWriteReqAsync(indexGroup, indexOffset, readLength,
+					 readData, writeLength, writeData,
+					 completion);
+	});
+}
+
+std::future<void> AdsDevice::WriteReqAsync(uint32_t group, uint32_t offset,
+					   size_t length,
+					   const void *buffer) const
+{
+	return MakeFuture<void>([&](Completion completion) {
+		return WriteReqAsync(group, offset, length, buffer, completion);
+	});
+}
+
+void AdsDevice::SetMaxFrameSize(const size_t maxFrameSize)
+{
+	m_MaxFrameSize = maxFrameSize;
+}
+
+long AdsDevice::SumRead(std::vector<ReadItem> &items) const
+{
+	return ForEachSumChunk(
+		items, m_MaxFrameSize,
+		[](const ReadItem &) { return 3 * sizeof(uint32_t); },
+		[](const ReadItem &item) {
+			return sizeof(uint32_t) + item.length;
+		},
+		[&](ReadItem *chunk, size_t count, size_t requestBytes,
+		    size_t responseBytes) -> long {
+			/* {list of IGrp, IOffs, Length} */
+			std::vector<uint8_t> request;
+			request.reserve(requestBytes);
+			for (size_t i = 0; i < count; ++i) {
+				AppendLe(request, chunk[i].indexGroup);
+				AppendLe(request, chunk[i].indexOffset);
+				AppendLe(request, chunk[i].length);
+			}
+
+			std::vector<uint8_t> response(responseBytes);
+			uint32_t bytesRead = 0;
+			const auto error = ReadWriteReqEx2(
+				ADSIGRP_SUMUP_READ, static_cast<uint32_t>(count),
+				response.size(), response.data(),
+				request.size(), request.data(), &bytesRead);
+			if (error) {
+				return error;
+			}
+			if (bytesRead < count * sizeof(uint32_t)) {
+				return ADSERR_DEVICE_INVALIDSIZE;
+			}
+
+			/* {list of results} followed by {list of data} */
+			size_t offset = count * sizeof(uint32_t);
+			for (size_t i = 0; i < count; ++i) {
+				auto &item = chunk[i];
+				item.error = bhf::ads::letoh<uint32_t>(
+					response.data() + i * sizeof(uint32_t));
+				if (offset + item.length > bytesRead) {
+					item.error = ADSERR_DEVICE_INVALIDSIZE;
+				} else if (!item.error) {
+					memcpy(item.buffer,
+					       response.data() + offset,
+					       item.length);
+				}
+				offset += item.length;
+			}
+			return 0;
+		});
+}
+
+long AdsDevice::SumWrite(std::vector<WriteItem> &items) const
+{
+	return bhf::ads::SumWrite(GetLocalPort(), m_Addr, items, m_MaxFrameSize);
+}
+
+long AdsDevice::SumReadWrite(std::vector<ReadWriteItem> &items) const
+{
+	return ForEachSumChunk(
+		items, m_MaxFrameSize,
+		[](const ReadWriteItem &item) {
+			return 4 * sizeof(uint32_t) + item.writeLength;
+		},
+		[](const ReadWriteItem &item) {
+			return 2 * sizeof(uint32_t) + item.readLength;
+		},
+		[&](ReadWriteItem *chunk, size_t count, size_t requestBytes,
+		    size_t responseBytes) -> long {
+			/* {list of IGrp, IOffs, RLength, WLength} followed by {list of data} */
+			std::vector<uint8_t> request;
+			request.reserve(requestBytes);
+			for (size_t i = 0; i < count; ++i) {
+				AppendLe(request, chunk[i].indexGroup);
+				AppendLe(request, chunk[i].indexOffset);
+				AppendLe(request, chunk[i].readLength);
+				AppendLe(request, chunk[i].writeLength);
+			}
+			for (size_t i = 0; i < count; ++i) {
+				const auto data = static_cast<const uint8_t *>(
+					chunk[i].writeData);
+				request.insert(request.end(), data,
+					       data + chunk[i].writeLength);
+			}
+
+			std::vector<uint8_t> response(responseBytes);
+			uint32_t bytesRead = 0;
+			const auto error = ReadWriteReqEx2(
+				ADSIGRP_SUMUP_READWRITE,
+				static_cast<uint32_t>(count), response.size(),
+				response.data(), request.size(),
+				request.data(), &bytesRead);
+			if (error) {
+				return error;
+			}
+			if (bytesRead < count * 2 * sizeof(uint32_t)) {
+				return ADSERR_DEVICE_INVALIDSIZE;
+			}
+
+			/* {list of results, RLength} followed by {list of data} */
+			size_t offset = count * 2 * sizeof(uint32_t);
+			for (size_t i = 0; i < count; ++i) {
+				auto &item = chunk[i];
+				const auto result =
+					response.data() + i * 2 * sizeof(uint32_t);
+				item.error = bhf::ads::letoh<uint32_t>(result);
+				item.bytesRead = bhf::ads::letoh<uint32_t>(
+					result + sizeof(uint32_t));
+				if ((item.bytesRead > item.readLength) ||
+				    (offset + item.bytesRead > bytesRead)) {
+					/* offsets of all following data are unknown */
+					for (; i < count; ++i) {
+						chunk[i].error =
+							ADSERR_DEVICE_INVALIDSIZE;
+						chunk[i].bytesRead = 0;
+					}
+					break;
+				}
+				if (!item.error) {
+					memcpy(item.readData,
+					       response.data() + offset,
+					       item.bytesRead);
+				}
+				offset += item.bytesRead;
+			}
+			return 0;
+		});
+}
+
+namespace bhf
+{
+namespace ads
+{
+long SumWrite(const long port, const AmsAddr &addr,
+	      std::vector<AdsDevice::WriteItem> &items,
+	      const size_t maxFrameSize)
+{
+	using WriteItem = AdsDevice::WriteItem;
+	return ForEachSumChunk(
+		items, maxFrameSize,
+		[](const WriteItem &item) {
+			return 3 * sizeof(uint32_t) + item.length;
+		},
+		[](const WriteItem &) { return sizeof(uint32_t); },
+		[&](WriteItem *chunk, size_t count, size_t requestBytes,
+		    size_t responseBytes) -> long {
+			/* {list of IGrp, IOffs, Length} followed by {list of data} */
+			std::vector<uint8_t> request;
+			request.reserve(requestBytes);
+			for (size_t i = 0; i < count; ++i) {
+				AppendLe(request, chunk[i].indexGroup);
+				AppendLe(request, chunk[i].indexOffset);
+				AppendLe(request, chunk[i].length);
+			}
+			for (size_t i = 0; i < count; ++i) {
+				const auto data = static_cast<const uint8_t *>(
+					chunk[i].buffer);
+				request.insert(request.end(), data,
+					       data + chunk[i].length);
+			}
+			if (request.size() >
+			    std::numeric_limits<uint32_t>::max()) {
+				return ADSERR_DEVICE_INVALIDSIZE;
+			}
+
+			std::vector<uint8_t> response(responseBytes);
+			uint32_t bytesRead = 0;
+			const auto error = AdsSyncReadWriteReqEx2(
+				port, &addr, ADSIGRP_SUMUP_WRITE,
+				static_cast<uint32_t>(count),
+				static_cast<uint32_t>(response.size()),
+				response.data(),
+				static_cast<uint32_t>(request.size()),
+				request.data(), &bytesRead);
+			if (error) {
+				return error;
+			}
+			if (bytesRead < response.size()) {
+				return ADSERR_DEVICE_INVALIDSIZE;
+			}
+
+			/* {list of results} */
+			for (size_t i = 0; i < count; ++i) {
+				chunk[i].error = bhf::ads::letoh<uint32_t>(
+					response.data() + i * sizeof(uint32_t));
+			}
+			return 0;
+		});
+}
+
+long ReleaseSymbolHandles(const long port, const AmsAddr &addr,
+			  const std::vector<uint32_t> &handles,
+			  const size_t maxFrameSize)
+{
+	std::vector<uint32_t> buffer;
+	std::vector<AdsDevice::WriteItem> items;
+	buffer.reserve(handles.size());
+	items.reserve(handles.size());
+	for (const auto handle : handles) {
+		buffer.push_back(bhf::ads::htole(handle));
+		items.push_back({ ADSIGRP_SYM_RELEASEHND, 0,
+				  sizeof(buffer.back()), &buffer.back() });
+	}
+
+	const auto error = SumWrite(port, addr, items, maxFrameSize);
+	if (error) {
+		return error;
+	}
+	for (const auto &item : items) {
+		if (item.error) {
+			return item.error;
+		}
+	}
+	return 0;
+}
+}
+}
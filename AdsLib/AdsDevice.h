@@ -10,7 +10,17 @@
 #include "wrap_endian.h"
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <memory>
+#include <vector>
+
+namespace bhf
+{
+namespace ads
+{
+struct SymbolHandleCache;
+}
+}
 
 /**
  * @brief Maximum size for device name.
@@ -28,6 +38,16 @@ struct DeviceInfo {
 	AdsVersion version;
 };
 
+/**
+ * @brief TwinCAT processes at most this number of sub requests per sum command.
+ */
+static const size_t SUM_COMMAND_MAX_ITEMS = 500;
+
+/**
+ * @brief Default limit for the size of request and response frames of sum commands.
+ */
+static const size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024;
+
 struct AdsDeviceState {
 	ADSSTATE ads;
 	ADSSTATE device;
@@ -54,6 +74,43 @@ using AdsResource = std::unique_ptr<T, ResourceDeleter<T> >;
 using AdsHandle = AdsResource<uint32_t>;
 
 struct AdsDevice {
+	/** Completion handler of asynchronous requests: (errorCode, bytesRead) */
+	using Completion = std::function<void(long, uint32_t)>;
+
+	/** Single sub request of SumRead() */
+	struct ReadItem {
+		uint32_t indexGroup;
+		uint32_t indexOffset;
+		uint32_t length;
+		void *buffer;
+		/** ADS return code of this item, written by SumRead() */
+		uint32_t error = 0;
+	};
+
+	/** Single sub request of SumWrite() */
+	struct WriteItem {
+		uint32_t indexGroup;
+		uint32_t indexOffset;
+		uint32_t length;
+		const void *buffer;
+		/** ADS return code of this item, written by SumWrite() */
+		uint32_t error = 0;
+	};
+
+	/** Single sub request of SumReadWrite() */
+	struct ReadWriteItem {
+		uint32_t indexGroup;
+		uint32_t indexOffset;
+		uint32_t readLength;
+		void *readData;
+		uint32_t writeLength;
+		const void *writeData;
+		/** ADS return code of this item, written by SumReadWrite() */
+		uint32_t error = 0;
+		/** number of bytes returned into readData */
+		uint32_t bytesRead = 0;
+	};
+
 	AdsDevice(const std::string &ipV4, AmsNetId netId, uint16_t port);
 
 	DeviceInfo GetDeviceInfo() const;
@@ -64,6 +121,25 @@ struct AdsDevice {
 	/** Get handle for access by symbol name */
 	AdsHandle GetHandle(const std::string &symbolName) const;
 
+	/**
+	 * Symbol handles shared by all AdsVariable and AdsNotification objects
+	 * of this device. In contrast to GetHandle() only the first lookup of
+	 * a symbol and the first one after an online change cost a round trip.
+	 */
+	bhf::ads::SymbolHandleCache &GetSymbolHandleCache() const;
+
+	/**
+	 * Get handles for many symbols at once with ADSIGRP_SUMUP_READWRITE.
+	 * The handles are not released one by one, but collected and released
+	 * together with a single sum command once the last of them is gone.
+	 * @throw AdsException with the error of the first symbol, which failed
+	 */
+	std::vector<AdsHandle>
+	GetHandles(const std::vector<std::string> &symbolNames) const;
+
+	/** Release many symbol handles with ADSIGRP_SUMUP_WRITE */
+	long ReleaseSymbolHandles(const std::vector<uint32_t> &handles) const;
+
 	/** Get notification handle */
 	AdsHandle GetHandle(uint32_t indexGroup, uint32_t indexOffset,
 			    const AdsNotificationAttrib &notificationAttributes,
@@ -82,6 +158,9 @@ struct AdsDevice {
 	uint32_t GetTimeout() const;
 	void SetTimeout(const uint32_t timeout) const;
 
+	/** Set the priority of all requests sent through this device */
+	void SetTrafficClass(bhf::ads::TrafficClass trafficClass) const;
+
 	long ReadReqEx2(uint32_t group, uint32_t offset, size_t length,
 			void *buffer, uint32_t *bytesRead) const;
 	long ReadWriteReqEx2(uint32_t indexGroup, uint32_t indexOffset,
@@ -91,12 +170,86 @@ struct AdsDevice {
 	long WriteReqEx(uint32_t group, uint32_t offset, size_t length,
 			const void *buffer) const;
 
+	/**
+	 * Asynchronous variants of the requests above. If they return 0, the
+	 * completion is invoked exactly once from the receiving thread of the
+	 * library, so it must not block. Buffers to read into have to stay
+	 * valid until then, write data is copied before the call returns.
+	 */
+	long ReadReqAsync(uint32_t group, uint32_t offset, size_t length,
+			  void *buffer, Completion completion) const;
+	long ReadWriteReqAsync(uint32_t indexGroup, uint32_t indexOffset,
+			       size_t readLength, void *readData,
+			       size_t writeLength, const void *writeData,
+			       Completion completion) const;
+	long WriteReqAsync(uint32_t group, uint32_t offset, size_t length,
+			   const void *buffer, Completion completion) const;
+
+	/**
+	 * Future based variants, the futures provide the number of bytes read
+	 * or throw an AdsException if the request failed.
+	 */
+	std::future<uint32_t> ReadReqAsync(uint32_t group, uint32_t offset,
+					   size_t length, void *buffer) const;
+	std::future<uint32_t> ReadWriteReqAsync(uint32_t indexGroup,
+						uint32_t indexOffset,
+						size_t readLength,
+						void *readData,
+						size_t writeLength,
+						const void *writeData) const;
+	std::future<void> WriteReqAsync(uint32_t group, uint32_t offset,
+					size_t length,
+					const void *buffer) const;
+
+	/**
+	 * Read many variables with as few ADSIGRP_SUMUP_READ requests as the
+	 * SUM_COMMAND_MAX_ITEMS and the maximum frame size limits allow.
+	 * @return error of the sum requests themselves. In that case all items
+	 *         of the failed and following requests get the same error.
+	 *         The results of the single reads are stored in ReadItem::error.
+	 */
+	long SumRead(std::vector<ReadItem> &items) const;
+
+	/** Like SumRead() but for writes using ADSIGRP_SUMUP_WRITE */
+	long SumWrite(std::vector<WriteItem> &items) const;
+
+	/** Like SumRead() but for read-writes using ADSIGRP_SUMUP_READWRITE */
+	long SumReadWrite(std::vector<ReadWriteItem> &items) const;
+
+	/**
+	 * Limit the size of the request and response frames of sum commands,
+	 * which is DEFAULT_MAX_FRAME_SIZE after construction.
+	 */
+	void SetMaxFrameSize(size_t maxFrameSize);
+
 	AdsResource<const AmsNetId> m_NetId;
 	const AmsAddr m_Addr;
 
     private:
 	AdsResource<const long> m_LocalPort;
+	/* declared after m_LocalPort, so it's destroyed while the port is open */
+	std::shared_ptr<bhf::ads::SymbolHandleCache> m_SymbolHandles;
+	size_t m_MaxFrameSize;
 	long CloseFile(uint32_t handle) const;
 	long DeleteNotificationHandle(uint32_t handle) const;
 	long DeleteSymbolHandle(uint32_t handle) const;
 };
+
+namespace bhf
+{
+namespace ads
+{
+/**
+ * AdsDevice::SumWrite() for users without an AdsDevice, which send with a
+ * port opened by AdsPortOpenEx() to the ADS server at addr.
+ */
+long SumWrite(long port, const AmsAddr &addr,
+	      std::vector<AdsDevice::WriteItem> &items,
+	      size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE);
+
+/** AdsDevice::ReleaseSymbolHandles() for users without an AdsDevice */
+long ReleaseSymbolHandles(long port, const AmsAddr &addr,
+			  const std::vector<uint32_t> &handles,
+			  size_t maxFrameSize = DEFAULT_MAX_FRAME_SIZE);
+}
+}
@@ -4,6 +4,7 @@
  */
 
 #include "AdsFile.h"
+#include <algorithm>
 #include <iostream>
 #include <list>
 
@@ -65,12 +66,18 @@ static bool FindFirst(const AdsDevice &route, TcFileFindData &item,
 }
 
 AdsFile::AdsFile(const AdsDevice &route, const std::string &filename,
-		 const uint32_t flags)
+		 const uint32_t flags, const size_t maxChunk)
 	: m_Route(route)
 	, m_Handle(route.OpenFile(filename, flags))
+	, m_MaxChunk(maxChunk)
 {
 }
 
+size_t AdsFile::Chunk(const size_t remaining) const
+{
+	return m_MaxChunk ? std::min(remaining, m_MaxChunk) : remaining;
+}
+
 void AdsFile::Delete(const AdsDevice &route, const std::string &filename,
 		     const uint32_t flags)
 {
@@ -127,20 +134,41 @@ int AdsFile::Find(const AdsDevice &route, const std::string &basePath,
 
 void AdsFile::Read(const size_t size, void *data, uint32_t &bytesRead) const
 {
-	auto error = m_Route.ReadWriteReqEx2(SYSTEMSERVICE_FREAD, *m_Handle,
-					     size, data, 0, nullptr,
-					     &bytesRead);
-
-	if (error) {
-		throw AdsException(error);
-	}
+	auto pos = static_cast<uint8_t *>(data);
+	bytesRead = 0;
+	do {
+		// FREAD continues at the file position, so chunks can follow each other
+		const auto chunk = Chunk(size - bytesRead);
+		uint32_t chunkRead = 0;
+		auto error = m_Route.ReadWriteReqEx2(SYSTEMSERVICE_FREAD,
+						     *m_Handle, chunk,
+						     pos + bytesRead, 0,
+						     nullptr, &chunkRead);
+
+		if (error) {
+			throw AdsException(error);
+		}
+		bytesRead += chunkRead;
+		if (chunkRead < chunk) {
+			// end of file
+			return;
+		}
+	} while (bytesRead < size);
 }
 
 void AdsFile::Write(const size_t size, const void *data) const
 {
-	auto error = m_Route.ReadWriteReqEx2(SYSTEMSERVICE_FWRITE, *m_Handle, 0,
-					     nullptr, size, data, nullptr);
-	if (error) {
-		throw AdsException(error);
-	}
+	auto pos = static_cast<const uint8_t *>(data);
+	size_t written = 0;
+	do {
+		const auto chunk = Chunk(size - written);
+		auto error = m_Route.ReadWriteReqEx2(SYSTEMSERVICE_FWRITE,
+						     *m_Handle, 0, nullptr,
+						     chunk, pos + written,
+						     nullptr);
+		if (error) {
+			throw AdsException(error);
+		}
+		written += chunk;
+	} while (written < size);
 }
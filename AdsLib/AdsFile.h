@@ -28,8 +28,13 @@ enum FOPEN : uint32_t {
 }
 
 struct AdsFile {
+	/**
+	 * @param[in] maxChunk if not 0, Read() and Write() split their data
+	 *            into requests of at most maxChunk bytes, so requests of
+	 *            higher traffic classes can be sent between them.
+	 */
 	AdsFile(const AdsDevice &route, const std::string &filename,
-		uint32_t flags);
+		uint32_t flags, size_t maxChunk = 0);
 	void Read(const size_t size, void *data, uint32_t &bytesRead) const;
 	void Write(const size_t size, const void *data) const;
 
@@ -41,4 +46,6 @@ struct AdsFile {
     private:
 	const AdsDevice &m_Route;
 	const AdsHandle m_Handle;
+	const size_t m_MaxChunk;
+	size_t Chunk(size_t remaining) const;
 };
@@ -11,8 +11,12 @@
 #include "standalone/AdsLib.h"
 #endif
 
+#include "AdsDef.h"
+#include "Metrics.h"
 #include "Sockets.h"
 
+#include <vector>
+
 #ifdef BHF_ADS_EXPORT_C
 extern "C" {
 #endif
@@ -142,6 +146,66 @@ long AdsSyncDelDeviceNotificationReqEx(long port, const AmsAddr *pAddr,
  * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
  */
 long AdsSyncGetTimeoutEx(long port, uint32_t *timeout);
+
+/**
+ * Reads data asynchronously from an ADS server. The request is sent
+ * immediately, but the function returns without waiting for the response.
+ * If the request was sent successfully pFunc is called exactly once, either
+ * when the response arrived or after the timeout of the port expired. The
+ * callback is executed by the receiving thread of the library and must not
+ * block.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] bufferLength Length of the data in bytes.
+ * @param[out] buffer Pointer to a data buffer that will receive the data. It has to stay valid until pFunc was called.
+ * @param[in] pFunc Pointer to the callback function, which is invoked on completion.
+ * @param[in] pContext custom pointer passed to pFunc
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469), if it is not zero pFunc will never be called.
+ */
+long AdsReadReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+		     uint32_t indexOffset, uint32_t bufferLength, void *buffer,
+		     PAdsCompletionFunc pFunc, void *pContext);
+
+/**
+ * Writes data into an ADS server and receives data back from the ADS server
+ * asynchronously. See AdsReadReqAsync() for the completion semantics.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] readLength Length, in bytes, of the read buffer readData.
+ * @param[out] readData Buffer for data read from the ADS server. It has to stay valid until pFunc was called.
+ * @param[in] writeLength Length of the data, in bytes, send to the ADS server.
+ * @param[in] writeData Buffer with data send to the ADS server. It is copied before the function returns.
+ * @param[in] pFunc Pointer to the callback function, which is invoked on completion.
+ * @param[in] pContext custom pointer passed to pFunc
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469), if it is not zero pFunc will never be called.
+ */
+long AdsReadWriteReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+			  uint32_t indexOffset, uint32_t readLength,
+			  void *readData, uint32_t writeLength,
+			  const void *writeData, PAdsCompletionFunc pFunc,
+			  void *pContext);
+
+/**
+ * Writes data asynchronously to an ADS server. See AdsReadReqAsync() for the
+ * completion semantics.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] bufferLength Length of the data, in bytes, send to the ADS server.
+ * @param[in] buffer Buffer with data send to the ADS server. It is copied before the function returns.
+ * @param[in] pFunc Pointer to the callback function, which is invoked on completion.
+ * @param[in] pContext custom pointer passed to pFunc
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469), if it is not zero pFunc will never be called.
+ */
+long AdsWriteReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+		      uint32_t indexOffset, uint32_t bufferLength,
+		      const void *buffer, PAdsCompletionFunc pFunc,
+		      void *pContext);
 #ifdef BHF_ADS_EXPORT_C
 }
 #endif
@@ -158,12 +222,103 @@ namespace ads
  */
 long AddLocalRoute(AmsNetId ams, const char *ip);
 
+/**
+ * Add new ams route to target system, which uses several TCP connections.
+ * Requests are sent over the connection with the least bytes in flight, so
+ * small requests don't wait behind large transfers. Notifications are
+ * always subscribed on the first connection. The target has to accept
+ * several connections from the same AmsNetId, which a TwinCAT router doesn't.
+ * @param[in] ams address of the target system
+ * @param[in] ip address of the target system
+ * @param[in] numConnections number of TCP connections to open
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AddLocalRoute(AmsNetId ams, const char *ip,
+		   size_t numConnections);
+
 /**
  * Delete ams route that had previously been added with AddLocalRoute().
  * @param[in] ams address of the target system
  */
 void DelLocalRoute(AmsNetId ams);
 
+/**
+ * Receive the data of all connections with a fixed pool of epoll driven
+ * threads, instead of one thread per connection. This is only supported on
+ * Linux and has to be configured before the first route is added.
+ * @param[in] numThreads number of receive threads, 0 restores the default of one thread per connection
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long SetReactorThreads(size_t numThreads);
+
+/**
+ * Invoke the notification callbacks with a shared pool of threads, instead of
+ * one thread per local port and remote AmsAddr. The notifications of each of
+ * those pairs are still delivered in order. This has to be configured before
+ * the first route is added.
+ * @param[in] numThreads number of callback threads, 0 restores the default of one thread per local port and remote AmsAddr
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long SetNotificationThreads(size_t numThreads);
+
+/**
+ * Configure how many bytes of notifications are buffered for the callbacks of
+ * an Ads port and what happens, once they fall behind. The default is a
+ * capacity of 4 MiB and NOTIFICATION_DROP_NEWEST. The configuration applies
+ * to existing and future notifications of the port, until it is closed.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] config capacity and overflow policy of the buffer
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long SetNotificationBuffer(long port, const NotificationBufferConfig &config);
+
+/**
+ * Set the priority of the requests of an Ads port. While requests of several
+ * ports wait to be sent over the same connection, the ones of the highest
+ * class are sent first. Requests of the same port stay in order. The default
+ * is TRAFFIC_INTERACTIVE.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] trafficClass priority of the requests
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long SetTrafficClass(long port, TrafficClass trafficClass);
+
+/**
+ * Read the statistics of the notification buffer of an Ads port for the
+ * notifications from an ADS server.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] addr NetId and port number of the ADS server.
+ * @param[out] stats counters of dropped frames and the buffer usage
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long GetNotificationStats(long port, const AmsAddr &addr,
+			  NotificationStats &stats);
+
+/**
+ * Enable or disable recording the latency of every request into histograms
+ * per ADS server and command id. While disabled the overhead is a single
+ * atomic load per request. Enabling discards the histograms recorded so far.
+ * @param[in] enable true to start recording, false to stop it
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long SetLatencyTracing(bool enable);
+
+/**
+ * Read the latency histograms recorded since SetLatencyTracing() enabled it.
+ * @param[out] stats one entry for each ADS server and command id
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long GetLatencyStats(std::vector<RequestLatency> &stats);
+
+/**
+ * Read the counters of all requests, responses and notifications, which
+ * passed the router since the process was started. Use
+ * MetricsSnapshot::ToPrometheus() to export them to a monitoring system.
+ * @param[out] metrics copy of the counters
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long GetMetrics(MetricsSnapshot &metrics);
+
 /**
  * Change local NetId
  * @param[in] ams local AmsNetId
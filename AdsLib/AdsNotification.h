@@ -6,56 +6,61 @@
 #pragma once
 
 #include "AdsDef.h"
-#include "RingBuffer.h"
 
 #include <vector>
 
 using VirtualConnection = std::pair<uint16_t, AmsAddr>;
 
+/** ADD_DEVICE_NOTIFICATION parameters, to subscribe again after reconnects */
+struct NotificationSubscription {
+	uint32_t indexGroup;
+	uint32_t indexOffset;
+	AdsNotificationAttrib attrib;
+};
+
 struct Notification {
 	const VirtualConnection connection;
+	const NotificationSubscription subscription;
 
 	Notification(PAdsNotificationFuncEx __func, uint32_t __hUser,
-		     uint32_t length, AmsAddr __amsAddr, uint16_t __port)
+		     uint32_t length, AmsAddr __amsAddr, uint16_t __port,
+		     const NotificationSubscription &__subscription = {})
 		: connection({ __port, __amsAddr })
+		, subscription(__subscription)
 		, callback(__func)
-		, buffer(sizeof(AdsNotificationHeader) + length)
 		, hUser(__hUser)
 	{
-		auto header = reinterpret_cast<AdsNotificationHeader *>(
-			buffer.data());
-		header->hNotification = 0;
-		header->cbSampleSize = length;
+		header.hNotification = 0;
+		header.cbSampleSize = length;
 	}
 
-	void Notify(uint64_t timestamp, RingBuffer &ring)
+	/**
+	 * Invoke the callback with a sample, which is immediately followed by
+	 * its data, e.g. in place in the frame buffer of the dispatcher.
+	 */
+	void Notify(const AdsNotificationHeader *sample) const
 	{
-		auto header = reinterpret_cast<AdsNotificationHeader *>(
-			buffer.data());
-		uint8_t *data = reinterpret_cast<uint8_t *>(header + 1);
-		for (size_t i = 0; i < header->cbSampleSize; ++i) {
-			data[i] = ring.ReadFromLittleEndian<uint8_t>();
-		}
-		header->nTimeStamp = timestamp;
-		callback(&connection.second, header, hUser);
+		callback(&connection.second, sample, hUser);
 	}
 
 	uint32_t Size() const
 	{
-		auto header = reinterpret_cast<const AdsNotificationHeader *>(
-			buffer.data());
-		return header->cbSampleSize;
+		return header.cbSampleSize;
 	}
 
 	void hNotify(uint32_t value)
 	{
-		auto header = reinterpret_cast<AdsNotificationHeader *>(
-			buffer.data());
-		header->hNotification = value;
+		header.hNotification = value;
+	}
+
+	/** @return the handle, which was returned to the application */
+	uint32_t hNotify() const
+	{
+		return header.hNotification;
 	}
 
     private:
 	const PAdsNotificationFuncEx callback;
-	std::vector<uint8_t> buffer;
+	AdsNotificationHeader header;
 	const uint32_t hUser;
 };
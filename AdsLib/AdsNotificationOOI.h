@@ -6,6 +6,7 @@
 #pragma once
 
 #include "AdsDevice.h"
+#include "SymbolHandleCache.h"
 
 typedef void (*PAdsNotificationFuncExConst)(
 	const AmsAddr *pAddr, const AdsNotificationHeader *pNotification,
@@ -17,9 +18,10 @@ struct AdsNotification {
 	AdsNotification(const AdsDevice &route, const std::string &symbolName,
 			const AdsNotificationAttrib &notificationAttributes,
 			PAdsNotificationFuncExConst callback, uint32_t hUser)
-		: m_Symbol(route.GetHandle(symbolName))
+		: m_Symbol(new bhf::ads::SymbolHandleCache::Reference{
+			  route.GetSymbolHandleCache(), symbolName })
 		, m_Notification(route.GetHandle(
-			  ADSIGRP_SYM_VALBYHND, *m_Symbol,
+			  ADSIGRP_SYM_VALBYHND, m_Symbol->Get(),
 			  notificationAttributes,
 			  reinterpret_cast<PAdsNotificationFuncEx>(callback),
 			  hUser))
@@ -29,9 +31,10 @@ struct AdsNotification {
 	AdsNotification(const AdsDevice &route, const std::string &symbolName,
 			const AdsNotificationAttrib &notificationAttributes,
 			PAdsNotificationFuncExLegacy callback, uint32_t hUser)
-		: m_Symbol(route.GetHandle(symbolName))
+		: m_Symbol(new bhf::ads::SymbolHandleCache::Reference{
+			  route.GetSymbolHandleCache(), symbolName })
 		, m_Notification(route.GetHandle(
-			  ADSIGRP_SYM_VALBYHND, *m_Symbol,
+			  ADSIGRP_SYM_VALBYHND, m_Symbol->Get(),
 			  notificationAttributes,
 			  reinterpret_cast<PAdsNotificationFuncEx>(callback),
 			  hUser))
@@ -42,8 +45,7 @@ struct AdsNotification {
 			uint32_t indexOffset,
 			const AdsNotificationAttrib &notificationAttributes,
 			PAdsNotificationFuncExConst callback, uint32_t hUser)
-		: m_Symbol{ route.GetHandle(indexOffset) }
-		, m_Notification(route.GetHandle(
+		: m_Notification(route.GetHandle(
 			  indexGroup, indexOffset, notificationAttributes,
 			  reinterpret_cast<PAdsNotificationFuncEx>(callback),
 			  hUser))
@@ -54,8 +56,7 @@ struct AdsNotification {
 			uint32_t indexOffset,
 			const AdsNotificationAttrib &notificationAttributes,
 			PAdsNotificationFuncExLegacy callback, uint32_t hUser)
-		: m_Symbol{ route.GetHandle(indexOffset) }
-		, m_Notification(route.GetHandle(
+		: m_Notification(route.GetHandle(
 			  indexGroup, indexOffset, notificationAttributes,
 			  reinterpret_cast<PAdsNotificationFuncEx>(callback),
 			  hUser))
@@ -63,6 +64,7 @@ struct AdsNotification {
 	}
 
     private:
-	AdsHandle m_Symbol;
+	/** cached symbol handle, unset for notifications by indexGroup/Offset */
+	std::unique_ptr<bhf::ads::SymbolHandleCache::Reference> m_Symbol;
 	AdsHandle m_Notification;
 };
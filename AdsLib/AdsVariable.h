@@ -6,12 +6,15 @@
 #pragma once
 
 #include "AdsDevice.h"
+#include "SymbolHandleCache.h"
 
 template <typename T> struct AdsVariable {
 	AdsVariable(const AdsDevice &route, const std::string &symbolName)
 		: m_Route(route)
 		, m_IndexGroup(ADSIGRP_SYM_VALBYHND)
-		, m_Handle(route.GetHandle(symbolName))
+		, m_IndexOffset(0)
+		, m_Symbol(new bhf::ads::SymbolHandleCache::Reference{
+			  route.GetSymbolHandleCache(), symbolName })
 	{
 	}
 
@@ -19,7 +22,7 @@ template <typename T> struct AdsVariable {
 		    const uint32_t offset)
 		: m_Route(route)
 		, m_IndexGroup(group)
-		, m_Handle(route.GetHandle(offset))
+		, m_IndexOffset(offset)
 	{
 	}
 
@@ -51,8 +54,10 @@ template <typename T> struct AdsVariable {
 	void Read(const size_t size, void *data) const
 	{
 		uint32_t bytesRead = 0;
-		auto error = m_Route.ReadReqEx2(m_IndexGroup, *m_Handle, size,
-						data, &bytesRead);
+		auto error = Access([&](uint32_t offset) {
+			return m_Route.ReadReqEx2(m_IndexGroup, offset, size,
+						  data, &bytesRead);
+		});
 
 		if (error || (size != bytesRead)) {
 			throw AdsException(error);
@@ -61,8 +66,10 @@ template <typename T> struct AdsVariable {
 
 	void Write(const size_t size, const void *data) const
 	{
-		auto error =
-			m_Route.WriteReqEx(m_IndexGroup, *m_Handle, size, data);
+		auto error = Access([&](uint32_t offset) {
+			return m_Route.WriteReqEx(m_IndexGroup, offset, size,
+						  data);
+		});
 		if (error) {
 			throw AdsException(error);
 		}
@@ -71,5 +78,26 @@ template <typename T> struct AdsVariable {
     private:
 	const AdsDevice &m_Route;
 	const uint32_t m_IndexGroup;
-	const AdsHandle m_Handle;
+	const uint32_t m_IndexOffset;
+	/** cached symbol handle, which replaces m_IndexOffset if set */
+	const std::unique_ptr<const bhf::ads::SymbolHandleCache::Reference>
+		m_Symbol;
+
+	/**
+	 * Run request with the current offset. If the PLC rejected a cached
+	 * symbol handle, e.g. after an online change, it is retried once with
+	 * a handle, which was resolved again.
+	 */
+	template <typename Request> long Access(Request request) const
+	{
+		if (!m_Symbol) {
+			return request(m_IndexOffset);
+		}
+		const auto handle = m_Symbol->Get();
+		const auto error = request(handle);
+		if (!m_Symbol->Invalidate(handle, error)) {
+			return error;
+		}
+		return request(m_Symbol->Get());
+	}
 };
@@ -6,25 +6,43 @@
 #pragma once
 
 #include "AmsPort.h"
+#include "AmsReactor.h"
+#include "PendingTable.h"
 #include "Sockets.h"
 #include "Router.h"
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <thread>
 
 using Timepoint = std::chrono::steady_clock::time_point;
 
+/**
+ * Completion of an asynchronous request. It is invoked exactly once, either
+ * from the receiver thread of the AmsConnection or with
+ * ADSERR_CLIENT_SYNCTIMEOUT after the deadline of the request passed.
+ * Completions must not block or throw.
+ */
+using AmsCompletion =
+	std::function<void(uint32_t errorCode, uint32_t bytesRead)>;
+
 struct AmsRequest {
 	Frame frame;
-	const AmsAddr &destAddr;
+	const AmsAddr destAddr;
 	uint16_t port;
 	uint16_t cmdId;
 	uint32_t bufferLength;
 	void *buffer;
 	uint32_t *bytesRead;
 	Timepoint deadline;
+	bhf::ads::TrafficClass trafficClass;
+	/** only set while latency tracing is enabled */
+	Timepoint written;
+	Timepoint received;
 
 	AmsRequest(const AmsAddr &ams, uint16_t __port, uint16_t __cmdId,
 		   uint32_t __bufferLength = 0, void *__buffer = nullptr,
@@ -37,6 +55,7 @@ struct AmsRequest {
 		, bufferLength(__bufferLength)
 		, buffer(__buffer)
 		, bytesRead(__bytesRead)
+		, trafficClass(bhf::ads::TRAFFIC_INTERACTIVE)
 	{
 	}
 
@@ -47,13 +66,22 @@ struct AmsRequest {
 	}
 };
 
+struct AmsConnection;
+
 struct AmsResponse {
-	std::atomic<AmsRequest *> request;
+	AmsRequest &request;
+	/** invokeId assigned by AmsConnection::Reserve() */
+	uint32_t id;
+	/** connection to report the latency to, if tracing is enabled */
+	AmsConnection *tracer;
+	/** equals id until a response or timeout consumed it, 0 afterwards */
 	std::atomic<uint32_t> invokeId;
 
-	AmsResponse();
-	void Notify(uint32_t error);
-	void Release();
+	AmsResponse(AmsRequest &__request);
+	virtual ~AmsResponse()
+	{
+	}
+	virtual void Notify(uint32_t error);
 
 	// wait for response or timeout and return received errorCode or ADSERR_CLIENT_SYNCTIMEOUT
 	uint32_t Wait();
@@ -66,18 +94,53 @@ struct AmsResponse {
 	bool wasWritten;
 };
 
+/**
+ * Response to a request nobody waits for. It owns its AmsRequest, hands the
+ * result to an AmsCompletion and deletes itself afterwards.
+ */
+struct AmsAsyncResponse : AmsResponse {
+	AmsAsyncResponse(std::unique_ptr<AmsRequest> __request,
+			 AmsCompletion __completion,
+			 bhf::ads::Metrics &__metrics);
+	void Notify(uint32_t error) override;
+
+    private:
+	const std::unique_ptr<AmsRequest> ownedRequest;
+	const AmsCompletion completion;
+	bhf::ads::Metrics &metrics;
+	uint32_t bytesRead;
+};
+
 struct AmsConnection {
+	/**
+	 * @param[in] reactor if provided, the connection is driven by the
+	 *            threads of this reactor instead of an own receive thread
+	 * @param[in] notificationPool if provided, notification callbacks are
+	 *            invoked by this pool instead of a thread per dispatcher
+	 */
 	AmsConnection(Router &__router,
-		      const struct addrinfo *destination = nullptr);
+		      const struct addrinfo *destination = nullptr,
+		      AmsReactor *reactor = nullptr,
+		      NotificationPool *notificationPool = nullptr);
 	~AmsConnection();
 
 	SharedDispatcher
 	CreateNotifyMapping(uint32_t hNotify,
-			    std::shared_ptr<Notification> notification);
+			    std::shared_ptr<Notification> notification,
+			    const bhf::ads::NotificationBufferConfig &config);
 	long DeleteNotification(const AmsAddr &amsAddr, uint32_t hNotify,
 				uint32_t tmms, uint16_t port);
 	long AdsRequest(AmsRequest &request, uint32_t timeout);
 
+	/**
+	 * Send a request without waiting for its response.
+	 * @return 0 if the request was sent. The completion is invoked once
+	 *         the response or the timeout arrived. Otherwise an error code
+	 *         is returned and the completion will never be invoked.
+	 */
+	long AdsRequestAsync(std::unique_ptr<AmsRequest> request,
+			     AmsCompletion completion, uint32_t timeout);
+
 	/**
      * Confirm if this AmsConnection is connected to one of the target addresses.
      * @param[in] targetAddresses pointer to a previously allocated list of
@@ -86,35 +149,153 @@ struct AmsConnection {
      */
 	bool IsConnectedTo(const struct addrinfo *targetAddresses) const;
 
+	/**
+	 * Enable or disable recording the latency of each request. Enabling
+	 * discards the histograms recorded so far.
+	 */
+	void SetLatencyTracing(bool enable);
+	void AppendLatencies(std::vector<bhf::ads::RequestLatency> &stats);
+
+	/** Record the latency of a traced request, which was answered */
+	void TraceLatency(const AmsRequest &request, const Timepoint &woken);
+
     private:
 	friend struct AmsRouter;
 	Router &router;
+	bhf::ads::Metrics &metrics;
 	TcpSocket socket;
 	std::thread receiver;
+	AmsReactor *const reactor;
+	uint64_t reactorId;
+	NotificationPool *const notificationPool;
+	/** notification, which didn't fit into rxBuffer completely */
+	std::vector<uint8_t> notificationFrame;
+
+	/**
+	 * Received data, which wasn't parsed yet. The receiver thread consumes
+	 * it from rxPos on, in reactor mode rxPos stays 0.
+	 */
+	std::vector<uint8_t> rxBuffer;
+	size_t rxPos;
+	size_t rxBytes;
+	bool OnReadable();
+	void ParseFrames();
+	void ProcessFrame(const uint8_t *frame, size_t length);
+	template <class T>
+	void CompleteResponse(AmsResponse *response, const uint8_t *data,
+			      size_t length, uint32_t aoeError) const;
+	void DispatchNotification(const AoEHeader &header, const uint8_t *data);
 	std::atomic<size_t> refCount;
 	std::atomic<uint32_t> invokeId;
-	std::array<AmsResponse, Router::NUM_PORTS_MAX> queue;
+
+	/**
+	 * Requests waiting for their response, keyed by invokeId. A single
+	 * AmsPort can have any number of requests in flight.
+	 */
+	PendingTable<AmsResponse> pending;
+	std::mutex pendingMutex;
+	/**
+	 * Bytes sent and expected back by the requests in pending. Routes with
+	 * several connections pick the one with the least bytes in flight.
+	 */
+	std::atomic<size_t> pendingBytes;
+	static size_t Load(const AmsRequest &request);
+	/** pendingMutex has to be locked */
+	void ErasePending(uint32_t id, const AmsResponse &response);
+
+	/**
+	 * Frames waiting to be sent, one lane per TrafficClass. A thread, which
+	 * finds no other sending, sends the waiting frames highest class first,
+	 * until its own frame is out. Entries live on the stack of their
+	 * senders and are linked into the lanes, so queueing never allocates.
+	 */
+	struct Outgoing {
+		const Frame &frame;
+		bool sent;
+		bool done;
+		Outgoing *next;
+	};
+	struct Lane {
+		Outgoing *head = nullptr;
+		Outgoing *tail = nullptr;
+		void Push(Outgoing &outgoing);
+		Outgoing &Pop();
+	};
+	std::array<Lane, bhf::ads::NUM_TRAFFIC_CLASSES> lanes;
+	bool sending;
+	std::mutex writeMutex;
+	std::condition_variable sendDone;
+	bool Send(const Frame &frame, bhf::ads::TrafficClass trafficClass);
+
+	/**
+	 * Deadlines of asynchronous requests. Entries of requests, which were
+	 * answered in time, are dropped lazily once their deadline passed.
+	 */
+	std::multimap<Timepoint, std::pair<uint32_t, AmsResponse *> >
+		asyncDeadlines;
+	std::condition_variable asyncDeadlinesChanged;
+	std::once_flag timeoutWatcherStarted;
+	std::thread timeoutWatcher;
+	bool stopTimeoutWatcher;
+	void WatchTimeouts();
 
 	template <class T>
 	void ReceiveFrame(AmsResponse *response, size_t length,
-			  uint32_t aoeError) const;
+			  uint32_t aoeError);
 	bool ReceiveNotification(const AoEHeader &header);
-	void ReceiveJunk(size_t bytesToRead) const;
+	void ReceiveJunk(size_t bytesToRead);
 	void Receive(void *buffer, size_t bytesToRead,
-		     timeval *timeout = nullptr) const;
+		     timeval *timeout = nullptr);
 	void Receive(void *buffer, size_t bytesToRead,
-		     const Timepoint &deadline) const;
-	template <class T> void Receive(T &buffer) const
+		     const Timepoint &deadline);
+	template <class T> void Receive(T &buffer)
 	{
 		Receive(&buffer, sizeof(T));
 	}
-	AmsResponse *Write(AmsRequest &request, const AmsAddr srcAddr);
+	/** @return invokeId of the sent request or 0 if sending failed */
+	uint32_t Write(AmsResponse &response, const AmsAddr srcAddr);
 	void Recv();
 	void TryRecv();
 	uint32_t GetInvokeId();
-	AmsResponse *Reserve(AmsRequest *request, uint16_t port);
+	void Reserve(AmsResponse &response);
+	bool Withdraw(uint32_t id, const AmsResponse *response);
 	AmsResponse *GetPending(uint32_t id, uint16_t port);
 
+	std::atomic<bool> latencyTracing;
+	using LatencyKey = std::pair<AmsAddr, uint16_t>;
+	std::map<LatencyKey, bhf::ads::RequestLatency> latencies;
+	std::mutex latencyMutex;
+	bhf::ads::RequestLatency &Latency(const AmsAddr &target,
+					  uint16_t cmdId);
+
+	/**
+	 * Once the connection is lost, the supervisor thread connects again
+	 * with an exponential backoff and subscribes all notifications again.
+	 * Meanwhile requests fail immediately.
+	 */
+	enum class LinkState { CONNECTED, LOST, STOPPED };
+	LinkState linkState;
+	std::atomic<bool> linkUp;
+	bool resubscribe;
+	std::mutex linkMutex;
+	std::condition_variable linkChanged;
+	std::thread supervisor;
+	void ConnectionLost();
+	bool AwaitReconnect();
+	void Supervise();
+	bool Reconnect();
+	bool Resubscribe();
+
+	/**
+	 * Send ADD_DEVICE_NOTIFICATION and wait for the new handle. A response,
+	 * which arrives after we stopped waiting, is deleted on the server
+	 * again, so it doesn't keep sending samples nobody expects.
+	 */
+	long Subscribe(const VirtualConnection &connection,
+		       const Notification &notification, uint32_t &hNotify);
+	void DeleteLateNotification(const VirtualConnection &connection,
+				    uint32_t hNotify);
+
 	std::map<VirtualConnection, SharedDispatcher> dispatcherList;
 	std::recursive_mutex dispatcherListMutex;
 	SharedDispatcher DispatcherListAdd(const VirtualConnection &connection);
@@ -7,13 +7,24 @@
 
 #include "NotificationDispatcher.h"
 
+#include <atomic>
+
 struct AmsPort {
 	AmsPort();
 	void Close();
 	bool IsOpen() const;
 	uint16_t Open(uint16_t __port);
-	uint32_t tmms;
-	uint16_t port;
+
+	/** atomic, so requests can read them without taking the router mutex */
+	std::atomic<uint32_t> tmms;
+	std::atomic<uint16_t> port;
+	std::atomic<bhf::ads::TrafficClass> trafficClass;
+
+	/** Apply config to new and existing notifications of this port */
+	void ConfigureNotifications(
+		const bhf::ads::NotificationBufferConfig &config);
+	/** @return copy of the config for new notifications of this port */
+	bhf::ads::NotificationBufferConfig NotificationBuffer();
 
 	void AddNotification(AmsAddr ams, uint32_t hNotify,
 			     SharedDispatcher dispatcher);
@@ -22,6 +33,8 @@ struct AmsPort {
     private:
 	using NotifyUUID = std::pair<const AmsAddr, const uint32_t>;
 	static const uint32_t DEFAULT_TIMEOUT = 5000;
+	static const bhf::ads::NotificationBufferConfig DEFAULT_BUFFER;
 	std::map<NotifyUUID, SharedDispatcher> dispatcherList;
+	bhf::ads::NotificationBufferConfig notificationBuffer;
 	std::mutex mutex;
 };
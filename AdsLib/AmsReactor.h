@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "wrap_socket.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Event loop, which drives the receive side of many AmsConnections with a
+ * fixed pool of threads, instead of one thread per connection. Sockets are
+ * watched with epoll, so this is only available on Linux.
+ */
+struct AmsReactor {
+	/**
+	 * Invoked whenever a watched socket becomes readable. The handler of
+	 * a socket is never executed by two threads at the same time.
+	 * @return false to stop watching the socket
+	 */
+	using Handler = std::function<bool()>;
+
+	/**
+	 * @throw std::runtime_error if epoll is not available
+	 * @throw std::system_error if epoll could not be initialized
+	 */
+	AmsReactor(size_t numThreads);
+	~AmsReactor();
+
+	/** @return id to stop watching the socket with Remove() */
+	uint64_t Add(SOCKET socket, Handler onReadable);
+
+	/** Stop watching a socket and wait until its handler returned */
+	void Remove(uint64_t id);
+
+    private:
+	struct Source {
+		SOCKET socket;
+		Handler onReadable;
+		bool busy;
+		bool removed;
+	};
+
+	int epollFd;
+	int wakeupFd;
+	std::mutex mutex;
+	std::condition_variable idle;
+	std::map<uint64_t, Source> sources;
+	uint64_t nextId;
+	bool stopped;
+	std::vector<std::thread> threads;
+
+	void Run();
+	void Handle(uint64_t id);
+};
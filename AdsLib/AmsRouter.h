@@ -17,6 +17,12 @@ struct AmsRouter : Router {
 	void SetLocalAddress(AmsNetId netId);
 	long GetTimeout(uint16_t port, uint32_t &timeout);
 	long SetTimeout(uint16_t port, uint32_t timeout);
+	long SetTrafficClass(uint16_t port,
+			     bhf::ads::TrafficClass trafficClass);
+	long SetNotificationBuffer(
+		uint16_t port, const bhf::ads::NotificationBufferConfig &config);
+	long GetNotificationStats(uint16_t port, const AmsAddr &addr,
+				  bhf::ads::NotificationStats &stats);
 	long AddNotification(AmsRequest &request, uint32_t *pNotification,
 			     std::shared_ptr<Notification> notify);
 	long DelNotification(uint16_t port, const AmsAddr *pAddr,
@@ -24,19 +30,87 @@ struct AmsRouter : Router {
 
 	[[deprecated]]
 	long AddRoute(AmsNetId ams, const IpV4 &ip);
-	long AddRoute(AmsNetId ams, const std::string &host);
+	/**
+	 * @param[in] numConnections number of TCP connections to open to a
+	 *            new route. Requests are spread over them, so small ones
+	 *            don't queue up behind large transfers. Notifications are
+	 *            always subscribed on the first connection. Routes, which
+	 *            exist already, keep their connections.
+	 */
+	long AddRoute(AmsNetId ams, const std::string &host,
+		      size_t numConnections = 1);
 	void DelRoute(const AmsNetId &ams);
+
+	/** @return the first connection of a route */
 	AmsConnection *GetConnection(const AmsNetId &pAddr);
+
+	/** @return the connection of a route with the least bytes in flight */
+	AmsConnection *SelectConnection(const AmsNetId &pAddr);
 	long AdsRequest(AmsRequest &request);
+	long AdsRequestAsync(std::unique_ptr<AmsRequest> request,
+			     AmsCompletion completion);
+
+	/**
+	 * Drive all connections by a reactor with numThreads threads, 0
+	 * selects one receive thread per connection. It can only be changed
+	 * while no route exists.
+	 */
+	long SetReactorThreads(size_t numThreads);
+
+	/**
+	 * Invoke the notification callbacks of all connections with a shared
+	 * pool of numThreads threads, 0 selects one thread per local port and
+	 * remote AmsAddr. It can only be changed while no route exists.
+	 */
+	long SetNotificationThreads(size_t numThreads);
+
+	/**
+	 * Record the latencies of all requests. Enabling it discards the
+	 * histograms recorded so far.
+	 */
+	void SetLatencyTracing(bool enable);
+	void GetLatencyStats(std::vector<bhf::ads::RequestLatency> &stats);
+
+	bhf::ads::MetricsSnapshot GetMetrics() const;
 
     private:
-	AmsNetId localAddr;
+	/** AmsNetId packed into an integer, so it can be read lock-free */
+	std::atomic<uint64_t> localAddr;
 	std::recursive_mutex mutex;
 	std::condition_variable_any connection_attempt_events;
 	std::map<AmsNetId, std::tuple<> > connection_attempts;
+	std::unique_ptr<AmsReactor> reactor;
+	std::unique_ptr<NotificationPool> notificationPool;
+	bool latencyTracing;
 	std::unordered_set<std::unique_ptr<AmsConnection> > connections;
 	std::map<AmsNetId, AmsConnection *> mapping;
 
+	/**
+	 * Additional connections of routes with more than one connection. They
+	 * are owned by connections, too, but never shared with other routes.
+	 */
+	std::map<AmsNetId, std::vector<AmsConnection *> > stripes;
+	bool IsStripe(const AmsConnection *conn) const;
+	long AddStripes(const AmsNetId &ams, const struct addrinfo *destination,
+			size_t count,
+			std::unique_lock<std::recursive_mutex> &lock);
+	void DelStripes(const AmsNetId &ams);
+
+	/**
+	 * Immutable copy of mapping and stripes, which is published after
+	 * every change together with a new routesVersion. Every thread caches
+	 * the last table it used, so requests only load routesVersion and take
+	 * routesMutex only once after each change. A replaced table is freed,
+	 * when the last thread, which cached it, looks up the new one.
+	 */
+	using RouteTable = std::map<AmsNetId, std::vector<AmsConnection *> >;
+	std::mutex routesMutex;
+	std::shared_ptr<const RouteTable> routes;
+	std::atomic<uint64_t> routesVersion;
+	void PublishRoutes();
+	/** @return the current table, valid until the next call */
+	const RouteTable &Routes();
+
 	void
 	AwaitConnectionAttempts(const AmsNetId &ams,
 				std::unique_lock<std::recursive_mutex> &lock);
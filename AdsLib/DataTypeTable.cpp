@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "DataTypeTable.h"
+#include "AdsException.h"
+#include "Log.h"
+#include "wrap_endian.h"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace bhf
+{
+namespace ads
+{
+/** nested types deeper than this are considered corrupt */
+static const size_t MAX_DEPTH = 64;
+
+/** bounds checked reading of a datatype entry */
+struct EntryReader {
+	const uint8_t *pos;
+	const uint8_t *const end;
+
+	void Need(const size_t length) const
+	{
+		if (length > static_cast<size_t>(end - pos)) {
+			LOG_ERROR("DataTypeTable: entry truncated, "
+				  << std::dec << length << " bytes missing\n");
+			throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+		}
+	}
+
+	template <typename T> T Pop()
+	{
+		T value;
+		Need(sizeof(value));
+		memcpy(&value, pos, sizeof(value));
+		pos += sizeof(value);
+		return letoh(value);
+	}
+
+	std::string PopString(const size_t length)
+	{
+		Need(length + 1);
+		const auto s = std::string(reinterpret_cast<const char *>(pos),
+					   length);
+		pos += length + 1;
+		return s;
+	}
+
+	void Skip(const size_t length)
+	{
+		Need(length);
+		pos += length;
+	}
+};
+
+static bool IsSigned(const uint32_t adsType)
+{
+	return (ADST_INT8 == adsType) || (ADST_INT16 == adsType) ||
+	       (ADST_INT32 == adsType) || (ADST_INT64 == adsType);
+}
+
+/** @return size of fixed width ADST_* types, 0 for all others */
+static size_t Width(const uint32_t adsType)
+{
+	switch (adsType) {
+	case ADST_INT8:
+	case ADST_UINT8:
+	case ADST_BIT:
+		return 1;
+	case ADST_INT16:
+	case ADST_UINT16:
+		return 2;
+	case ADST_INT32:
+	case ADST_UINT32:
+	case ADST_REAL32:
+		return 4;
+	case ADST_INT64:
+	case ADST_UINT64:
+	case ADST_REAL64:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Values are decoded according to the ADST_* type, so its width has to
+ * match the size. Enums of other types are read as integers of 1 to 8 bytes.
+ */
+static void CheckSize(const DataType &type, const bool isEnum)
+{
+	const auto width = Width(type.adsType);
+	const auto valid = width ? (width == type.size) :
+				   !isEnum || (type.size && (type.size <= 8));
+	if (!valid) {
+		LOG_ERROR("DataTypeTable: " << type.name << " has " << std::dec
+					    << type.size << " bytes, which "
+					    << "don't fit ADST " << type.adsType
+					    << '\n');
+		throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	}
+}
+
+static int64_t ReadInteger(const uint8_t *const data, const size_t size,
+			   const bool isSigned)
+{
+	uint64_t value = 0;
+	for (size_t i = std::min<size_t>(size, sizeof(value)); i--;) {
+		value = (value << 8) | data[i];
+	}
+	if (isSigned && (size < sizeof(value)) && (data[size - 1] & 0x80)) {
+		value |= ~uint64_t{ 0 } << (8 * size);
+	}
+	return static_cast<int64_t>(value);
+}
+
+static DataType ParseEntry(const uint8_t *const data, const size_t lengthLimit,
+			   const size_t depth, uint32_t &entryLength)
+{
+	EntryReader header{ data, data + lengthLimit };
+	entryLength = header.Pop<uint32_t>();
+	if ((entryLength > lengthLimit) ||
+	    (entryLength < sizeof(AdsDatatypeEntry)) || (depth > MAX_DEPTH)) {
+		LOG_ERROR(__FUNCTION__ << "(): Corrupt entry length: "
+				       << std::dec << entryLength << '\n');
+		throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	}
+
+	EntryReader entry{ data + sizeof(entryLength), data + entryLength };
+	entry.Skip(3 * sizeof(uint32_t)); // version, hashValue, typeHashValue
+	DataType type;
+	type.size = entry.Pop<uint32_t>();
+	type.offset = entry.Pop<uint32_t>();
+	type.adsType = entry.Pop<uint32_t>();
+	type.flags = entry.Pop<uint32_t>();
+	const auto nameLength = entry.Pop<uint16_t>();
+	const auto typeLength = entry.Pop<uint16_t>();
+	const auto commentLength = entry.Pop<uint16_t>();
+	const auto arrayDim = entry.Pop<uint16_t>();
+	const auto subItems = entry.Pop<uint16_t>();
+	type.name = entry.PopString(nameLength);
+	type.typeName = entry.PopString(typeLength);
+	type.comment = entry.PopString(commentLength);
+	type.base = nullptr;
+
+	for (auto i = arrayDim; i; --i) {
+		const auto lBound = static_cast<int32_t>(entry.Pop<uint32_t>());
+		type.dimensions.push_back({ lBound, entry.Pop<uint32_t>() });
+	}
+
+	for (auto i = subItems; i; --i) {
+		uint32_t fieldLength;
+		type.fields.push_back(ParseEntry(
+			entry.pos, static_cast<size_t>(entry.end - entry.pos),
+			depth + 1, fieldLength));
+		entry.pos += fieldLength;
+	}
+
+	/* optional data in the order TwinCAT appends it */
+	if (type.flags & ADSDATATYPEFLAG_TYPEGUID) {
+		entry.Skip(16);
+	}
+	if (type.flags & ADSDATATYPEFLAG_COPYMASK) {
+		entry.Skip(type.size);
+	}
+	if (type.flags & ADSDATATYPEFLAG_METHODINFOS) {
+		for (auto i = entry.Pop<uint16_t>(); i; --i) {
+			const auto methodLength = entry.Pop<uint32_t>();
+			entry.Skip(methodLength - sizeof(methodLength));
+		}
+	}
+	if (type.flags & ADSDATATYPEFLAG_ATTRIBUTES) {
+		for (auto i = entry.Pop<uint16_t>(); i; --i) {
+			const auto keyLength = entry.Pop<uint8_t>();
+			const auto valueLength = entry.Pop<uint8_t>();
+			entry.Skip(keyLength + 1 + valueLength + 1);
+		}
+	}
+	if (type.flags & ADSDATATYPEFLAG_ENUMINFOS) {
+		CheckSize(type, true);
+		const auto isSigned = IsSigned(type.adsType);
+		for (auto i = entry.Pop<uint16_t>(); i; --i) {
+			auto name = entry.PopString(entry.Pop<uint8_t>());
+			entry.Need(type.size);
+			const auto value =
+				ReadInteger(entry.pos, type.size, isSigned);
+			entry.Skip(type.size);
+			type.enumValues.emplace_back(std::move(name), value);
+		}
+	}
+	return type;
+}
+
+DataTypeTable::DataTypeTable(const uint8_t *data, size_t length,
+			     uint32_t nDatatypes)
+{
+	while (nDatatypes-- && length) {
+		uint32_t entryLength;
+		auto type = ParseEntry(data, length, 0, entryLength);
+		data += entryLength;
+		length -= entryLength;
+		auto name = type.name;
+		types.emplace(std::move(name), std::move(type));
+	}
+	if (length) {
+		LOG_ERROR(__FUNCTION__ << "(): " << std::dec << length
+				       << " bytes left after " << types.size()
+				       << " datatypes\n");
+		throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	}
+
+	/* nodes of an unordered_map keep their address, so we can link them */
+	for (auto &t : types) {
+		Link(t.second);
+	}
+}
+
+void DataTypeTable::Link(DataType &type)
+{
+	if (!type.typeName.empty() && (type.typeName != type.name)) {
+		type.base = Find(type.typeName);
+	}
+	for (auto &field : type.fields) {
+		Link(field);
+	}
+}
+
+size_t DataTypeTable::size() const
+{
+	return types.size();
+}
+
+const DataType *DataTypeTable::Find(const std::string &name) const
+{
+	const auto it = types.find(name);
+	return (it == types.end()) ? nullptr : &it->second;
+}
+
+void DataTypeTable::Decode(const DataType &type, const uint8_t *const data,
+			   const size_t length, const Visitor &visit) const
+{
+	std::string path;
+	Decode(type, data, length, visit, path, 0);
+}
+
+void DataTypeTable::Decode(const DataType &type, const uint8_t *const data,
+			   const size_t length, const Visitor &visit,
+			   std::string &path, const size_t depth) const
+{
+	if ((type.size > length) || (depth > MAX_DEPTH)) {
+		return;
+	}
+
+	if (!type.dimensions.empty()) {
+		size_t numElements = 1;
+		for (const auto &d : type.dimensions) {
+			numElements *= d.elements;
+		}
+		if (!numElements) {
+			return;
+		}
+
+		/* without a known element type, treat elements as opaque */
+		DataType opaque{};
+		opaque.name = type.typeName;
+		opaque.size = static_cast<uint32_t>(type.size / numElements);
+		opaque.adsType = type.adsType;
+		const auto &element = type.base ? *type.base : opaque;
+		const size_t stride = type.size / numElements;
+
+		const auto prefixLength = path.size();
+		for (size_t i = 0; i < numElements; ++i) {
+			/* the last dimension changes fastest */
+			std::string index;
+			auto rest = i;
+			for (auto d = type.dimensions.size(); d--;) {
+				const auto &dim = type.dimensions[d];
+				index = std::to_string(dim.lBound +
+						       static_cast<int64_t>(
+							       rest % dim.elements)) +
+					(index.empty() ? "" : "," + index);
+				rest /= dim.elements;
+			}
+			path += '[' + index + ']';
+			Decode(element, data + i * stride, stride, visit, path,
+			       depth + 1);
+			path.resize(prefixLength);
+		}
+		return;
+	}
+
+	if (!type.fields.empty()) {
+		const auto prefixLength = path.size();
+		for (const auto &field : type.fields) {
+			if (field.offset > length) {
+				continue;
+			}
+			path += '.' + field.name;
+			Decode(field, data + field.offset, length - field.offset,
+			       visit, path, depth + 1);
+			path.resize(prefixLength);
+		}
+		return;
+	}
+
+	if (type.base && type.enumValues.empty()) {
+		Decode(*type.base, data, length, visit, path, depth + 1);
+		return;
+	}
+	visit(path, type, data);
+}
+
+std::string DataTypeTable::Format(const DataType &type,
+				  const uint8_t *const data)
+{
+	CheckSize(type, !type.enumValues.empty());
+	std::ostringstream os;
+	if (!type.enumValues.empty()) {
+		const auto value =
+			ReadInteger(data, type.size, IsSigned(type.adsType));
+		for (const auto &e : type.enumValues) {
+			if (e.second == value) {
+				return e.first;
+			}
+		}
+		os << value;
+		return os.str();
+	}
+
+	switch (type.adsType) {
+	case ADST_INT8:
+	case ADST_INT16:
+	case ADST_INT32:
+	case ADST_INT64:
+		os << ReadInteger(data, type.size, true);
+		break;
+	case ADST_UINT8:
+	case ADST_UINT16:
+	case ADST_UINT32:
+	case ADST_UINT64:
+		os << static_cast<uint64_t>(ReadInteger(data, type.size, false));
+		break;
+	case ADST_BIT:
+		os << (data[0] ? "TRUE" : "FALSE");
+		break;
+	case ADST_REAL32: {
+		float value;
+		memcpy(&value, data, sizeof(value));
+		os << letoh(value);
+		break;
+	}
+	case ADST_REAL64: {
+		double value;
+		memcpy(&value, data, sizeof(value));
+		os << letoh(value);
+		break;
+	}
+	case ADST_STRING:
+		os << std::string(reinterpret_cast<const char *>(data),
+				  strnlen(reinterpret_cast<const char *>(data),
+					  type.size));
+		break;
+	default:
+		os << "0x" << std::hex << std::setfill('0');
+		for (size_t i = 0; i < type.size; ++i) {
+			os << std::setw(2) << static_cast<int>(data[i]);
+		}
+		break;
+	}
+	return os.str();
+}
+}
+}
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AdsDef.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bhf
+{
+namespace ads
+{
+/**
+ * A node of the type graph decoded from ADSIGRP_SYM_DT_UPLOAD. Structures
+ * have fields, arrays have dimensions and enums have values. base links to
+ * the type named by typeName: the element type of arrays, the type of a
+ * field or the aliased type. It is nullptr for builtin types.
+ */
+struct DataType {
+	struct Dimension {
+		int32_t lBound;
+		uint32_t elements;
+	};
+
+	std::string name;
+	std::string typeName;
+	std::string comment;
+	/** in bytes */
+	uint32_t size;
+	/** of a field within its structure in bytes */
+	uint32_t offset;
+	/** ADST_* */
+	uint32_t adsType;
+	/** ADSDATATYPEFLAG_* */
+	uint32_t flags;
+	std::vector<Dimension> dimensions;
+	std::vector<DataType> fields;
+	std::vector<std::pair<std::string, int64_t> > enumValues;
+	const DataType *base;
+};
+
+/** Type graph of a PLC, which decodes whole structures locally */
+struct DataTypeTable {
+	/**
+	 * Called for every value without further structure: numbers, strings,
+	 * enums and types unknown to the table.
+	 * @param[in] path relative to the decoded value like ".stAxis.aPos[2]"
+	 * @param[in] type of the value
+	 * @param[in] data of the value, type.size bytes
+	 */
+	using Visitor = std::function<void(
+		const std::string &path, const DataType &type, const uint8_t *data)>;
+
+	/**
+	 * @param[in] data result of ADSIGRP_SYM_DT_UPLOAD
+	 * @param[in] length of data in bytes
+	 * @param[in] nDatatypes as reported by ADSIGRP_SYM_UPLOADINFO2
+	 * @throw AdsException(ADSERR_DEVICE_INVALIDDATA), if data is corrupt
+	 */
+	DataTypeTable(const uint8_t *data, size_t length, uint32_t nDatatypes);
+	DataTypeTable(DataTypeTable &&) = default;
+	DataTypeTable(const DataTypeTable &) = delete;
+	DataTypeTable &operator=(const DataTypeTable &) = delete;
+
+	size_t size() const;
+
+	/** @return the type called name or nullptr */
+	const DataType *Find(const std::string &name) const;
+
+	/**
+	 * Walk a value of type and call visit for each value without further
+	 * structure. Parts beyond length are skipped.
+	 */
+	void Decode(const DataType &type, const uint8_t *data, size_t length,
+		    const Visitor &visit) const;
+
+	/**
+	 * @param[in] data of the value, type.size bytes
+	 * @return a value without further structure as text
+	 * @throw AdsException(ADSERR_DEVICE_INVALIDDATA), if type.size doesn't
+	 *        match the ADST_* type
+	 */
+	static std::string Format(const DataType &type, const uint8_t *data);
+
+    private:
+	std::unordered_map<std::string, DataType> types;
+
+	void Link(DataType &type);
+	void Decode(const DataType &type, const uint8_t *data, size_t length,
+		    const Visitor &visit, std::string &path, size_t depth) const;
+};
+}
+}
@@ -7,13 +7,97 @@
 #include "Log.h"
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <new>
+#include <vector>
+
+namespace
+{
+/** size classes are powers of two from 256 bytes to 64 KiB */
+static const size_t MIN_SHIFT = 8;
+static const size_t NUM_CLASSES = 9;
+static const size_t MAX_CACHED = 8;
+
+struct FramePool {
+	std::array<std::vector<uint8_t *>, NUM_CLASSES> cache;
+
+	FramePool()
+	{
+		for (auto &c : cache) {
+			c.reserve(MAX_CACHED);
+		}
+	}
+
+	~FramePool();
+};
+
+/** buffers released while the thread exits bypass the destroyed pool */
+static thread_local bool g_PoolDestroyed = false;
+
+FramePool::~FramePool()
+{
+	g_PoolDestroyed = true;
+	for (auto &c : cache) {
+		for (auto buffer : c) {
+			delete[] buffer;
+		}
+	}
+}
+
+static FramePool &Pool()
+{
+	static thread_local FramePool pool;
+	return pool;
+}
+
+/** @return the size class of length or NUM_CLASSES, if it is too large */
+static size_t SizeClass(const size_t length)
+{
+	size_t sizeClass = 0;
+	while ((sizeClass < NUM_CLASSES) &&
+	       ((size_t{ 1 } << (MIN_SHIFT + sizeClass)) < length)) {
+		++sizeClass;
+	}
+	return sizeClass;
+}
+}
+
+Frame::Buffer Frame::Allocate(size_t length)
+{
+	length += HEADROOM;
+	const auto sizeClass = SizeClass(length);
+	if (sizeClass < NUM_CLASSES) {
+		length = size_t{ 1 } << (MIN_SHIFT + sizeClass);
+		if (!g_PoolDestroyed) {
+			auto &cache = Pool().cache[sizeClass];
+			if (!cache.empty()) {
+				Buffer buffer{ cache.back(), Recycle{ length } };
+				cache.pop_back();
+				return buffer;
+			}
+		}
+	}
+	return Buffer{ new uint8_t[length], Recycle{ length } };
+}
+
+void Frame::Recycle::operator()(uint8_t *const buffer) const
+{
+	const auto sizeClass = SizeClass(length);
+	if ((sizeClass < NUM_CLASSES) && !g_PoolDestroyed) {
+		auto &cache = Pool().cache[sizeClass];
+		if (cache.size() < MAX_CACHED) {
+			cache.push_back(buffer);
+			return;
+		}
+	}
+	delete[] buffer;
+}
 
 Frame::Frame(size_t length, const void *data)
-	: m_Data(new uint8_t[length])
+	: m_Data(Allocate(length))
 {
-	m_Size = m_Data ? length : 0;
+	m_Size = m_Data.get_deleter().length;
 	m_Pos = m_Data.get() + m_Size;
 	m_OriginalSize = m_Size;
 
@@ -54,8 +138,8 @@ Frame &Frame::reset(const size_t newSize)
 {
 	if (newSize > m_OriginalSize) {
 		try {
-			std::unique_ptr<uint8_t[]> tmp{ new uint8_t[newSize] };
-			m_OriginalSize = newSize;
+			auto tmp = Allocate(newSize);
+			m_OriginalSize = tmp.get_deleter().length;
 			m_Data = std::move(tmp);
 		} catch (const std::bad_alloc &) {
 			LOG_WARN("Not enough memory to reset frame to "
@@ -72,17 +156,17 @@ Frame &Frame::prepend(const void *const data, const size_t size)
 {
 	const size_t bytesFree = m_Pos - m_Data.get();
 	if (size > bytesFree) {
-		auto newData = new uint8_t[size + m_Size];
+		const auto used = m_Size - bytesFree;
+		auto newData = Allocate(size + used);
+		const auto newSize = newData.get_deleter().length;
 
-		m_Pos = newData + bytesFree + size;
-		memcpy(m_Pos, m_Data.get() + bytesFree, m_Size - bytesFree);
-		m_Data.reset(newData);
-		m_Size += size;
+		memcpy(newData.get() + newSize - used, m_Pos, used);
+		m_Data = std::move(newData);
+		m_Size = newSize;
 		m_OriginalSize = m_Size;
-		m_Pos = m_Data.get() + bytesFree;
-	} else {
-		m_Pos -= size;
+		m_Pos = m_Data.get() + m_Size - used;
 	}
+	m_Pos -= size;
 	memcpy(m_Pos, data, size);
 	return *this;
 }
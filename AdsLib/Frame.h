@@ -9,6 +9,12 @@
 #include <memory>
 
 struct Frame {
+	/**
+     * Every frame has at least HEADROOM bytes in front of the requested
+     * length, so additional headers can be prepended without reallocation.
+     */
+	static const size_t HEADROOM = 64;
+
 	/**
      * @brief Frame
      * @param length number of bytes preallocated in the internale buffer
@@ -133,7 +139,18 @@ struct Frame {
 	size_t size() const;
 
     private:
-	std::unique_ptr<uint8_t[]> m_Data;
+	/**
+     * Buffers up to 64 KiB are taken from and returned to a small cache of
+     * the calling thread, so requests in a steady state don't hit the heap.
+     */
+	struct Recycle {
+		size_t length;
+		void operator()(uint8_t *buffer) const;
+	};
+	using Buffer = std::unique_ptr<uint8_t[], Recycle>;
+	static Buffer Allocate(size_t length);
+
+	Buffer m_Data;
 	uint8_t *m_Pos;
 	size_t m_Size;
 	size_t m_OriginalSize;
@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "HeaderGenerator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace bhf
+{
+namespace ads
+{
+/** valid PLC names, which Identifier() has to change */
+static const std::set<std::string> KEYWORDS = {
+	"alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand",
+	"bitor", "bool", "break", "case", "catch", "char", "char16_t",
+	"char32_t", "class", "compl", "const", "constexpr", "const_cast",
+	"continue", "decltype", "default", "delete", "do", "double",
+	"dynamic_cast", "else", "enum", "explicit", "export", "extern",
+	"false", "float", "for", "friend", "goto", "if", "inline", "int",
+	"long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+	"nullptr", "operator", "or", "or_eq", "private", "protected", "public",
+	"register", "reinterpret_cast", "return", "short", "signed", "sizeof",
+	"static", "static_assert", "static_cast", "struct", "switch",
+	"template", "this", "thread_local", "throw", "true", "try", "typedef",
+	"typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+	"volatile", "wchar_t", "while", "xor", "xor_eq",
+};
+
+static std::string Identifier(const std::string &name)
+{
+	std::string id;
+	for (const auto c : name) {
+		id += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+	}
+	if (id.empty() || std::isdigit(static_cast<unsigned char>(id[0]))) {
+		id.insert(0, 1, '_');
+	}
+	if (KEYWORDS.count(id)) {
+		id += '_';
+	}
+	return id;
+}
+
+/**
+ * Identifier() maps different names like "A.b_c" and "A_b.c" to the same
+ * identifier, so the names of one C++ scope get a numbered suffix, if their
+ * identifier is taken already.
+ */
+struct Scope {
+	/** @return the identifier for name, the same for every call */
+	const std::string &Name(const std::string &name)
+	{
+		auto it = names.find(name);
+		if (it == names.end()) {
+			const auto id = Unique(Identifier(name));
+			it = names.emplace(name, id).first;
+		}
+		return it->second;
+	}
+
+	/** @return id or id with a suffix, which isn't used in this scope */
+	std::string Unique(const std::string &id)
+	{
+		auto unique = id;
+		for (size_t n = 2; !used.insert(unique).second; ++n) {
+			unique = id + '_' + std::to_string(n);
+		}
+		return unique;
+	}
+
+    private:
+	std::map<std::string, std::string> names;
+	std::set<std::string> used;
+};
+
+static const char *Builtin(const uint32_t adsType, const uint32_t size)
+{
+	struct Type {
+		const char *name;
+		uint32_t size;
+	};
+	Type type;
+	switch (adsType) {
+	case ADST_INT8:
+		type = { "int8_t", 1 };
+		break;
+	case ADST_UINT8:
+	case ADST_BIT:
+		type = { "uint8_t", 1 };
+		break;
+	case ADST_INT16:
+		type = { "int16_t", 2 };
+		break;
+	case ADST_UINT16:
+		type = { "uint16_t", 2 };
+		break;
+	case ADST_INT32:
+		type = { "int32_t", 4 };
+		break;
+	case ADST_UINT32:
+		type = { "uint32_t", 4 };
+		break;
+	case ADST_INT64:
+		type = { "int64_t", 8 };
+		break;
+	case ADST_UINT64:
+		type = { "uint64_t", 8 };
+		break;
+	case ADST_REAL32:
+		type = { "float", 4 };
+		break;
+	case ADST_REAL64:
+		type = { "double", 8 };
+		break;
+	default:
+		return nullptr;
+	}
+	return (type.size == size) ? type.name : nullptr;
+}
+
+/**
+ * Enum values are decoded as signed integers only for the signed ADST_*
+ * types, so the underlying type follows the same rule.
+ * @return underlying type of an enum of type.size bytes or nullptr
+ */
+static const char *EnumBase(const DataType &type)
+{
+	const auto isSigned =
+		(ADST_INT8 == type.adsType) || (ADST_INT16 == type.adsType) ||
+		(ADST_INT32 == type.adsType) || (ADST_INT64 == type.adsType);
+	switch (type.size) {
+	case 1:
+		return isSigned ? "int8_t" : "uint8_t";
+	case 2:
+		return isSigned ? "int16_t" : "uint16_t";
+	case 4:
+		return isSigned ? "int32_t" : "uint32_t";
+	case 8:
+		return isSigned ? "int64_t" : "uint64_t";
+	default:
+		return nullptr;
+	}
+}
+
+/** C++ declarator of a type split into a type name and an array suffix */
+struct Declarator {
+	std::string type;
+	std::string suffix;
+};
+
+struct HeaderGenerator {
+	std::ostream &os;
+	/** types and symbols share the namespace of the header */
+	Scope &global;
+	std::set<const DataType *> done;
+
+	/** emit the definition of named types before their first use */
+	Declarator Declare(const DataType &type, const uint32_t size)
+	{
+		if (!type.dimensions.empty()) {
+			size_t numElements = 1;
+			std::string suffix;
+			for (const auto &d : type.dimensions) {
+				numElements *= d.elements;
+				suffix += '[' + std::to_string(d.elements) + ']';
+			}
+			if (!numElements || (size % numElements)) {
+				return Opaque(size);
+			}
+			const auto elementSize =
+				static_cast<uint32_t>(size / numElements);
+			auto element = type.base ?
+					       Declare(*type.base, elementSize) :
+					       Scalar(type.adsType, elementSize);
+			element.suffix = suffix + element.suffix;
+			return element;
+		}
+
+		if (!type.enumValues.empty() || !type.fields.empty()) {
+			if ((type.size != size) ||
+			    (type.fields.empty() && !EnumBase(type))) {
+				return Opaque(size);
+			}
+			if (done.insert(&type).second) {
+				if (type.fields.empty()) {
+					DefineEnum(type);
+				} else {
+					DefineStruct(type);
+				}
+			}
+			return { global.Name(type.name), {} };
+		}
+
+		if (type.base) {
+			return Declare(*type.base, size);
+		}
+		return Scalar(type.adsType, size);
+	}
+
+	Declarator Scalar(const uint32_t adsType, const uint32_t size)
+	{
+		const auto builtin = Builtin(adsType, size);
+		if (builtin) {
+			return { builtin, {} };
+		}
+		if (ADST_STRING == adsType) {
+			return { "char", '[' + std::to_string(size) + ']' };
+		}
+		if ((ADST_WSTRING == adsType) && !(size % 2)) {
+			return { "char16_t", '[' + std::to_string(size / 2) + ']' };
+		}
+		return Opaque(size);
+	}
+
+	static Declarator Opaque(const uint32_t size)
+	{
+		return { "uint8_t", '[' + std::to_string(size) + ']' };
+	}
+
+	void DefineEnum(const DataType &type)
+	{
+		const std::string base = EnumBase(type);
+		const auto isUnsigned = ('u' == base[0]);
+		const auto &name = global.Name(type.name);
+		os << "enum class " << name << " : " << base << " {\n";
+		Scope enumerators;
+		for (const auto &e : type.enumValues) {
+			os << '\t' << enumerators.Name(e.first) << " = ";
+			if (isUnsigned) {
+				/* too large for a signed literal otherwise */
+				os << static_cast<uint64_t>(e.second) << 'u';
+			} else if (INT64_MIN == e.second) {
+				/* the literal overflows before negation */
+				os << "INT64_MIN";
+			} else {
+				os << e.second;
+			}
+			os << ",\n";
+		}
+		os << "};\n";
+		os << "static_assert(sizeof(" << name << ") == " << type.size
+		   << ", \"" << type.name << "\");\n\n";
+	}
+
+	void DefineStruct(const DataType &type)
+	{
+		std::vector<const DataType *> fields;
+		for (const auto &f : type.fields) {
+			fields.push_back(&f);
+		}
+		std::stable_sort(fields.begin(), fields.end(),
+				 [](const DataType *lhs, const DataType *rhs) {
+					 return lhs->offset < rhs->offset;
+				 });
+
+		/* nested types are defined first */
+		std::vector<Declarator> members;
+		for (const auto f : fields) {
+			members.push_back(Declare(*f, f->size));
+		}
+
+		const auto &name = global.Name(type.name);
+		os << "struct " << name << " {\n";
+		Scope scope;
+		uint32_t pos = 0;
+		size_t numReserved = 0;
+		for (size_t i = 0; i < fields.size(); ++i) {
+			const auto &f = *fields[i];
+			if ((f.offset < pos) || (f.offset + f.size > type.size)) {
+				os << "\t/* " << f.name << " at " << f.offset
+				   << " overlaps */\n";
+				continue;
+			}
+			if (f.offset > pos) {
+				os << "\tuint8_t "
+				   << Reserved(scope, numReserved) << '['
+				   << (f.offset - pos) << "];\n";
+			}
+			os << '\t' << members[i].type << ' '
+			   << scope.Name(f.name) << members[i].suffix << ';';
+			if (!f.typeName.empty()) {
+				os << " // " << f.typeName;
+			}
+			os << '\n';
+			pos = f.offset + f.size;
+		}
+		if (type.size > pos) {
+			os << "\tuint8_t " << Reserved(scope, numReserved)
+			   << '[' << (type.size - pos) << "];\n";
+		}
+		os << "};\n";
+		os << "static_assert(sizeof(" << name << ") == " << type.size
+		   << ", \"" << type.name << "\");\n\n";
+	}
+
+	static std::string Reserved(Scope &scope, size_t &numReserved)
+	{
+		return scope.Unique("reserved" + std::to_string(numReserved++));
+	}
+};
+
+void WriteCppHeader(std::ostream &os, const SymbolIndex &symbols,
+		    const DataTypeTable &types, const std::string &prefix,
+		    const std::string &nameSpace)
+{
+	std::ostringstream typeDefinitions;
+	std::ostringstream symbolDefinitions;
+	Scope global;
+	global.Unique("Symbol");
+	HeaderGenerator generator{ typeDefinitions, global, {} };
+
+	const auto range = symbols.Prefix(prefix);
+	for (auto i = range.first; i < range.second; ++i) {
+		const auto symbol = symbols[i];
+		const auto size = symbol.header.size;
+		if (!size) {
+			/* bit addressed symbols can't be described by a type */
+			continue;
+		}
+		const auto type = types.Find(symbol.typeName.str());
+		const auto decl = type ? generator.Declare(*type, size) :
+					 generator.Scalar(symbol.header.dataType,
+							  size);
+		const auto &name = global.Name(symbol.name.str());
+		symbolDefinitions << "/** " << symbol.name << " : "
+				  << symbol.typeName << " */\n";
+		if (decl.suffix.empty()) {
+			symbolDefinitions << "constexpr Symbol<" << decl.type
+					  << "> " << name;
+		} else {
+			const auto alias = global.Unique(name + "_t");
+			symbolDefinitions << "using " << alias << " = "
+					  << decl.type << decl.suffix << ";\n"
+					  << "constexpr Symbol<" << alias
+					  << "> " << name;
+		}
+		symbolDefinitions << "{ 0x" << std::hex << symbol.header.iGroup
+				  << ", 0x" << symbol.header.iOffs << std::dec
+				  << " };\n"
+				  << "static_assert(decltype(" << name
+				  << ")::size == " << size << ", \""
+				  << symbol.name << "\");\n\n";
+	}
+
+	os << "// generated from the symbol and datatype tables of the PLC\n"
+	   << "#pragma once\n\n"
+	   << "#include <cstdint>\n\n"
+	   << "namespace " << nameSpace << "\n{\n"
+	   << "/** index group and offset of a PLC symbol of type T */\n"
+	   << "template <typename T> struct Symbol {\n"
+	   << "\tusing type = T;\n"
+	   << "\tstatic constexpr uint32_t size = sizeof(T);\n"
+	   << "\tuint32_t indexGroup;\n"
+	   << "\tuint32_t indexOffset;\n"
+	   << "};\n\n"
+	   << "#pragma pack(push, 1)\n"
+	   << typeDefinitions.str() << "#pragma pack(pop)\n\n"
+	   << symbolDefinitions.str() << "}\n";
+}
+}
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "DataTypeTable.h"
+#include "SymbolIndex.h"
+#include <ostream>
+#include <string>
+
+namespace bhf
+{
+namespace ads
+{
+/**
+ * Write a self-contained C++ header for the symbols, whose names start with
+ * prefix. Every structure, enum and array type the symbols use becomes a
+ * packed struct, enum class or array with its size checked by
+ * static_assert. Each symbol becomes a constexpr Symbol<T> with its index
+ * group and offset, so a whole structure is read with a single request:
+ *
+ *   plc::ST_Axis axis;
+ *   device.ReadReqEx2(plc::MAIN_stAxis.indexGroup,
+ *                     plc::MAIN_stAxis.indexOffset, sizeof(axis), &axis,
+ *                     &bytesRead);
+ *
+ * Values are stored in little endian byte order like on the PLC.
+ */
+void WriteCppHeader(std::ostream &os, const SymbolIndex &symbols,
+		    const DataTypeTable &types, const std::string &prefix,
+		    const std::string &nameSpace = "plc");
+}
+}
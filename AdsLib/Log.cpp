@@ -7,10 +7,17 @@
 #include "Log.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #define TIME_T_TO_STRING(DATE_TIME, TIME_T)                 \
@@ -25,9 +32,13 @@
 	std::strftime(DATE_TIME, sizeof(DATE_TIME), "%FT%T ", \
 		      localtime(TIME_T));
 #else
-#define TIME_T_TO_STRING(DATE_TIME, TIME_T)                     \
-	std::strftime(DATE_TIME, sizeof(DATE_TIME), "%FT%T%z ", \
-		      localtime(TIME_T));
+#define TIME_T_TO_STRING(DATE_TIME, TIME_T)                           \
+	do {                                                          \
+		struct tm temp;                                       \
+		localtime_r(TIME_T, &temp);                           \
+		std::strftime(DATE_TIME, sizeof(DATE_TIME),           \
+			      "%FT%T%z ", &temp);                     \
+	} while (0);
 #endif
 
 size_t Logger::logLevel = CONFIG_DEFAULT_LOGLEVEL;
@@ -35,17 +46,232 @@ size_t Logger::logLevel = CONFIG_DEFAULT_LOGLEVEL;
 static const char *CATEGORY[] = { "Verbose: ", "Info: ", "Warning: ",
 				  "Error: " };
 
+static void Format(std::string &out, const std::time_t tt, const size_t level,
+		   const char *const msg, const size_t length)
+{
+	static const size_t numCategories = sizeof(CATEGORY) / sizeof(*CATEGORY);
+	const auto category = CATEGORY[std::min(level, numCategories - 1)];
+	char dateTime[28];
+
+	//TODO use std::put_time() when available
+	TIME_T_TO_STRING(dateTime, &tt);
+	out.append(dateTime).append(category).append(msg, length);
+	out.push_back('\n');
+}
+
+static std::time_t Now()
+{
+	return std::chrono::system_clock::to_time_t(
+		std::chrono::system_clock::now());
+}
+
+LogStream::LogStream()
+	: std::ostream(static_cast<std::streambuf *>(this))
+{
+	Reset();
+}
+
+void LogStream::Reset()
+{
+	setp(buffer, buffer + sizeof(buffer));
+	clear();
+	flags(std::ios_base::dec | std::ios_base::skipws);
+	width(0);
+	precision(6);
+	fill(' ');
+}
+
+const char *LogStream::data() const
+{
+	return pbase();
+}
+
+size_t LogStream::size() const
+{
+	return static_cast<size_t>(pptr() - pbase());
+}
+
+/**
+ * Bounded ring of messages, which are written by a background thread.
+ * Callers reserve a slot by advancing enqueuePos and publish it through the
+ * sequence of the slot, so they never wait for each other or the writer.
+ * The writer formats the messages straight out of the ring and releases
+ * their slots afterwards, so no allocations are needed.
+ */
+struct AsyncLog {
+	struct Entry {
+		/** position, which may write (== pos) or read (== pos + 1) */
+		std::atomic<size_t> sequence;
+		std::time_t time;
+		size_t level;
+		size_t length;
+		char msg[LogStream::CAPACITY];
+	};
+
+	AsyncLog(size_t capacity)
+		: ring(RoundUp(capacity))
+		, enqueuePos(0)
+		, dequeuePos(0)
+		, dropped(0)
+		, stopped(false)
+	{
+		for (size_t i = 0; i < ring.size(); ++i) {
+			ring[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		writer = std::thread(&AsyncLog::Run, this);
+	}
+
+	~AsyncLog()
+	{
+		stopped = true;
+		pending.notify_one();
+		writer.join();
+	}
+
+	void Push(const std::time_t tt, const size_t level,
+		  const char *const msg, const size_t length)
+	{
+		auto pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			auto &entry = ring[pos & (ring.size() - 1)];
+			const auto sequence =
+				entry.sequence.load(std::memory_order_acquire);
+			if (sequence == pos) {
+				if (!enqueuePos.compare_exchange_weak(
+					    pos, pos + 1,
+					    std::memory_order_relaxed)) {
+					continue;
+				}
+				entry.time = tt;
+				entry.level = level;
+				entry.length =
+					std::min(length, sizeof(entry.msg));
+				memcpy(entry.msg, msg, entry.length);
+				entry.sequence.store(pos + 1,
+						     std::memory_order_release);
+				pending.notify_one();
+				return;
+			}
+			if (sequence < pos) {
+				/* the writer didn't release this slot yet */
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+    private:
+	std::vector<Entry> ring;
+	std::atomic<size_t> enqueuePos;
+	/** only used by the writer */
+	size_t dequeuePos;
+	std::atomic<size_t> dropped;
+	std::atomic<bool> stopped;
+	/** only for the writer to sleep on, producers notify without it */
+	std::mutex mutex;
+	std::condition_variable pending;
+	std::thread writer;
+
+	static size_t RoundUp(const size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity) {
+			size *= 2;
+		}
+		return size;
+	}
+
+	Entry *Next()
+	{
+		auto &entry = ring[dequeuePos & (ring.size() - 1)];
+		const auto sequence =
+			entry.sequence.load(std::memory_order_acquire);
+		return (sequence == dequeuePos + 1) ? &entry : nullptr;
+	}
+
+	void Run()
+	{
+		std::string text;
+		for (;;) {
+			text.clear();
+			for (auto entry = Next(); entry; entry = Next()) {
+				Format(text, entry->time, entry->level,
+				       entry->msg, entry->length);
+				entry->sequence.store(dequeuePos + ring.size(),
+						      std::memory_order_release);
+				++dequeuePos;
+			}
+			const auto numDropped = dropped.exchange(0);
+			if (numDropped) {
+				const auto msg = std::to_string(numDropped) +
+						 " log messages dropped";
+				Format(text, Now(), 2, msg.data(), msg.size());
+			}
+			if (!text.empty()) {
+				std::cerr.write(text.data(), text.size());
+				std::cerr.flush();
+				continue;
+			}
+			if (stopped) {
+				return;
+			}
+
+			/* a notification might slip past the predicate */
+			std::unique_lock<std::mutex> lock(mutex);
+			pending.wait_for(lock, std::chrono::milliseconds(10),
+					 [&]() { return stopped || Next(); });
+		}
+	}
+};
+
+/** serializes SetAsync() */
+static std::mutex asyncLogMutex;
+static std::atomic<AsyncLog *> asyncLog{ nullptr };
+/** Log() calls, which might still use the AsyncLog they loaded */
+static std::atomic<size_t> asyncLogUsers{ 0 };
+
+void Logger::SetAsync(const size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(asyncLogMutex);
+	std::unique_ptr<AsyncLog> previous{ asyncLog.exchange(
+		capacity ? new AsyncLog{ capacity } : nullptr) };
+	while (asyncLogUsers) {
+		std::this_thread::yield();
+	}
+	/* the old writer flushes its pending messages, when it is destroyed */
+}
+
+LogStream &Logger::Stream()
+{
+	static thread_local LogStream stream;
+	stream.Reset();
+	return stream;
+}
+
 void Logger::Log(const size_t level, const std::string &msg)
 {
-	if (level >= logLevel) {
-		std::time_t tt = std::chrono::system_clock::to_time_t(
-			std::chrono::system_clock::now());
-		const auto category = CATEGORY[std::min(
-			level, sizeof(CATEGORY) / sizeof(CATEGORY[0]))];
-		char dateTime[28];
+	Log(level, msg.data(), msg.size());
+}
 
-		//TODO use std::put_time() when available
-		TIME_T_TO_STRING(dateTime, &tt);
-		std::cerr << dateTime << category << msg << std::endl;
+void Logger::Log(const size_t level, const char *const msg,
+		 const size_t length)
+{
+	if (level < logLevel) {
+		return;
 	}
+	const auto tt = Now();
+	++asyncLogUsers;
+	const auto log = asyncLog.load();
+	if (log) {
+		log->Push(tt, level, msg, length);
+	}
+	--asyncLogUsers;
+	if (log) {
+		return;
+	}
+
+	std::string text;
+	Format(text, tt, level, msg, length);
+	std::cerr << text;
 }
@@ -6,15 +6,23 @@
 
 #pragma once
 
-#include <sstream>
+#include <ostream>
+#include <string>
 
 #define asHex(X) "0x" << std::hex << (int)(X)
 
-#define LOG(LEVEL, ARGS)                          \
-	do {                                      \
-		std::stringstream stream;         \
-		stream << ARGS;                   \
-		Logger::Log(LEVEL, stream.str()); \
+/*
+ * Messages below logLevel are dropped before they are formatted. Others are
+ * formatted into a buffer of the calling thread, so logging doesn't allocate.
+ */
+#define LOG(LEVEL, ARGS)                                     \
+	do {                                                 \
+		if ((LEVEL) >= Logger::logLevel) {           \
+			auto &logStream = Logger::Stream();  \
+			logStream << ARGS;                   \
+			Logger::Log(LEVEL, logStream.data(), \
+				    logStream.size());       \
+		}                                            \
 	} while (0)
 
 #define LOG_VERBOSE(ARGS) LOG(0, ARGS)
@@ -22,7 +30,35 @@
 #define LOG_WARN(ARGS) LOG(2, ARGS)
 #define LOG_ERROR(ARGS) LOG(3, ARGS)
 
+/** Stream into a fixed buffer, longer messages are truncated */
+struct LogStream : private std::streambuf, public std::ostream {
+	static const size_t CAPACITY = 1024;
+
+	LogStream();
+
+	/** Discard the message and restore the default formatting */
+	void Reset();
+	const char *data() const;
+	size_t size() const;
+
+    private:
+	char buffer[CAPACITY];
+};
+
 struct Logger {
 	static size_t logLevel;
 	static void Log(size_t level, const std::string &msg);
+	static void Log(size_t level, const char *msg, size_t length);
+
+	/** @return the empty LogStream of the calling thread */
+	static LogStream &Stream();
+
+	/**
+	 * Hand the messages to a background thread, which writes them to
+	 * std::cerr in batches, so logging never blocks the caller on I/O.
+	 * Callers reserve a slot of the ring without taking a lock. If capacity
+	 * messages are pending already, new messages are dropped and only
+	 * their number is reported. 0 restores synchronous logging.
+	 */
+	static void SetAsync(size_t capacity);
 };
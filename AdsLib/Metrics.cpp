@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "Metrics.h"
+
+#include <sstream>
+
+namespace bhf
+{
+namespace ads
+{
+static const char *const COMMAND_NAMES[NUM_AOE_COMMANDS] = {
+	"INVALID",
+	"READ_DEVICE_INFO",
+	"READ",
+	"WRITE",
+	"READ_STATE",
+	"WRITE_CONTROL",
+	"ADD_DEVICE_NOTIFICATION",
+	"DEL_DEVICE_NOTIFICATION",
+	"DEVICE_NOTIFICATION",
+	"READ_WRITE",
+};
+
+static void Describe(std::ostream &os, const char *name, const char *type,
+		     const char *help)
+{
+	os << "# HELP " << name << ' ' << help << '\n';
+	os << "# TYPE " << name << ' ' << type << '\n';
+}
+
+static void WriteCounter(std::ostream &os, const char *name, const char *help,
+			 uint64_t value)
+{
+	Describe(os, name, "counter", help);
+	os << name << ' ' << value << '\n';
+}
+
+static void
+WritePerCommand(std::ostream &os, const char *name, const char *help,
+		const std::array<uint64_t, NUM_AOE_COMMANDS> &values)
+{
+	Describe(os, name, "counter", help);
+	for (size_t i = 0; i < NUM_AOE_COMMANDS; ++i) {
+		os << name << "{command=\"" << COMMAND_NAMES[i] << "\"} "
+		   << values[i] << '\n';
+	}
+}
+
+std::string MetricsSnapshot::ToPrometheus() const
+{
+	std::ostringstream os;
+	WritePerCommand(os, "ads_requests_total", "Requests sent per command",
+			requests);
+	WritePerCommand(os, "ads_responses_total",
+			"Responses received per command", responses);
+	WriteCounter(os, "ads_sent_bytes_total", "Bytes sent to ADS servers",
+		     bytesSent);
+	WriteCounter(os, "ads_received_bytes_total",
+		     "Bytes received from ADS servers", bytesReceived);
+	WriteCounter(os, "ads_timeouts_total",
+		     "Requests, which ran into their timeout", timeouts);
+	WriteCounter(os, "ads_invoke_id_mismatches_total",
+		     "Responses without a matching request", invokeIdMismatches);
+	WriteCounter(os, "ads_junk_bytes_total",
+		     "Received bytes, which were discarded", junkBytes);
+	WriteCounter(os, "ads_notification_frames_total",
+		     "Notification frames queued for the callbacks",
+		     notificationFrames);
+	WriteCounter(os, "ads_notification_samples_total",
+		     "Notification samples passed to the callbacks",
+		     notificationSamples);
+	WriteCounter(os, "ads_notification_dropped_frames_total",
+		     "Notification frames, which were dropped",
+		     droppedNotificationFrames);
+	WriteCounter(os, "ads_notification_dropped_bytes_total",
+		     "Bytes of notification frames, which were dropped",
+		     droppedNotificationBytes);
+	Describe(os, "ads_notification_queued_bytes_max", "gauge",
+		 "Highest number of bytes queued in a notification buffer");
+	os << "ads_notification_queued_bytes_max "
+	   << maxQueuedNotificationBytes << '\n';
+	WriteCounter(os, "ads_reconnects_total",
+		     "Connections, which were established again", reconnects);
+	return os.str();
+}
+
+MetricsSnapshot Metrics::Snapshot() const
+{
+	static const auto relaxed = std::memory_order_relaxed;
+	MetricsSnapshot snapshot;
+	for (size_t i = 0; i < NUM_AOE_COMMANDS; ++i) {
+		snapshot.requests[i] = requests[i].load(relaxed);
+		snapshot.responses[i] = responses[i].load(relaxed);
+	}
+	snapshot.bytesSent = bytesSent.load(relaxed);
+	snapshot.bytesReceived = bytesReceived.load(relaxed);
+	snapshot.timeouts = timeouts.load(relaxed);
+	snapshot.invokeIdMismatches = invokeIdMismatches.load(relaxed);
+	snapshot.junkBytes = junkBytes.load(relaxed);
+	snapshot.notificationFrames = notificationFrames.load(relaxed);
+	snapshot.notificationSamples = notificationSamples.load(relaxed);
+	snapshot.droppedNotificationFrames =
+		droppedNotificationFrames.load(relaxed);
+	snapshot.droppedNotificationBytes =
+		droppedNotificationBytes.load(relaxed);
+	snapshot.maxQueuedNotificationBytes =
+		maxQueuedNotificationBytes.load(relaxed);
+	snapshot.reconnects = reconnects.load(relaxed);
+	return snapshot;
+}
+}
+}
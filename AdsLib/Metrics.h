@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace bhf
+{
+namespace ads
+{
+/** counters are kept per AoE command id from INVALID to READ_WRITE */
+static const size_t NUM_AOE_COMMANDS = 10;
+
+/** Copy of the counters of a Metrics object at one point in time */
+struct MetricsSnapshot {
+	/** requests sent per command id */
+	std::array<uint64_t, NUM_AOE_COMMANDS> requests{};
+	/** responses received per command id */
+	std::array<uint64_t, NUM_AOE_COMMANDS> responses{};
+	uint64_t bytesSent = 0;
+	uint64_t bytesReceived = 0;
+	/** requests completed with ADSERR_CLIENT_SYNCTIMEOUT */
+	uint64_t timeouts = 0;
+	/** responses without a matching request in flight */
+	uint64_t invokeIdMismatches = 0;
+	/** bytes, which were received but discarded */
+	uint64_t junkBytes = 0;
+	/** DEVICE_NOTIFICATION frames handed to a notification buffer */
+	uint64_t notificationFrames = 0;
+	/** samples passed to a notification callback */
+	uint64_t notificationSamples = 0;
+	/** frames lost, because the buffer was full or nobody subscribed */
+	uint64_t droppedNotificationFrames = 0;
+	uint64_t droppedNotificationBytes = 0;
+	/** highest number of bytes queued in a notification buffer at once */
+	uint64_t maxQueuedNotificationBytes = 0;
+	/** connections, which were established again after they were lost */
+	uint64_t reconnects = 0;
+
+	/** @return the counters in the Prometheus text exposition format */
+	std::string ToPrometheus() const;
+};
+
+/**
+ * Counters of a router and all its connections. They are updated with
+ * relaxed atomic operations only, so they never block the data path.
+ */
+struct Metrics {
+	using CommandCounters =
+		std::array<std::atomic<uint64_t>, NUM_AOE_COMMANDS>;
+
+	CommandCounters requests{};
+	CommandCounters responses{};
+	std::atomic<uint64_t> bytesSent{ 0 };
+	std::atomic<uint64_t> bytesReceived{ 0 };
+	std::atomic<uint64_t> timeouts{ 0 };
+	std::atomic<uint64_t> invokeIdMismatches{ 0 };
+	std::atomic<uint64_t> junkBytes{ 0 };
+	std::atomic<uint64_t> notificationFrames{ 0 };
+	std::atomic<uint64_t> notificationSamples{ 0 };
+	std::atomic<uint64_t> droppedNotificationFrames{ 0 };
+	std::atomic<uint64_t> droppedNotificationBytes{ 0 };
+	std::atomic<uint64_t> maxQueuedNotificationBytes{ 0 };
+	std::atomic<uint64_t> reconnects{ 0 };
+
+	static void Add(std::atomic<uint64_t> &counter, uint64_t value = 1)
+	{
+		counter.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	static void Max(std::atomic<uint64_t> &mark, uint64_t value)
+	{
+		auto current = mark.load(std::memory_order_relaxed);
+		while ((current < value) &&
+		       !mark.compare_exchange_weak(current, value,
+						   std::memory_order_relaxed)) {
+		}
+	}
+
+	/** count a request or response, unknown command ids are ignored */
+	static void Add(CommandCounters &counters, uint16_t cmdId)
+	{
+		if (cmdId < NUM_AOE_COMMANDS) {
+			Add(counters[cmdId]);
+		}
+	}
+
+	MetricsSnapshot Snapshot() const;
+};
+}
+}
@@ -7,35 +7,124 @@
 
 #include "AdsNotification.h"
 #include "AmsHeader.h"
-#include "Semaphore.h"
+#include "Metrics.h"
 
-#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 using DeleteNotificationCallback =
 	std::function<long(uint32_t hNotify, uint32_t tmms)>;
 
-struct NotificationDispatcher {
-	NotificationDispatcher(DeleteNotificationCallback callback);
+/** Send ADD_DEVICE_NOTIFICATION and return the new handle in hNotify */
+using SubscribeCallback =
+	std::function<long(const Notification &notification, uint32_t &hNotify)>;
+
+/** default capacity of the frame queue of a NotificationDispatcher */
+static const size_t DEFAULT_NOTIFICATION_CAPACITY = 4 * 1024 * 1024;
+
+struct NotificationDispatcher;
+using SharedDispatcher = std::shared_ptr<NotificationDispatcher>;
+
+/**
+ * Fixed pool of threads, which invokes the callbacks of any number of
+ * NotificationDispatchers. A dispatcher is only processed by one of the
+ * threads at a time, so the order of its notifications is preserved.
+ */
+struct NotificationPool {
+	NotificationPool(size_t numThreads);
+	~NotificationPool();
+
+	/** Queue a dispatcher, which has frames to process */
+	void Schedule(SharedDispatcher dispatcher);
+
+    private:
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<SharedDispatcher> queue;
+	bool stopped;
+	std::vector<std::thread> threads;
+
+	void Run();
+};
+
+struct NotificationDispatcher
+	: std::enable_shared_from_this<NotificationDispatcher> {
+	/**
+	 * @param[in] pool if provided, the callbacks are invoked by the threads
+	 *            of this pool instead of an own thread
+	 * @param[in] metrics if provided, delivered and dropped notifications
+	 *            are counted there, too
+	 */
+	NotificationDispatcher(DeleteNotificationCallback callback,
+			       NotificationPool *pool = nullptr,
+			       bhf::ads::Metrics *metrics = nullptr);
 	~NotificationDispatcher();
 	void Emplace(uint32_t hNotify,
 		     std::shared_ptr<Notification> notification);
+
+	/** @param[in] hNotify handle, which was returned to the application */
 	long Erase(uint32_t hNotify, uint32_t tmms);
-	void Notify();
+
+	/**
+	 * Forget the handles of all notifications, because the connection to
+	 * the ADS server was lost and with it all its subscriptions.
+	 */
+	void Detach();
+
+	/**
+	 * Subscribe the detached notifications again. The server assigns new
+	 * handles, which are mapped to the ones of the application, so the
+	 * callbacks still see the old ones. Dispatching continues meanwhile,
+	 * each handle is published as soon as its subscription returned.
+	 * @return false, if some notifications are still detached
+	 */
+	bool Reattach(const SubscribeCallback &subscribe);
+
+	/** Change the capacity and overflow policy of the frame queue */
+	void Configure(const bhf::ads::NotificationBufferConfig &config);
+	bhf::ads::NotificationStats GetStats();
+
+	/**
+	 * Queue a copy of the payload of a DEVICE_NOTIFICATION frame
+	 * @return false, if the frame was dropped
+	 */
+	bool Enqueue(const uint8_t *frame, uint32_t length);
 	void Run();
 
+	/** Process the frames queued so far, invoked by the NotificationPool */
+	void Drain();
+
 	const DeleteNotificationCallback deleteNotification;
-	RingBuffer ring;
+	NotificationPool *const pool;
+	bhf::ads::Metrics *const metrics;
 
     private:
+	/** subscribed notifications, keyed by the handle of the server */
 	std::map<uint32_t, std::shared_ptr<Notification> > notifications;
+	std::vector<std::shared_ptr<Notification> > detached;
 	std::recursive_mutex mutex;
-	Semaphore sem;
-	std::atomic<bool> stopExecution;
+
+	/** frames received, but not yet processed, prefixed with their length */
+	std::vector<uint8_t> queue;
+	std::vector<uint8_t> processing;
+	std::mutex queueMutex;
+	std::condition_variable queueChanged;
+	bhf::ads::NotificationBufferConfig config;
+	bhf::ads::NotificationStats stats;
+	bool scheduled;
+	bool stopExecution;
 	std::thread thread;
 
 	std::shared_ptr<Notification> Find(uint32_t hNotify);
+	void CountDropped(uint64_t length);
+	bool MakeRoom(std::unique_lock<std::mutex> &lock, size_t length);
+	void DispatchFrames();
+	void Dispatch(uint8_t *frame, size_t length);
+	void Deliver(Notification &notification, uint64_t timestamp,
+		     uint32_t hNotify, uint8_t *data);
 };
-using SharedDispatcher = std::shared_ptr<NotificationDispatcher>;
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Open addressing hash table of requests waiting for their response, keyed
+ * by invokeId. Slots are reused, so Insert() only allocates, when more
+ * requests are in flight than ever before on this table. InvokeId 0 is never
+ * used and marks free slots.
+ */
+template <class T> struct PendingTable {
+	/** @param[in] capacity initial number of slots, a power of two */
+	PendingTable(size_t capacity = 64)
+		: slots(capacity, Slot{ 0, nullptr })
+		, used(0)
+	{
+		assert(capacity && !(capacity & (capacity - 1)));
+	}
+
+	/** @return false, if id is in use already */
+	bool Insert(const uint32_t id, T *const value)
+	{
+		assert(id);
+		if (2 * (used + 1) > slots.size()) {
+			Grow();
+		}
+		auto i = Index(id);
+		for (; slots[i].id; i = Next(i)) {
+			if (id == slots[i].id) {
+				return false;
+			}
+		}
+		slots[i] = Slot{ id, value };
+		++used;
+		return true;
+	}
+
+	/** @return value stored for id or nullptr */
+	T *Find(const uint32_t id) const
+	{
+		for (auto i = Index(id); slots[i].id; i = Next(i)) {
+			if (id == slots[i].id) {
+				return slots[i].value;
+			}
+		}
+		return nullptr;
+	}
+
+	/** Remove id, which has to be in the table */
+	void Erase(const uint32_t id)
+	{
+		auto hole = Index(id);
+		while (id != slots[hole].id) {
+			assert(slots[hole].id);
+			hole = Next(hole);
+		}
+
+		/* move later entries of the probe sequence into the hole */
+		for (auto i = Next(hole); slots[i].id; i = Next(i)) {
+			/* entries probed from at or before the hole fill it */
+			const auto mask = slots.size() - 1;
+			const auto probed = (i - Index(slots[i].id)) & mask;
+			if (probed >= ((i - hole) & mask)) {
+				slots[hole] = slots[i];
+				hole = i;
+			}
+		}
+		slots[hole] = Slot{ 0, nullptr };
+		--used;
+	}
+
+	size_t Size() const
+	{
+		return used;
+	}
+
+    private:
+	struct Slot {
+		uint32_t id;
+		T *value;
+	};
+	std::vector<Slot> slots;
+	size_t used;
+
+	/* invokeIds are mostly consecutive, so they spread well as they are */
+	size_t Index(const uint32_t id) const
+	{
+		return id & (slots.size() - 1);
+	}
+
+	size_t Next(const size_t i) const
+	{
+		return (i + 1) & (slots.size() - 1);
+	}
+
+	void Grow()
+	{
+		std::vector<Slot> old(2 * slots.size(), Slot{ 0, nullptr });
+		old.swap(slots);
+		used = 0;
+		for (const auto &slot : old) {
+			if (slot.id) {
+				Insert(slot.id, slot.value);
+			}
+		}
+	}
+};
@@ -13,6 +13,7 @@
 #include <limits>
 #include <list>
 #include <map>
+#include <sstream>
 
 #define PARSING_EXCEPTION(msg)                                              \
 	do {                                                                \
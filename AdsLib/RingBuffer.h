@@ -62,9 +62,12 @@ struct RingBuffer {
 	const size_t dataSize;
 	const std::unique_ptr<uint8_t[]> data;
 
-	inline uint8_t *Increment(const uint8_t *ptr, size_t n)
+	inline uint8_t *Increment(const uint8_t *ptr, size_t n) const
 	{
-		return data.get() + ((ptr - data.get() + n) % dataSize);
+		assert(n < dataSize);
+		const size_t offset = ptr - data.get() + n;
+		return data.get() +
+		       ((offset < dataSize) ? offset : offset - dataSize);
 	}
 
     public:
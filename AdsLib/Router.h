@@ -6,6 +6,7 @@
 #pragma once
 
 #include "AdsDef.h"
+#include "Metrics.h"
 
 struct Router {
 	static const size_t NUM_PORTS_MAX = 128;
@@ -17,4 +18,7 @@ struct Router {
 	}
 
 	virtual long GetLocalAddress(uint16_t port, AmsAddr *pAddr) = 0;
+
+	/** counters of all connections of this router */
+	bhf::ads::Metrics metrics;
 };
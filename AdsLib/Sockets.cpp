@@ -13,6 +13,13 @@
 #include <sstream>
 #include <system_error>
 
+/* writing to a lost connection should fail, instead of raising SIGPIPE */
+#if defined(MSG_NOSIGNAL)
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
 namespace bhf
 {
 namespace ads
@@ -168,7 +175,8 @@ void Socket::Shutdown()
 
 size_t Socket::read(uint8_t *buffer, size_t maxBytes, timeval *timeout) const
 {
-	if (!Select(timeout)) {
+	/* without a timeout a blocking recv() is sufficient */
+	if (timeout && !Select(timeout)) {
 		return 0;
 	}
 
@@ -190,6 +198,35 @@ size_t Socket::read(uint8_t *buffer, size_t maxBytes, timeval *timeout) const
 	return 0;
 }
 
+size_t Socket::TryRead(uint8_t *buffer, size_t maxBytes) const
+{
+#if defined(MSG_DONTWAIT)
+	const auto msvcMaxBytes = static_cast<int>(
+		std::min<size_t>(std::numeric_limits<int>::max(), maxBytes));
+	const int bytesRead = recv(m_Socket, reinterpret_cast<char *>(buffer),
+				   msvcMaxBytes, MSG_DONTWAIT);
+	if (bytesRead > 0) {
+		return bytesRead;
+	}
+	const auto lastError = WSAGetLastError();
+	if ((bytesRead < 0) &&
+	    ((EAGAIN == lastError) || (EWOULDBLOCK == lastError))) {
+		return 0;
+	}
+	if ((0 == bytesRead) || (lastError == CONNECTION_CLOSED) ||
+	    (lastError == CONNECTION_ABORTED)) {
+		throw std::runtime_error("connection closed by remote");
+	}
+	LOG_ERROR("read frame failed with error: "
+		  << std::dec << std::strerror(lastError));
+	throw std::runtime_error("read frame failed");
+#else
+	(void)buffer;
+	(void)maxBytes;
+	throw std::runtime_error("non blocking read is not supported");
+#endif
+}
+
 Frame &Socket::read(Frame &frame, timeval *timeout) const
 {
 	const size_t bytesRead =
@@ -242,8 +279,8 @@ size_t Socket::write(const Frame &frame) const
 
 	const int bufferLength = static_cast<int>(frame.size());
 	const char *const buffer = reinterpret_cast<const char *>(frame.data());
-	const int status = sendto(m_Socket, buffer, bufferLength, 0, m_DestAddr,
-				  m_DestAddrLen);
+	const int status = sendto(m_Socket, buffer, bufferLength, SEND_FLAGS,
+				  m_DestAddr, m_DestAddrLen);
 
 	if (SOCKET_ERROR == status) {
 		LOG_ERROR("write frame failed with error: "
@@ -253,17 +290,42 @@ size_t Socket::write(const Frame &frame) const
 	return status;
 }
 
-TcpSocket::TcpSocket(const struct addrinfo *const host)
-	: Socket(host, SOCK_STREAM)
+static void ConfigureNoDelay(const SOCKET socket)
 {
 	// AdsDll.lib seems to use TCP_NODELAY, we use it to be compatible
-	const int enable = 0;
-	if (setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY,
-		       (const char *)&enable, sizeof(enable))) {
+	const int enable = 1;
+	if (setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&enable,
+		       sizeof(enable))) {
 		LOG_WARN("Enabling TCP_NODELAY failed");
 	}
 }
 
+TcpSocket::TcpSocket(const struct addrinfo *const host)
+	: Socket(host, SOCK_STREAM)
+{
+	ConfigureNoDelay(m_Socket);
+}
+
+bool TcpSocket::Reconnect()
+{
+	const auto family = m_SockAddress.ss_family;
+	const socklen_t length = (AF_INET6 == family) ? sizeof(sockaddr_in6) :
+							 sizeof(sockaddr_in);
+	const auto next = socket(family, SOCK_STREAM, 0);
+	if (INVALID_SOCKET == next) {
+		return false;
+	}
+	if (::connect(next, reinterpret_cast<const sockaddr *>(&m_SockAddress),
+		      length)) {
+		closesocket(next);
+		return false;
+	}
+	ConfigureNoDelay(next);
+	closesocket(m_Socket);
+	m_Socket = next;
+	return true;
+}
+
 uint32_t TcpSocket::Connect() const
 {
 	struct sockaddr_storage source;
@@ -36,6 +36,18 @@ struct IpV4 {
 struct Socket {
 	Frame &read(Frame &frame, timeval *timeout) const;
 	size_t read(uint8_t *buffer, size_t maxBytes, timeval *timeout) const;
+
+	/**
+	 * Read the data, which is already available, without blocking.
+	 * @return number of bytes read, 0 if no data was available
+	 * @throw std::runtime_error if the connection was closed
+	 */
+	size_t TryRead(uint8_t *buffer, size_t maxBytes) const;
+	SOCKET NativeHandle() const
+	{
+		return m_Socket;
+	}
+
 	size_t write(const Frame &frame) const;
 	void Shutdown();
 
@@ -62,6 +74,13 @@ struct TcpSocket : Socket {
 	TcpSocket(const struct addrinfo *host);
 	uint32_t Connect() const;
 
+	/**
+	 * Replace the connection with a new one to the same address. Nobody
+	 * may read or write the socket meanwhile.
+	 * @return false, if the address couldn't be reached
+	 */
+	bool Reconnect();
+
 	/**
      * Confirm if this TcpSocket is connected to one of the target addresses.
      * @param[in] targetAddresses pointer to a previously allocated list of
@@ -5,9 +5,11 @@
  */
 
 #include "SymbolAccess.h"
+#include "HeaderGenerator.h"
 #include "Log.h"
 #include <iostream>
 #include <limits>
+#include <sstream>
 #include <vector>
 
 namespace bhf
@@ -75,14 +77,16 @@ std::pair<std::string, SymbolEntry> SymbolEntry::Parse(const uint8_t *data,
 	return { entry.name, entry };
 }
 
-void SymbolEntry::WriteAsJSON(std::ostream &os) const
+template <typename Entry>
+static void WriteAsJSON(std::ostream &os, const Entry &entry)
 {
-#define JSONEntryHex(member) \
-	"  \"" << #member << "\": \"0x" << std::hex << header.member << "\",\n"
+#define JSONEntryHex(member)                                \
+	"  \"" << #member << "\": \"0x" << std::hex              \
+	       << entry.header.member << "\",\n"
 #define JSONEntryString(member) \
-	"  \"" << #member << "\": \"" << member << "\",\n"
+	"  \"" << #member << "\": \"" << entry.member << "\",\n"
 #define JSONNumber(member) \
-	"  \"" << #member << "\": " << std::dec << header.member
+	"  \"" << #member << "\": " << std::dec << entry.header.member
 #define JSONEntryNumber(member) JSONNumber(member) << ",\n"
 
 	os << "{\n"
@@ -95,20 +99,30 @@ void SymbolEntry::WriteAsJSON(std::ostream &os) const
 	   << "}\n";
 }
 
+void SymbolEntry::WriteAsJSON(std::ostream &os) const
+{
+	bhf::ads::WriteAsJSON(os, *this);
+}
+
 SymbolAccess::SymbolAccess(const std::string &gw, const AmsNetId netid,
-			   const uint16_t port)
+			   const uint16_t port, const std::string &cacheFile)
 	: device(gw, netid, port ? port : uint16_t(AMSPORT_R0_PLC_TC3))
+	, cache(cacheFile.empty() ? nullptr : new SymbolCache{ cacheFile })
 {
 }
 
-SymbolEntryMap SymbolAccess::FetchSymbolEntries() const
+SymbolCache::Key SymbolAccess::FetchCacheKey() const
 {
 	uint32_t bytesRead = 0;
-	struct AdsSymbolUploadInfo {
+	struct AdsSymbolUploadInfo2 {
 		uint32_t nSymbols;
 		uint32_t nSymSize;
+		uint32_t nDatatypes;
+		uint32_t nDatatypeSize;
+		uint32_t nMaxDynSymbols;
+		uint32_t nUsedDynSymbols;
 	} uploadInfo;
-	auto status = device.ReadReqEx2(ADSIGRP_SYM_UPLOADINFO, 0,
+	auto status = device.ReadReqEx2(ADSIGRP_SYM_UPLOADINFO2, 0,
 					sizeof(uploadInfo), &uploadInfo,
 					&bytesRead);
 	if (ADSERR_NOERR != status) {
@@ -118,45 +132,120 @@ SymbolEntryMap SymbolAccess::FetchSymbolEntries() const
 		throw AdsException(status);
 	}
 
-	uploadInfo.nSymSize = bhf::ads::letoh(uploadInfo.nSymSize);
-	std::vector<uint8_t> symbols(uploadInfo.nSymSize);
-	status = device.ReadReqEx2(ADSIGRP_SYM_UPLOAD, 0, uploadInfo.nSymSize,
-				   symbols.data(), &bytesRead);
+	uint8_t version = 0;
+	if (cache) {
+		status = device.ReadReqEx2(ADSIGRP_SYM_VERSION, 0,
+					   sizeof(version), &version,
+					   &bytesRead);
+		if (ADSERR_NOERR != status) {
+			LOG_ERROR(__FUNCTION__
+				  << "(): Reading symbol version failed with: 0x"
+				  << std::hex << status << '\n');
+			throw AdsException(status);
+		}
+	}
+	return { device.m_Addr,
+		 version,
+		 bhf::ads::letoh(uploadInfo.nSymbols),
+		 bhf::ads::letoh(uploadInfo.nSymSize),
+		 bhf::ads::letoh(uploadInfo.nDatatypes),
+		 bhf::ads::letoh(uploadInfo.nDatatypeSize),
+		 bhf::ads::letoh(uploadInfo.nMaxDynSymbols),
+		 bhf::ads::letoh(uploadInfo.nUsedDynSymbols) };
+}
+
+SymbolIndex SymbolAccess::FetchSymbolIndex() const
+{
+	const auto key = FetchCacheKey();
+	const auto cached = cache ? cache->Find(key) : nullptr;
+	if (cached) {
+		try {
+			return SymbolIndex{ cached, key.nSymSize, key.nSymbols };
+		} catch (const AdsException &ex) {
+			LOG_WARN(__FUNCTION__ << "(): Ignoring corrupt cache: "
+					      << ex.what() << '\n');
+		}
+	}
+
+	const auto symbols =
+		std::make_shared<std::vector<uint8_t> >(key.nSymSize);
+	uint32_t bytesRead = 0;
+	const auto status = device.ReadReqEx2(ADSIGRP_SYM_UPLOAD, 0,
+					      key.nSymSize, symbols->data(),
+					      &bytesRead);
 	if (ADSERR_NOERR != status) {
 		LOG_ERROR(__FUNCTION__ << "(): Reading symbols failed with: 0x"
 				       << std::hex << status << '\n');
 		throw AdsException(status);
 	}
+	const auto data = std::shared_ptr<const uint8_t>(symbols,
+							 symbols->data());
+	/* validate the upload, before it replaces a corrupt cache */
+	auto index = SymbolIndex{ data, bytesRead, key.nSymbols };
+	if (cache && (bytesRead == key.nSymSize)) {
+		cache->Store(key, data.get());
+	}
+	return index;
+}
 
-	const uint8_t *data = symbols.data();
-	auto nSymbols = bhf::ads::letoh(uploadInfo.nSymbols);
-	auto entries = std::map<std::string, SymbolEntry>{};
-	while (nSymbols--) {
-		const auto next = entries.insert(bhf::ads::SymbolEntry::Parse(
-							 data, bytesRead))
-					  .first->second;
-		bytesRead -= next.header.entryLength;
-		data += next.header.entryLength;
-		if (!bytesRead) {
-			return entries;
-		}
+SymbolEntryMap SymbolAccess::FetchSymbolEntries() const
+{
+	const auto index = FetchSymbolIndex();
+	auto entries = SymbolEntryMap{};
+	for (size_t i = 0; i < index.size(); ++i) {
+		const auto view = index[i];
+		entries.emplace(view.name.str(),
+				SymbolEntry{ view.header, view.name.str(),
+					     view.typeName.str(),
+					     view.comment.str() });
+	}
+	return entries;
+}
+
+DataTypeTable SymbolAccess::FetchDataTypes() const
+{
+	uint32_t bytesRead = 0;
+	struct AdsSymbolUploadInfo2 {
+		uint32_t nSymbols;
+		uint32_t nSymSize;
+		uint32_t nDatatypes;
+		uint32_t nDatatypeSize;
+		uint32_t nMaxDynSymbols;
+		uint32_t nUsedDynSymbols;
+	} uploadInfo;
+	auto status = device.ReadReqEx2(ADSIGRP_SYM_UPLOADINFO2, 0,
+					sizeof(uploadInfo), &uploadInfo,
+					&bytesRead);
+	if (ADSERR_NOERR != status) {
+		LOG_ERROR(__FUNCTION__
+			  << "(): Reading datatype info failed with: 0x"
+			  << std::hex << status << '\n');
+		throw AdsException(status);
+	}
+
+	std::vector<uint8_t> datatypes(letoh(uploadInfo.nDatatypeSize));
+	status = device.ReadReqEx2(ADSIGRP_SYM_DT_UPLOAD, 0, datatypes.size(),
+				   datatypes.data(), &bytesRead);
+	if (ADSERR_NOERR != status) {
+		LOG_ERROR(__FUNCTION__ << "(): Reading datatypes failed with: 0x"
+				       << std::hex << status << '\n');
+		throw AdsException(status);
 	}
-	LOG_ERROR(__FUNCTION__ << "(): nSymbols: " << uploadInfo.nSymbols
-			       << " nSymSize:" << uploadInfo.nSymSize << "'\n");
-	throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	return DataTypeTable{ datatypes.data(), bytesRead,
+			      letoh(uploadInfo.nDatatypes) };
 }
 
 int SymbolAccess::Read(const std::string &name, std::ostream &os) const
 {
-	const auto entries = FetchSymbolEntries();
-	const auto it = entries.find(name);
-	if (it == entries.end()) {
+	const auto index = FetchSymbolIndex();
+	const auto pos = index.Find(name);
+	if (SymbolIndex::npos == pos) {
 		LOG_WARN(__FUNCTION__ << "(): symbol '" << name
 				      << "' not found\n");
 		return ADSERR_DEVICE_SYMBOLNOTFOUND;
 	}
 
-	const auto entry = it->second;
+	const auto entry = index[pos];
 	std::vector<uint8_t> readBuffer(entry.header.size);
 	uint32_t bytesRead = 0;
 	const auto status = device.ReadReqEx2(entry.header.iGroup,
@@ -218,6 +307,10 @@ int SymbolAccess::Read(const std::string &name, std::ostream &os) const
 		break;
 
 	default:
+		if (ReadStructured(name, entry, readBuffer.data(), bytesRead,
+				   os)) {
+			break;
+		}
 		LOG_WARN(__FUNCTION__ << "() Unknown type '" << entry.typeName
 				      << "' output in binary\n");
 		os.write((const char *)readBuffer.data(), bytesRead);
@@ -227,8 +320,31 @@ int SymbolAccess::Read(const std::string &name, std::ostream &os) const
 	return !std::cout.good();
 }
 
+bool SymbolAccess::ReadStructured(const std::string &name,
+				  const SymbolView &entry, const uint8_t *data,
+				  size_t length, std::ostream &os) const
+{
+	try {
+		const auto types = FetchDataTypes();
+		const auto type = types.Find(entry.typeName.str());
+		if (!type) {
+			return false;
+		}
+		types.Decode(*type, data, length,
+			     [&](const std::string &path, const DataType &t,
+				 const uint8_t *value) {
+				     os << name << path << ": "
+					<< DataTypeTable::Format(t, value)
+					<< '\n';
+			     });
+		return true;
+	} catch (const AdsException &) {
+		return false;
+	}
+}
+
 template <typename T>
-int SymbolAccess::Write(const SymbolEntry &entry, const std::string &v) const
+int SymbolAccess::Write(const SymbolView &entry, const std::string &v) const
 {
 	if (!v.size()) {
 		LOG_ERROR(__FUNCTION__
@@ -253,7 +369,7 @@ int SymbolAccess::Write(const SymbolEntry &entry, const std::string &v) const
 }
 
 template <>
-int SymbolAccess::Write<uint8_t>(const SymbolEntry &entry,
+int SymbolAccess::Write<uint8_t>(const SymbolView &entry,
 				 const std::string &v) const
 {
 	if (!v.size()) {
@@ -284,7 +400,7 @@ int SymbolAccess::Write<uint8_t>(const SymbolEntry &entry,
 }
 
 template <>
-int SymbolAccess::Write<std::string>(const SymbolEntry &entry,
+int SymbolAccess::Write<std::string>(const SymbolView &entry,
 				     const std::string &value) const
 {
 	// Copy value to a temporary buffer so we can fill it with null bytes. PLC
@@ -299,15 +415,15 @@ int SymbolAccess::Write<std::string>(const SymbolEntry &entry,
 
 int SymbolAccess::Write(const std::string &name, const std::string &value) const
 {
-	const auto entries = FetchSymbolEntries();
-	const auto it = entries.find(name);
-	if (it == entries.end()) {
+	const auto index = FetchSymbolIndex();
+	const auto pos = index.Find(name);
+	if (SymbolIndex::npos == pos) {
 		LOG_WARN(__FUNCTION__ << "(): symbol '" << name
 				      << "' not found\n");
 		return ADSERR_DEVICE_SYMBOLNOTFOUND;
 	}
 
-	const auto entry = it->second;
+	const auto entry = index[pos];
 
 	switch (entry.header.dataType) {
 	case 0x2: //INT
@@ -344,10 +460,18 @@ int SymbolAccess::Write(const std::string &name, const std::string &value) const
 
 int SymbolAccess::ShowSymbols(std::ostream &os) const
 {
-	for (const auto &entry : FetchSymbolEntries()) {
-		entry.second.WriteAsJSON(os);
+	const auto index = FetchSymbolIndex();
+	for (size_t i = 0; i < index.size(); ++i) {
+		bhf::ads::WriteAsJSON(os, index[i]);
 	}
 	return 0;
 }
+
+int SymbolAccess::GenerateHeader(std::ostream &os,
+				 const std::string &prefix) const
+{
+	WriteCppHeader(os, FetchSymbolIndex(), FetchDataTypes(), prefix);
+	return !os.good();
+}
 }
 }
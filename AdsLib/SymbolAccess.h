@@ -7,7 +7,11 @@
 #pragma once
 
 #include "AdsDevice.h"
+#include "DataTypeTable.h"
+#include "SymbolCache.h"
+#include "SymbolIndex.h"
 #include <map>
+#include <memory>
 
 namespace bhf
 {
@@ -26,16 +30,31 @@ struct SymbolEntry {
 using SymbolEntryMap = std::map<std::string, SymbolEntry>;
 
 struct SymbolAccess {
-	SymbolAccess(const std::string &gw, AmsNetId netid, uint16_t port);
+	/**
+	 * @param[in] cacheFile to keep the symbol upload in across processes,
+	 *            an empty string disables the cache
+	 */
+	SymbolAccess(const std::string &gw, AmsNetId netid, uint16_t port,
+		     const std::string &cacheFile = {});
+	SymbolIndex FetchSymbolIndex() const;
+	/** @return a copy of all entries, prefer FetchSymbolIndex() */
 	SymbolEntryMap FetchSymbolEntries() const;
+	DataTypeTable FetchDataTypes() const;
 	int Read(const std::string &name, std::ostream &os) const;
 	int Write(const std::string &name, const std::string &value) const;
 	int ShowSymbols(std::ostream &os) const;
+	/** write a C++ header for all symbols starting with prefix */
+	int GenerateHeader(std::ostream &os, const std::string &prefix) const;
 
     private:
 	AdsDevice device;
+	std::shared_ptr<SymbolCache> cache;
+	SymbolCache::Key FetchCacheKey() const;
+	bool ReadStructured(const std::string &name, const SymbolView &entry,
+			    const uint8_t *data, size_t length,
+			    std::ostream &os) const;
 	template <typename T>
-	int Write(const SymbolEntry &symbol, const std::string &value) const;
+	int Write(const SymbolView &symbol, const std::string &value) const;
 };
 }
 }
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "SymbolCache.h"
+#include "Log.h"
+#include "wrap_endian.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#if defined(_WIN32) || defined(__CYGWIN__)
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace bhf
+{
+namespace ads
+{
+/** file layout version, change it with every incompatible change */
+static const char MAGIC[8] = { 'A', 'D', 'S', 'S', 'Y', 'M', '0', '2' };
+
+/** the header is stored in little endian byte order */
+struct SymbolCacheHeader {
+	char magic[sizeof(MAGIC)];
+	uint8_t netId[6];
+	uint16_t port;
+	uint32_t version;
+	uint32_t nSymbols;
+	uint32_t nSymSize;
+	uint32_t nDatatypes;
+	uint32_t nDatatypeSize;
+	uint32_t nMaxDynSymbols;
+	uint32_t nUsedDynSymbols;
+	/** of the upload, which follows the header */
+	uint32_t checksum;
+};
+static_assert(sizeof(SymbolCacheHeader) == 48, "headers are compared bytewise");
+
+static SymbolCacheHeader MakeHeader(const SymbolCache::Key &key,
+				    const uint32_t checksum)
+{
+	SymbolCacheHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	memcpy(header.netId, key.target.netId.b, sizeof(header.netId));
+	header.port = htole(key.target.port);
+	header.version = htole(key.version);
+	header.nSymbols = htole(key.nSymbols);
+	header.nSymSize = htole(key.nSymSize);
+	header.nDatatypes = htole(key.nDatatypes);
+	header.nDatatypeSize = htole(key.nDatatypeSize);
+	header.nMaxDynSymbols = htole(key.nMaxDynSymbols);
+	header.nUsedDynSymbols = htole(key.nUsedDynSymbols);
+	header.checksum = htole(checksum);
+	return header;
+}
+
+/** FNV-1a, which is good enough to detect damaged files */
+static uint32_t Checksum(const uint8_t *data, const size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static unsigned long ProcessId()
+{
+#if defined(_WIN32)
+	return _getpid();
+#else
+	return getpid();
+#endif
+}
+
+SymbolCache::SymbolCache(const std::string &__path)
+	: path(__path)
+	, mappingLength(0)
+{
+	Map();
+}
+
+std::shared_ptr<const uint8_t> SymbolCache::Find(const Key &key) const
+{
+	if (mappingLength < sizeof(SymbolCacheHeader)) {
+		return nullptr;
+	}
+	SymbolCacheHeader header;
+	memcpy(&header, mapping.get(), sizeof(header));
+	const auto data = mapping.get() + sizeof(header);
+	const auto checksum = letoh(header.checksum);
+	const auto expected = MakeHeader(key, checksum);
+	if ((mappingLength - sizeof(header) != key.nSymSize) ||
+	    memcmp(&header, &expected, sizeof(header)) ||
+	    (checksum != Checksum(data, key.nSymSize))) {
+		return nullptr;
+	}
+	return std::shared_ptr<const uint8_t>(mapping, data);
+}
+
+void SymbolCache::Store(const Key &key, const uint8_t *const data)
+{
+	const auto header = MakeHeader(key, Checksum(data, key.nSymSize));
+
+	/*
+	 * other processes keep using the old file until we replace it, every
+	 * writer in this or another process uses its own temporary file
+	 */
+	static std::atomic<uint32_t> sequence{ 0 };
+	const auto tmp = path + "." + std::to_string(ProcessId()) + "." +
+			 std::to_string(sequence++) + ".tmp";
+	{
+		std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header),
+			   sizeof(header));
+		file.write(reinterpret_cast<const char *>(data), key.nSymSize);
+		if (!file.good()) {
+			LOG_INFO("SymbolCache: writing '" << tmp << "' failed\n");
+			std::remove(tmp.c_str());
+			return;
+		}
+	}
+
+	mapping.reset();
+	mappingLength = 0;
+#if defined(_WIN32) || defined(__CYGWIN__)
+	std::remove(path.c_str());
+#endif
+	if (std::rename(tmp.c_str(), path.c_str())) {
+		LOG_INFO("SymbolCache: replacing '" << path << "' failed\n");
+		std::remove(tmp.c_str());
+	}
+	Map();
+}
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+void SymbolCache::Map()
+{
+	std::ifstream file(path, std::ios::binary);
+	const auto contents = std::make_shared<std::vector<uint8_t> >(
+		std::istreambuf_iterator<char>(file),
+		std::istreambuf_iterator<char>());
+	mappingLength = contents->size();
+	mapping = std::shared_ptr<const uint8_t>(contents, contents->data());
+}
+#else
+void SymbolCache::Map()
+{
+	const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	struct stat info;
+	if (!fstat(fd, &info) && (info.st_size > 0)) {
+		const auto length = static_cast<size_t>(info.st_size);
+		const auto p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (MAP_FAILED != p) {
+			mapping = std::shared_ptr<const uint8_t>(
+				static_cast<const uint8_t *>(p),
+				[length](const uint8_t *addr) {
+					munmap(const_cast<uint8_t *>(addr),
+					       length);
+				});
+			mappingLength = length;
+		}
+	}
+	close(fd);
+}
+#endif
+}
+}
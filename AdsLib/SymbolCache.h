@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AdsDef.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace bhf
+{
+namespace ads
+{
+/**
+ * Symbol upload of a PLC persisted in a file, so it doesn't need to be
+ * uploaded again by the next process. The file is memory-mapped and only
+ * used for the same PLC as long as its symbol version and upload info match
+ * and the upload wasn't damaged since it was stored.
+ */
+struct SymbolCache {
+	/** identifies a symbol upload without transferring it */
+	struct Key {
+		/** the ADS server, which the symbols were uploaded from */
+		AmsAddr target;
+		/** ADSIGRP_SYM_VERSION, which changes with every online change */
+		uint32_t version;
+		/** ADSIGRP_SYM_UPLOADINFO2 */
+		uint32_t nSymbols;
+		uint32_t nSymSize;
+		uint32_t nDatatypes;
+		uint32_t nDatatypeSize;
+		uint32_t nMaxDynSymbols;
+		uint32_t nUsedDynSymbols;
+	};
+
+	/** @param[in] path of the cache file, which may not exist yet */
+	SymbolCache(const std::string &path);
+	SymbolCache(const SymbolCache &) = delete;
+	SymbolCache &operator=(const SymbolCache &) = delete;
+
+	/**
+	 * @return the nSymSize bytes of the cached upload, if it was stored
+	 * with the same key, nullptr otherwise. The data stays valid, even if
+	 * the cache is replaced or destroyed meanwhile.
+	 */
+	std::shared_ptr<const uint8_t> Find(const Key &key) const;
+
+	/**
+	 * Replace the cache file with a new upload. The cache is optional, so
+	 * failures are only logged.
+	 */
+	void Store(const Key &key, const uint8_t *data);
+
+    private:
+	const std::string path;
+	std::shared_ptr<const uint8_t> mapping;
+	size_t mappingLength;
+
+	void Map();
+};
+}
+}
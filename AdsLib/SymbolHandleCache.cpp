@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "SymbolHandleCache.h"
+#include "AdsDevice.h"
+#include "AdsException.h"
+#include "AdsLib.h"
+#include "wrap_endian.h"
+
+#include <tuple>
+#include <vector>
+
+namespace bhf
+{
+namespace ads
+{
+/**
+ * Notification callbacks only get a 32 bit hUser, so the caches, which
+ * subscribed to ADSIGRP_SYM_VERSION, are looked up in this registry.
+ */
+static std::mutex g_SubscribersMutex;
+static std::map<uint32_t, SymbolHandleCache *> g_Subscribers;
+static uint32_t g_NextSubscriber = 1;
+
+static bool IsInvalidHandle(const long error)
+{
+	return (ADSERR_DEVICE_NOTFOUND == error) ||
+	       (ADSERR_DEVICE_SYMBOLNOTFOUND == error) ||
+	       (ADSERR_DEVICE_SYMBOLVERSIONINVALID == error);
+}
+
+static void IgnoreCompletion(long, uint32_t, void *)
+{
+}
+
+/** state of entries, which were never resolved */
+static const uint64_t UNRESOLVED = ~uint64_t{ 0 };
+
+static uint64_t Pack(const uint32_t handle, const uint32_t generation)
+{
+	return (uint64_t{ generation } << 32) | handle;
+}
+
+static uint32_t HandleOf(const uint64_t state)
+{
+	return static_cast<uint32_t>(state);
+}
+
+static uint32_t GenerationOf(const uint64_t state)
+{
+	return static_cast<uint32_t>(state >> 32);
+}
+
+SymbolHandleCache::Entry::Entry()
+	: state(UNRESOLVED)
+	, users(0)
+{
+}
+
+SymbolHandleCache::Reference::Reference(SymbolHandleCache &__cache,
+					const std::string &symbolName)
+	: cache(__cache)
+	, entry(__cache.Acquire(symbolName))
+{
+}
+
+SymbolHandleCache::Reference::~Reference()
+{
+	cache.Release(entry);
+}
+
+uint32_t SymbolHandleCache::Reference::Get() const
+{
+	return cache.Get(entry);
+}
+
+bool SymbolHandleCache::Reference::Invalidate(const uint32_t handle,
+					      const long error) const
+{
+	if (!IsInvalidHandle(error)) {
+		return false;
+	}
+	/* someone else might have resolved the handle again already */
+	const uint64_t state = entry.second.state;
+	if (handle == HandleOf(state)) {
+		auto current = GenerationOf(state);
+		cache.generation.compare_exchange_strong(current, current + 1);
+	}
+	return true;
+}
+
+SymbolHandleCache::SymbolHandleCache(const long __port, const AmsAddr &__addr)
+	: port(__port)
+	, addr(__addr)
+	, generation(0)
+	, symbolVersion(-1)
+	, subscriber(0)
+	, versionNotification(0)
+{
+}
+
+SymbolHandleCache::~SymbolHandleCache()
+{
+	if (subscriber) {
+		std::lock_guard<std::mutex> lock(g_SubscribersMutex);
+		g_Subscribers.erase(subscriber);
+	}
+	if (versionNotification) {
+		AdsSyncDelDeviceNotificationReqEx(port, &addr,
+						  versionNotification);
+	}
+
+	/*
+	 * The connection might be closed right after us, so the handles are
+	 * released synchronously with as few ADSIGRP_SUMUP_WRITE as possible.
+	 */
+	std::vector<uint32_t> handles;
+	for (const auto &e : entries) {
+		const uint64_t state = e.second.state;
+		if (generation == GenerationOf(state)) {
+			handles.push_back(HandleOf(state));
+		}
+	}
+	ReleaseSymbolHandles(port, addr, handles);
+}
+
+void SymbolHandleCache::Flush()
+{
+	++generation;
+}
+
+SymbolHandleCache::Entries::value_type &
+SymbolHandleCache::Acquire(const std::string &symbolName)
+{
+	std::call_once(subscribed, [this]() { Subscribe(); });
+
+	Entries::value_type *entry;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto it = entries.emplace(
+			std::piecewise_construct,
+			std::forward_as_tuple(symbolName),
+			std::forward_as_tuple());
+		entry = &*it.first;
+		++entry->second.users;
+	}
+
+	/* resolve without the lock, so a slow PLC only blocks this symbol */
+	try {
+		Get(*entry);
+	} catch (...) {
+		Release(*entry);
+		throw;
+	}
+	return *entry;
+}
+
+void SymbolHandleCache::Release(Entries::value_type &entry)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	/* idle handles are kept for the next user of the symbol */
+	--entry.second.users;
+}
+
+uint32_t SymbolHandleCache::Get(Entries::value_type &entry)
+{
+	const uint64_t state = entry.second.state;
+	if (generation == GenerationOf(state)) {
+		return HandleOf(state);
+	}
+	return Update(entry);
+}
+
+uint32_t SymbolHandleCache::Update(Entries::value_type &entry)
+{
+	std::lock_guard<std::mutex> lock(entry.second.resolving);
+	const uint32_t current = generation;
+	const uint64_t stale = entry.second.state;
+	if (current == GenerationOf(stale)) {
+		/* resolved by another thread, while we were waiting */
+		return HandleOf(stale);
+	}
+
+	const auto handle = Resolve(entry.first);
+	entry.second.state = Pack(handle, current);
+	if (UNRESOLVED != stale) {
+		ReleaseHandle(HandleOf(stale));
+	}
+	return handle;
+}
+
+uint32_t SymbolHandleCache::Resolve(const std::string &symbolName) const
+{
+	uint32_t handle = 0;
+	uint32_t bytesRead = 0;
+	const auto error = AdsSyncReadWriteReqEx2(
+		port, &addr, ADSIGRP_SYM_HNDBYNAME, 0, sizeof(handle), &handle,
+		static_cast<uint32_t>(symbolName.size()), symbolName.c_str(),
+		&bytesRead);
+	if (error || (sizeof(handle) != bytesRead)) {
+		throw AdsException(error);
+	}
+	return bhf::ads::letoh(handle);
+}
+
+void SymbolHandleCache::ReleaseHandle(const uint32_t handle) const
+{
+	/* nobody waits for the result, stale handles are usually gone anyway */
+	const auto leHandle = bhf::ads::htole(handle);
+	AdsWriteReqAsync(port, &addr, ADSIGRP_SYM_RELEASEHND, 0,
+			 sizeof(leHandle), &leHandle, IgnoreCompletion,
+			 nullptr);
+}
+
+void SymbolHandleCache::Subscribe()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_SubscribersMutex);
+		subscriber = g_NextSubscriber++;
+		g_Subscribers[subscriber] = this;
+	}
+
+	/*
+	 * The initial sample of the notification might get lost, so the first
+	 * change would look like the initial version without this read.
+	 */
+	uint8_t version = 0;
+	uint32_t bytesRead = 0;
+	if (!AdsSyncReadReqEx2(port, &addr, ADSIGRP_SYM_VERSION, 0,
+			       sizeof(version), &version, &bytesRead) &&
+	    (sizeof(version) == bytesRead)) {
+		symbolVersion = version;
+	}
+
+	/* without the notification only rejected handles flush the cache */
+	const AdsNotificationAttrib attrib = { sizeof(uint8_t),
+					       ADSTRANS_SERVERONCHA, 0, { 0 } };
+	uint32_t hNotify = 0;
+	if (!AdsSyncAddDeviceNotificationReqEx(
+		    port, &addr, ADSIGRP_SYM_VERSION, 0, &attrib,
+		    &SymbolHandleCache::OnNotification, subscriber, &hNotify)) {
+		versionNotification = bhf::ads::letoh(hNotify);
+	}
+}
+
+void SymbolHandleCache::OnSymbolVersion(const uint8_t version)
+{
+	const auto previous = symbolVersion.exchange(version);
+	if ((previous >= 0) && (previous != version)) {
+		Flush();
+	}
+}
+
+void SymbolHandleCache::OnNotification(
+	const AmsAddr *, const AdsNotificationHeader *pNotification,
+	const uint32_t hUser)
+{
+	if (pNotification->cbSampleSize < sizeof(uint8_t)) {
+		return;
+	}
+	const auto version =
+		*reinterpret_cast<const uint8_t *>(pNotification + 1);
+
+	std::lock_guard<std::mutex> lock(g_SubscribersMutex);
+	const auto it = g_Subscribers.find(hUser);
+	if (it != g_Subscribers.end()) {
+		it->second->OnSymbolVersion(version);
+	}
+}
+}
+}
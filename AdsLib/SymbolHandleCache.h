@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AdsDef.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace bhf
+{
+namespace ads
+{
+/**
+ * Symbol handles of one ADS server shared by all AdsVariable and
+ * AdsNotification objects, so only the first lookup of a symbol costs an
+ * ADSIGRP_SYM_HNDBYNAME round trip. Handles stay cached after their last
+ * user is gone. All of them become stale once ADSIGRP_SYM_VERSION changes,
+ * which is observed with an on change notification and by handles, which
+ * the PLC rejects. Stale handles are resolved again on their next use.
+ * Get() of a handle, which is still valid, doesn't take any lock.
+ */
+struct SymbolHandleCache {
+    private:
+	struct Entry {
+		Entry();
+
+		/**
+		 * handle in the lower and generation in the upper 32 bits,
+		 * stale if the generation differs from the one of the cache
+		 */
+		std::atomic<uint64_t> state;
+		/** held while the handle is resolved, so only one does it */
+		std::mutex resolving;
+		/** guarded by the mutex of the cache */
+		size_t users;
+	};
+	using Entries = std::map<std::string, Entry>;
+
+    public:
+	/** Counted reference to a cached symbol handle */
+	struct Reference {
+		/** @throw AdsException if the symbol can't be resolved */
+		Reference(SymbolHandleCache &cache,
+			  const std::string &symbolName);
+		~Reference();
+		Reference(const Reference &) = delete;
+		Reference &operator=(const Reference &) = delete;
+
+		/**
+		 * @return the handle of the symbol, resolved again if it
+		 *         became stale since the last call
+		 * @throw AdsException if the symbol can't be resolved
+		 */
+		uint32_t Get() const;
+
+		/**
+		 * Mark all cached handles stale, if error indicates that the
+		 * PLC rejected handle because of an online change.
+		 * @return true if the request should be retried with Get()
+		 */
+		bool Invalidate(uint32_t handle, long error) const;
+
+	    private:
+		SymbolHandleCache &cache;
+		Entries::value_type &entry;
+	};
+
+	/**
+	 * @param[in] port opened with AdsPortOpenEx(), which has to outlive
+	 *            the cache
+	 * @param[in] addr of the ADS server
+	 */
+	SymbolHandleCache(long port, const AmsAddr &addr);
+	~SymbolHandleCache();
+	SymbolHandleCache(const SymbolHandleCache &) = delete;
+	SymbolHandleCache &operator=(const SymbolHandleCache &) = delete;
+
+	/** Mark all cached handles stale */
+	void Flush();
+
+    private:
+	const long port;
+	const AmsAddr addr;
+	/** guards entries, but not their state */
+	std::mutex mutex;
+	Entries entries;
+	std::once_flag subscribed;
+	std::atomic<uint32_t> generation;
+	/** last ADSIGRP_SYM_VERSION seen, -1 if it couldn't be read yet */
+	std::atomic<int> symbolVersion;
+	/** hUser of the version notification, 0 until subscribed */
+	uint32_t subscriber;
+	/** hNotify of the version notification, 0 if not supported */
+	uint32_t versionNotification;
+
+	Entries::value_type &Acquire(const std::string &symbolName);
+	void Release(Entries::value_type &entry);
+	uint32_t Get(Entries::value_type &entry);
+	uint32_t Update(Entries::value_type &entry);
+	uint32_t Resolve(const std::string &symbolName) const;
+	void ReleaseHandle(uint32_t handle) const;
+	void Subscribe();
+	void OnSymbolVersion(uint8_t version);
+	static void OnNotification(const AmsAddr *pAddr,
+				   const AdsNotificationHeader *pNotification,
+				   uint32_t hUser);
+};
+}
+}
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "SymbolIndex.h"
+#include "AdsException.h"
+#include "Log.h"
+#include "wrap_endian.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace bhf
+{
+namespace ads
+{
+std::ostream &operator<<(std::ostream &os, const SymbolString &s)
+{
+	return os.write(s.data, s.length);
+}
+
+static bool operator<(const SymbolString &lhs, const SymbolString &rhs)
+{
+	const auto result = memcmp(lhs.data, rhs.data,
+				   std::min(lhs.length, rhs.length));
+	return result ? (result < 0) : (lhs.length < rhs.length);
+}
+
+static bool operator==(const SymbolString &lhs, const SymbolString &rhs)
+{
+	return (lhs.length == rhs.length) &&
+	       !memcmp(lhs.data, rhs.data, lhs.length);
+}
+
+static uint32_t Hash(const char *data, size_t length)
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+	while (length--) {
+		hash ^= static_cast<uint8_t>(*data++);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static AdsSymbolEntry DecodeHeader(const uint8_t *const data)
+{
+	AdsSymbolEntry wire;
+	memcpy(&wire, data, sizeof(wire));
+	AdsSymbolEntry header;
+	header.entryLength = letoh(wire.entryLength);
+	header.iGroup = letoh(wire.iGroup);
+	header.iOffs = letoh(wire.iOffs);
+	header.size = letoh(wire.size);
+	header.dataType = letoh(wire.dataType);
+	header.flags = letoh(wire.flags);
+	header.nameLength = letoh(wire.nameLength);
+	header.typeLength = letoh(wire.typeLength);
+	header.commentLength = letoh(wire.commentLength);
+	return header;
+}
+
+/** validate the entry at data, like SymbolEntry::Parse() does */
+static uint32_t Validate(const uint8_t *const data, const size_t lengthLimit)
+{
+	if (sizeof(AdsSymbolEntry) > lengthLimit) {
+		LOG_ERROR(__FUNCTION__
+			  << "(): Read data to short to contain symbol info: "
+			  << std::dec << lengthLimit << '\n');
+		throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	}
+	const auto header = DecodeHeader(data);
+	if ((header.entryLength > lengthLimit) ||
+	    (header.entryLength < sizeof(AdsSymbolEntry))) {
+		LOG_ERROR(__FUNCTION__ << "(): Corrupt entry length: "
+				       << std::dec << header.entryLength
+				       << '\n');
+		throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	}
+	const size_t strings = size_t{ header.nameLength } + 1 +
+			       header.typeLength + 1 + header.commentLength + 1;
+	if (strings > header.entryLength - sizeof(AdsSymbolEntry)) {
+		LOG_ERROR(__FUNCTION__ << "(): Corrupt string lengths: "
+				       << std::dec << header.nameLength << '/'
+				       << header.typeLength << '/'
+				       << header.commentLength << '\n');
+		throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	}
+	return header.entryLength;
+}
+
+SymbolIndex::SymbolIndex(std::shared_ptr<const uint8_t> __upload,
+			 size_t length, uint32_t nSymbols)
+	: upload(std::move(__upload))
+{
+	sorted.reserve(nSymbols);
+	size_t offset = 0;
+	while (nSymbols-- && (offset < length)) {
+		sorted.push_back(static_cast<uint32_t>(offset));
+		offset += Validate(upload.get() + offset, length - offset);
+	}
+	if (offset != length) {
+		LOG_ERROR(__FUNCTION__ << "(): nSymbols: " << sorted.size()
+				       << " nSymSize:" << length << "'\n");
+		throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+			 [this](uint32_t lhs, uint32_t rhs) {
+				 return Name(lhs) < Name(rhs);
+			 });
+
+	/* keep the load factor at or below 1/2 */
+	size_t numSlots = 1;
+	while (numSlots < 2 * sorted.size()) {
+		numSlots *= 2;
+	}
+	slots.resize(numSlots);
+	const auto mask = numSlots - 1;
+	for (size_t pos = sorted.size(); pos--;) {
+		/* walk backwards, so the first of duplicated names wins */
+		const auto name = Name(sorted[pos]);
+		auto slot = Hash(name.data, name.length) & mask;
+		while (slots[slot] && !(Name(sorted[slots[slot] - 1]) == name)) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = static_cast<uint32_t>(pos + 1);
+	}
+}
+
+size_t SymbolIndex::size() const
+{
+	return sorted.size();
+}
+
+SymbolString SymbolIndex::Name(const uint32_t offset) const
+{
+	const auto data = upload.get() + offset;
+	uint16_t nameLength;
+	memcpy(&nameLength, data + offsetof(AdsSymbolEntry, nameLength),
+	       sizeof(nameLength));
+	return { reinterpret_cast<const char *>(data + sizeof(AdsSymbolEntry)),
+		 letoh(nameLength) };
+}
+
+SymbolView SymbolIndex::operator[](const size_t pos) const
+{
+	const auto data = upload.get() + sorted[pos];
+	SymbolView view;
+	view.header = DecodeHeader(data);
+	auto next = reinterpret_cast<const char *>(data + sizeof(AdsSymbolEntry));
+	view.name = { next, view.header.nameLength };
+	next += view.header.nameLength + 1;
+	view.typeName = { next, view.header.typeLength };
+	next += view.header.typeLength + 1;
+	view.comment = { next, view.header.commentLength };
+	return view;
+}
+
+size_t SymbolIndex::Find(const std::string &name) const
+{
+	const auto mask = slots.size() - 1;
+	auto slot = Hash(name.data(), name.size()) & mask;
+	while (slots[slot]) {
+		const auto pos = slots[slot] - 1;
+		if (Name(sorted[pos]) == name) {
+			return pos;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return npos;
+}
+
+std::pair<size_t, size_t> SymbolIndex::Prefix(const std::string &prefix) const
+{
+	const SymbolString key{ prefix.data(), prefix.size() };
+	const auto first = std::lower_bound(sorted.begin(), sorted.end(), key,
+					    [this](uint32_t offset,
+						   const SymbolString &k) {
+						    return Name(offset) < k;
+					    });
+	auto last = first;
+	while ((last != sorted.end()) &&
+	       (Name(*last).length >= prefix.size()) &&
+	       !memcmp(Name(*last).data, prefix.data(), prefix.size())) {
+		++last;
+	}
+	return { static_cast<size_t>(first - sorted.begin()),
+		 static_cast<size_t>(last - sorted.begin()) };
+}
+}
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AdsDef.h"
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bhf
+{
+namespace ads
+{
+/** characters of a symbol upload, which are not copied */
+struct SymbolString {
+	const char *data;
+	size_t length;
+
+	std::string str() const
+	{
+		return std::string(data, length);
+	}
+
+	bool operator==(const std::string &other) const
+	{
+		return other.compare(0, other.npos, data, length) == 0;
+	}
+};
+
+std::ostream &operator<<(std::ostream &os, const SymbolString &s);
+
+/** a symbol entry decoded from the upload buffer without copying strings */
+struct SymbolView {
+	/** in host byte order */
+	AdsSymbolEntry header;
+	SymbolString name;
+	SymbolString typeName;
+	SymbolString comment;
+};
+
+/**
+ * Immutable index over the result of ADSIGRP_SYM_UPLOAD. It keeps the raw
+ * upload alive and stores only the offset of each entry, sorted by name,
+ * plus an open addressing hash table. That keeps its footprint close to
+ * the wire size and supports O(1) lookups and iteration by name prefix.
+ */
+struct SymbolIndex {
+	/** returned by Find(), if the name is unknown */
+	static const size_t npos = static_cast<size_t>(-1);
+
+	/**
+	 * @param[in] upload of ADSIGRP_SYM_UPLOAD, which is kept alive
+	 * @param[in] length of the upload in bytes
+	 * @param[in] nSymbols as reported by ADSIGRP_SYM_UPLOADINFO
+	 * @throw AdsException(ADSERR_DEVICE_INVALIDDATA), if the upload is corrupt
+	 */
+	SymbolIndex(std::shared_ptr<const uint8_t> upload, size_t length,
+		    uint32_t nSymbols);
+
+	/** @return number of symbols */
+	size_t size() const;
+
+	/** @return the symbol at pos in the order of their names */
+	SymbolView operator[](size_t pos) const;
+
+	/** @return position of the symbol called name or npos */
+	size_t Find(const std::string &name) const;
+
+	/**
+	 * @return [first, last) positions of all symbols, whose names start
+	 * with prefix. An empty prefix selects all symbols.
+	 */
+	std::pair<size_t, size_t> Prefix(const std::string &prefix) const;
+
+    private:
+	std::shared_ptr<const uint8_t> upload;
+	/** offsets of the entries in upload sorted by their names */
+	std::vector<uint32_t> sorted;
+	/** position in sorted plus one, 0 marks an empty slot */
+	std::vector<uint32_t> slots;
+
+	SymbolString Name(uint32_t offset) const;
+};
+}
+}
@@ -46,3 +46,12 @@ enum nSystemServiceIndexGroups : uint32_t {
 	SYSTEMSERVICE_STARTPROCESS = 500,
 	SYSTEMSERVICE_SETNUMPROC = 1200
 };
+
+/**
+ * @brief Type definition of the callback function required by AdsReadReqAsync(), AdsWriteReqAsync() and AdsReadWriteReqAsync().
+ * @param[in] errorCode [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of the request
+ * @param[in] bytesRead number of actually read data bytes
+ * @param[in] pContext custom pointer passed to the asynchronous request
+ */
+typedef void (*PAdsCompletionFunc)(long errorCode, uint32_t bytesRead,
+				   void *pContext);
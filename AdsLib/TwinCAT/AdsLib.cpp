@@ -14,6 +14,12 @@ long AddLocalRoute(AmsNetId, const char *)
 	return 0;
 }
 
+long AddLocalRoute(AmsNetId, const char *, size_t)
+{
+	// routes are managed by the TwinCAT router
+	return 0;
+}
+
 void DelLocalRoute(AmsNetId)
 {
 }
@@ -21,6 +27,52 @@ void DelLocalRoute(AmsNetId)
 void SetLocalAddress(const AmsNetId)
 {
 }
+
+long SetReactorThreads(size_t)
+{
+	/* TcAdsDll receives the data of all connections itself */
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long SetNotificationThreads(size_t)
+{
+	/* TcAdsDll invokes the notification callbacks itself */
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long SetNotificationBuffer(long, const NotificationBufferConfig &)
+{
+	/* TcAdsDll manages its notification buffers itself */
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long SetTrafficClass(long, TrafficClass)
+{
+	/* requests are sent by TcAdsDll in order */
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long GetNotificationStats(long, const AmsAddr &, NotificationStats &)
+{
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long SetLatencyTracing(bool)
+{
+	/* requests are sent by TcAdsDll, so we can't timestamp them */
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long GetMetrics(MetricsSnapshot &)
+{
+	/* TcAdsDll doesn't expose its counters */
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long GetLatencyStats(std::vector<RequestLatency> &)
+{
+	return ADSERR_DEVICE_SRVNOTSUPP;
+}
 }
 }
 
@@ -109,3 +161,41 @@ long AdsSyncWriteReqEx(long port, const AmsAddr *pAddr, uint32_t indexGroup,
 				 (ads_ui32)indexGroup, (ads_ui32)indexOffset,
 				 (ads_ui32)bufferLength, (void *)buffer);
 }
+
+/* TcAdsDll has no asynchronous API, so requests are completed synchronously */
+long AdsReadReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+		     uint32_t indexOffset, uint32_t bufferLength, void *buffer,
+		     PAdsCompletionFunc pFunc, void *pContext)
+{
+	uint32_t bytesRead = 0;
+	const auto status =
+		AdsSyncReadReqEx2(port, pAddr, indexGroup, indexOffset,
+				  bufferLength, buffer, &bytesRead);
+	pFunc(status, bytesRead, pContext);
+	return 0;
+}
+
+long AdsReadWriteReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+			  uint32_t indexOffset, uint32_t readLength,
+			  void *readData, uint32_t writeLength,
+			  const void *writeData, PAdsCompletionFunc pFunc,
+			  void *pContext)
+{
+	uint32_t bytesRead = 0;
+	const auto status = AdsSyncReadWriteReqEx2(
+		port, pAddr, indexGroup, indexOffset, readLength, readData,
+		writeLength, writeData, &bytesRead);
+	pFunc(status, bytesRead, pContext);
+	return 0;
+}
+
+long AdsWriteReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+		      uint32_t indexOffset, uint32_t bufferLength,
+		      const void *buffer, PAdsCompletionFunc pFunc,
+		      void *pContext)
+{
+	const auto status = AdsSyncWriteReqEx(port, pAddr, indexGroup,
+					      indexOffset, bufferLength, buffer);
+	pFunc(status, 0, pContext);
+	return 0;
+}
@@ -439,6 +439,15 @@ typedef void (*PAdsNotificationFuncEx)(
 	const AmsAddr *pAddr, const AdsNotificationHeader *pNotification,
 	uint32_t hUser);
 
+/**
+ * @brief Type definition of the callback function required by AdsReadReqAsync(), AdsWriteReqAsync() and AdsReadWriteReqAsync().
+ * @param[in] errorCode [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of the request
+ * @param[in] bytesRead number of actually read data bytes
+ * @param[in] pContext custom pointer passed to the asynchronous request
+ */
+typedef void (*PAdsCompletionFunc)(long errorCode, uint32_t bytesRead,
+				   void *pContext);
+
 #define ADSSYMBOLFLAG_PERSISTENT ((uint32_t)(1 << 0))
 #define ADSSYMBOLFLAG_BITVALUE ((uint32_t)(1 << 1))
 #define ADSSYMBOLFLAG_REFERENCETO ((uint32_t)(1 << 2))
@@ -447,6 +456,44 @@ typedef void (*PAdsNotificationFuncEx)(
 #define ADSSYMBOLFLAG_READONLY ((uint32_t)(1 << 5))
 #define ADSSYMBOLFLAG_CONTEXTMASK ((uint32_t)0xF00)
 
+#define ADSDATATYPEFLAG_DATATYPE ((uint32_t)(1 << 0))
+#define ADSDATATYPEFLAG_DATAITEM ((uint32_t)(1 << 1))
+#define ADSDATATYPEFLAG_REFERENCETO ((uint32_t)(1 << 2))
+#define ADSDATATYPEFLAG_METHODDEREF ((uint32_t)(1 << 3))
+#define ADSDATATYPEFLAG_OVERSAMPLE ((uint32_t)(1 << 4))
+#define ADSDATATYPEFLAG_BITVALUES ((uint32_t)(1 << 5))
+#define ADSDATATYPEFLAG_PROPITEM ((uint32_t)(1 << 6))
+#define ADSDATATYPEFLAG_TYPEGUID ((uint32_t)(1 << 7))
+#define ADSDATATYPEFLAG_PERSISTENT ((uint32_t)(1 << 8))
+#define ADSDATATYPEFLAG_COPYMASK ((uint32_t)(1 << 9))
+#define ADSDATATYPEFLAG_TCCOMINTERFACEPTR ((uint32_t)(1 << 10))
+#define ADSDATATYPEFLAG_METHODINFOS ((uint32_t)(1 << 11))
+#define ADSDATATYPEFLAG_ATTRIBUTES ((uint32_t)(1 << 12))
+#define ADSDATATYPEFLAG_ENUMINFOS ((uint32_t)(1 << 13))
+
+/**
+ * @brief ADS data types as used in AdsSymbolEntry and AdsDatatypeEntry
+ */
+enum nAdsDataType : uint32_t {
+	ADST_VOID = 0,
+	ADST_INT16 = 2,
+	ADST_INT32 = 3,
+	ADST_REAL32 = 4,
+	ADST_REAL64 = 5,
+	ADST_INT8 = 16,
+	ADST_UINT8 = 17,
+	ADST_UINT16 = 18,
+	ADST_UINT32 = 19,
+	ADST_INT64 = 20,
+	ADST_UINT64 = 21,
+	ADST_STRING = 30,
+	ADST_WSTRING = 31,
+	ADST_REAL80 = 32,
+	ADST_BIT = 33,
+	ADST_BIGTYPE = 65,
+	ADST_MAXTYPES = 67,
+};
+
 /**
  * @brief This structure describes the header of ADS symbol information
  *
@@ -468,6 +515,36 @@ struct AdsSymbolEntry {
 	uint16_t commentLength; // length of comment (null terminating character not counted)
 };
 
+/**
+ * @brief Header of a data type description
+ *
+ * Reading IndexGroup ADSIGRP_SYM_DT_UPLOAD returns a list of these entries.
+ * Each header is followed by zero terminated strings for "name", "type"
+ * and "comment", arrayDim AdsDatatypeArrayInfo and subItems nested
+ * AdsDatatypeEntry. Optional data like enum values follows, depending on
+ * the ADSDATATYPEFLAG_* set in flags.
+ */
+struct AdsDatatypeEntry {
+	uint32_t entryLength; // length of complete datatype entry
+	uint32_t version; // version of datatype structure
+	uint32_t hashValue; // hashValue of datatype to compare datatypes
+	uint32_t typeHashValue; // hashValue of base type
+	uint32_t size; // size of datatype ( in bytes )
+	uint32_t offs; // offs of dataitem in parent datatype ( in bytes )
+	uint32_t dataType; // adsDataType of symbol (if alias)
+	uint32_t flags; // see ADSDATATYPEFLAG_*
+	uint16_t nameLength; // length of datatype name (null terminating character not counted)
+	uint16_t typeLength; // length of dataitem type name (null terminating character not counted)
+	uint16_t commentLength; // length of comment (null terminating character not counted)
+	uint16_t arrayDim; // number of array dimensions
+	uint16_t subItems; // number of nested AdsDatatypeEntry
+};
+
+struct AdsDatatypeArrayInfo {
+	uint32_t lBound;
+	uint32_t elements;
+};
+
 /**
  * @brief This structure is used to provide ADS symbol information for ADS SUM commands
  */
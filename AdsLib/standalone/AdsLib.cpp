@@ -27,14 +27,23 @@ static AmsRouter &GetRouter()
 		}                                       \
 	} while (false)
 
+static AmsCompletion MakeCompletion(const PAdsCompletionFunc pFunc,
+				   void *const pContext)
+{
+	return [pFunc, pContext](uint32_t errorCode, uint32_t bytesRead) {
+		pFunc(errorCode, bytesRead, pContext);
+	};
+}
+
 namespace bhf
 {
 namespace ads
 {
-long AddLocalRoute(const AmsNetId ams, const char *ip)
+long AddLocalRoute(const AmsNetId ams, const char *ip,
+		   const size_t numConnections)
 {
 	try {
-		return GetRouter().AddRoute(ams, ip);
+		return GetRouter().AddRoute(ams, ip, numConnections);
 	} catch (const std::bad_alloc &) {
 		return GLOBALERR_NO_MEMORY;
 	} catch (const std::runtime_error &) {
@@ -42,6 +51,11 @@ long AddLocalRoute(const AmsNetId ams, const char *ip)
 	}
 }
 
+long AddLocalRoute(const AmsNetId ams, const char *ip)
+{
+	return AddLocalRoute(ams, ip, 1);
+}
+
 void DelLocalRoute(const AmsNetId ams)
 {
 	GetRouter().DelRoute(ams);
@@ -51,6 +65,58 @@ void SetLocalAddress(const AmsNetId ams)
 {
 	GetRouter().SetLocalAddress(ams);
 }
+
+long SetReactorThreads(const size_t numThreads)
+{
+	return GetRouter().SetReactorThreads(numThreads);
+}
+
+long SetNotificationThreads(const size_t numThreads)
+{
+	return GetRouter().SetNotificationThreads(numThreads);
+}
+
+long SetNotificationBuffer(const long port,
+			   const NotificationBufferConfig &config)
+{
+	ASSERT_PORT(port);
+	return GetRouter().SetNotificationBuffer((uint16_t)port, config);
+}
+
+long SetTrafficClass(const long port, const TrafficClass trafficClass)
+{
+	ASSERT_PORT(port);
+	return GetRouter().SetTrafficClass((uint16_t)port, trafficClass);
+}
+
+long GetNotificationStats(const long port, const AmsAddr &addr,
+			  NotificationStats &stats)
+{
+	ASSERT_PORT(port);
+	return GetRouter().GetNotificationStats((uint16_t)port, addr, stats);
+}
+
+long SetLatencyTracing(const bool enable)
+{
+	GetRouter().SetLatencyTracing(enable);
+	return 0;
+}
+
+long GetMetrics(MetricsSnapshot &metrics)
+{
+	metrics = GetRouter().GetMetrics();
+	return 0;
+}
+
+long GetLatencyStats(std::vector<RequestLatency> &stats)
+{
+	try {
+		GetRouter().GetLatencyStats(stats);
+		return 0;
+	} catch (const std::bad_alloc &) {
+		return GLOBALERR_NO_MEMORY;
+	}
+}
 }
 }
 
@@ -208,6 +274,79 @@ long AdsSyncWriteReqEx(long port, const AmsAddr *pAddr, uint32_t indexGroup,
 	}
 }
 
+long AdsReadReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+		     uint32_t indexOffset, uint32_t bufferLength, void *buffer,
+		     PAdsCompletionFunc pFunc, void *pContext)
+{
+	ASSERT_PORT_AND_AMSADDR(port, pAddr);
+	if (!buffer || !pFunc) {
+		return ADSERR_CLIENT_INVALIDPARM;
+	}
+
+	try {
+		std::unique_ptr<AmsRequest> request{ new AmsRequest{
+			*pAddr, (uint16_t)port, AoEHeader::READ, bufferLength,
+			buffer, nullptr, sizeof(AoERequestHeader) } };
+		request->frame.prepend(AoERequestHeader{
+			indexGroup, indexOffset, bufferLength });
+		return GetRouter().AdsRequestAsync(
+			std::move(request), MakeCompletion(pFunc, pContext));
+	} catch (const std::bad_alloc &) {
+		return GLOBALERR_NO_MEMORY;
+	}
+}
+
+long AdsReadWriteReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+			  uint32_t indexOffset, uint32_t readLength,
+			  void *readData, uint32_t writeLength,
+			  const void *writeData, PAdsCompletionFunc pFunc,
+			  void *pContext)
+{
+	ASSERT_PORT_AND_AMSADDR(port, pAddr);
+	if ((readLength && !readData) || (writeLength && !writeData) ||
+	    !pFunc) {
+		return ADSERR_CLIENT_INVALIDPARM;
+	}
+
+	try {
+		std::unique_ptr<AmsRequest> request{ new AmsRequest{
+			*pAddr, (uint16_t)port, AoEHeader::READ_WRITE,
+			readLength, readData, nullptr,
+			sizeof(AoEReadWriteReqHeader) + writeLength } };
+		request->frame.prepend(writeData, writeLength);
+		request->frame.prepend(AoEReadWriteReqHeader{
+			indexGroup, indexOffset, readLength, writeLength });
+		return GetRouter().AdsRequestAsync(
+			std::move(request), MakeCompletion(pFunc, pContext));
+	} catch (const std::bad_alloc &) {
+		return GLOBALERR_NO_MEMORY;
+	}
+}
+
+long AdsWriteReqAsync(long port, const AmsAddr *pAddr, uint32_t indexGroup,
+		      uint32_t indexOffset, uint32_t bufferLength,
+		      const void *buffer, PAdsCompletionFunc pFunc,
+		      void *pContext)
+{
+	ASSERT_PORT_AND_AMSADDR(port, pAddr);
+	if ((bufferLength && !buffer) || !pFunc) {
+		return ADSERR_CLIENT_INVALIDPARM;
+	}
+
+	try {
+		std::unique_ptr<AmsRequest> request{ new AmsRequest{
+			*pAddr, (uint16_t)port, AoEHeader::WRITE, 0, nullptr,
+			nullptr, sizeof(AoERequestHeader) + bufferLength } };
+		request->frame.prepend(buffer, bufferLength);
+		request->frame.prepend<AoERequestHeader>(
+			{ indexGroup, indexOffset, bufferLength });
+		return GetRouter().AdsRequestAsync(
+			std::move(request), MakeCompletion(pFunc, pContext));
+	} catch (const std::bad_alloc &) {
+		return GLOBALERR_NO_MEMORY;
+	}
+}
+
 long AdsSyncWriteControlReqEx(long port, const AmsAddr *pAddr,
 			      uint16_t adsState, uint16_t devState,
 			      uint32_t bufferLength, const void *buffer)
@@ -256,10 +395,11 @@ long AdsSyncAddDeviceNotificationReqEx(long port, const AmsAddr *pAddr,
 			indexGroup, indexOffset, pAttrib->cbLength,
 			pAttrib->nTransMode, pAttrib->nMaxDelay,
 			pAttrib->nCycleTime });
-		auto notify = std::make_shared<Notification>(pFunc, hUser,
-							     pAttrib->cbLength,
-							     *pAddr,
-							     (uint16_t)port);
+		auto notify = std::make_shared<Notification>(
+			pFunc, hUser, pAttrib->cbLength, *pAddr,
+			(uint16_t)port,
+			NotificationSubscription{ indexGroup, indexOffset,
+						  *pAttrib });
 		return GetRouter().AddNotification(request, pNotification,
 						   notify);
 	} catch (const std::bad_alloc &) {
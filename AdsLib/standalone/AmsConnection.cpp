@@ -6,8 +6,25 @@
 #include "AmsConnection.h"
 #include "Log.h"
 
-AmsResponse::AmsResponse()
-	: request(nullptr)
+#include <algorithm>
+
+/** initial size of the receive buffer */
+static const size_t RX_BUFFER_SIZE = 64 * 1024;
+
+/** remainders of at least this size bypass the receive buffer */
+static const size_t RX_DIRECT_READ_SIZE = RX_BUFFER_SIZE / 4;
+
+static uint64_t Microseconds(const Timepoint &from, const Timepoint &to)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(to - from)
+		.count();
+}
+
+AmsResponse::AmsResponse(AmsRequest &__request)
+	: request(__request)
+	, id(0)
+	, tracer(nullptr)
+	, invokeId(0)
 	, wasWritten(false)
 {
 }
@@ -20,11 +37,35 @@ void AmsResponse::Notify(const uint32_t error)
 	cv.notify_all();
 }
 
+AmsAsyncResponse::AmsAsyncResponse(std::unique_ptr<AmsRequest> __request,
+				   AmsCompletion __completion,
+				   bhf::ads::Metrics &__metrics)
+	: AmsResponse(*__request)
+	, ownedRequest(std::move(__request))
+	, completion(__completion)
+	, metrics(__metrics)
+	, bytesRead(0)
+{
+	request.bytesRead = &bytesRead;
+}
+
+void AmsAsyncResponse::Notify(const uint32_t error)
+{
+	if (tracer) {
+		tracer->TraceLatency(request, std::chrono::steady_clock::now());
+	}
+	if (ADSERR_CLIENT_SYNCTIMEOUT == error) {
+		metrics.Add(metrics.timeouts);
+	}
+	completion(error, bytesRead);
+	delete this;
+}
+
 uint32_t AmsResponse::Wait()
 {
 	std::unique_lock<std::mutex> lock(mutex);
 
-	cv.wait_until(lock, request.load()->deadline,
+	cv.wait_until(lock, request.deadline,
 		      [&]() { return !invokeId.load(); });
 
 	if (invokeId.exchange(0)) {
@@ -47,10 +88,13 @@ AmsConnection::DispatcherListAdd(const VirtualConnection &connection)
 	std::lock_guard<std::recursive_mutex> lock(dispatcherListMutex);
 	return dispatcherList
 		.emplace(connection,
-			 std::make_shared<NotificationDispatcher>(std::bind(
-				 &AmsConnection::DeleteNotification, this,
-				 connection.second, std::placeholders::_1,
-				 std::placeholders::_2, connection.first)))
+			 std::make_shared<NotificationDispatcher>(
+				 std::bind(&AmsConnection::DeleteNotification,
+					   this, connection.second,
+					   std::placeholders::_1,
+					   std::placeholders::_2,
+					   connection.first),
+				 notificationPool, &metrics))
 		.first->second;
 }
 
@@ -67,27 +111,84 @@ AmsConnection::DispatcherListGet(const VirtualConnection &connection)
 }
 
 AmsConnection::AmsConnection(Router &__router,
-			     const struct addrinfo *const destination)
+			     const struct addrinfo *const destination,
+			     AmsReactor *const __reactor,
+			     NotificationPool *const __notificationPool)
 	: router(__router)
+	, metrics(__router.metrics)
 	, socket(destination)
+	, reactor(__reactor)
+	, reactorId(0)
+	, notificationPool(__notificationPool)
+	, rxBuffer(RX_BUFFER_SIZE)
+	, rxPos(0)
+	, rxBytes(0)
 	, refCount(0)
 	, invokeId(0)
+	, pendingBytes(0)
+	, sending(false)
+	, stopTimeoutWatcher(false)
+	, latencyTracing(false)
+	, linkState(LinkState::CONNECTED)
+	, linkUp(true)
+	, resubscribe(false)
 	, ownIp(socket.Connect())
 {
-	receiver = std::thread(&AmsConnection::TryRecv, this);
+	if (reactor) {
+		reactorId = reactor->Add(socket.NativeHandle(),
+					 [this]() { return OnReadable(); });
+	} else {
+		receiver = std::thread(&AmsConnection::TryRecv, this);
+	}
 }
 
 AmsConnection::~AmsConnection()
 {
-	socket.Shutdown();
-	receiver.join();
+	std::thread stoppedSupervisor;
+	{
+		std::lock_guard<std::mutex> lock(linkMutex);
+		linkState = LinkState::STOPPED;
+		stoppedSupervisor = std::move(supervisor);
+	}
+	linkChanged.notify_all();
+	if (stoppedSupervisor.joinable()) {
+		stoppedSupervisor.join();
+	}
+
+	if (reactor) {
+		reactor->Remove(reactorId);
+		socket.Shutdown();
+	} else {
+		socket.Shutdown();
+		receiver.join();
+	}
+
+	if (!timeoutWatcher.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		stopTimeoutWatcher = true;
+	}
+	asyncDeadlinesChanged.notify_all();
+	timeoutWatcher.join();
+
+	/* complete all asynchronous requests, which are still pending */
+	for (const auto &entry : asyncDeadlines) {
+		const auto id = entry.second.first;
+		if (pending.Find(id) == entry.second.second) {
+			ErasePending(id, *entry.second.second);
+			entry.second.second->Notify(GLOBALERR_MISSING_ROUTE);
+		}
+	}
 }
 
-SharedDispatcher
-AmsConnection::CreateNotifyMapping(uint32_t hNotify,
-				   std::shared_ptr<Notification> notification)
+SharedDispatcher AmsConnection::CreateNotifyMapping(
+	uint32_t hNotify, std::shared_ptr<Notification> notification,
+	const bhf::ads::NotificationBufferConfig &config)
 {
 	auto dispatcher = DispatcherListAdd(notification->connection);
+	dispatcher->Configure(config);
 	notification->hNotify(hNotify);
 	dispatcher->Emplace(hNotify, notification);
 	return dispatcher;
@@ -112,33 +213,149 @@ bool AmsConnection::IsConnectedTo(const struct addrinfo *targetAddresses) const
 	return socket.IsConnectedTo(targetAddresses);
 }
 
-AmsResponse *AmsConnection::Write(AmsRequest &request, const AmsAddr srcAddr)
+uint32_t AmsConnection::Write(AmsResponse &response, const AmsAddr srcAddr)
 {
+	if (!linkUp.load(std::memory_order_relaxed)) {
+		return 0;
+	}
+	auto &request = response.request;
+	if (latencyTracing.load(std::memory_order_relaxed)) {
+		request.written = std::chrono::steady_clock::now();
+		response.tracer = this;
+	}
+	const auto tracer = response.tracer;
+	const auto written = request.written;
+	const auto target = request.destAddr;
+	const auto cmdId = request.cmdId;
+	Reserve(response);
+
+	const auto id = response.id;
 	const AoEHeader aoeHeader{ request.destAddr.netId,
 				   request.destAddr.port,
 				   srcAddr.netId,
 				   srcAddr.port,
 				   request.cmdId,
 				   static_cast<uint32_t>(request.frame.size()),
-				   GetInvokeId() };
+				   id };
 	request.frame.prepend<AoEHeader>(aoeHeader);
 
 	const AmsTcpHeader header{ static_cast<uint32_t>(
 		request.frame.size()) };
 	request.frame.prepend<AmsTcpHeader>(header);
+	pendingBytes += Load(request);
 
-	auto response = Reserve(&request, srcAddr.port);
+	/* Once sent, asynchronous responses might be gone before write() returns */
+	const auto length = request.frame.size();
+	if (!Send(request.frame, request.trafficClass)) {
+		Withdraw(id, &response);
+		return 0;
+	}
+	metrics.Add(metrics.requests, cmdId);
+	metrics.Add(metrics.bytesSent, length);
+	if (tracer) {
+		const auto sent = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> latencyLock(latencyMutex);
+		Latency(target, cmdId).send.Record(Microseconds(written, sent));
+	}
+	return id;
+}
 
-	if (!response) {
-		return nullptr;
+void AmsConnection::Lane::Push(Outgoing &outgoing)
+{
+	outgoing.next = nullptr;
+	if (tail) {
+		tail->next = &outgoing;
+	} else {
+		head = &outgoing;
 	}
+	tail = &outgoing;
+}
 
-	response->invokeId.store(aoeHeader.invokeId());
-	if (request.frame.size() != socket.write(request.frame)) {
-		response->Release();
-		return nullptr;
+AmsConnection::Outgoing &AmsConnection::Lane::Pop()
+{
+	auto &front = *head;
+	head = front.next;
+	if (!head) {
+		tail = nullptr;
+	}
+	return front;
+}
+
+bool AmsConnection::Send(const Frame &frame,
+			 const bhf::ads::TrafficClass trafficClass)
+{
+	Outgoing outgoing{ frame, false, false, nullptr };
+	std::unique_lock<std::mutex> lock(writeMutex);
+	lanes[trafficClass].Push(outgoing);
+	sendDone.wait(lock, [&]() { return outgoing.done || !sending; });
+	if (outgoing.done) {
+		return outgoing.sent;
+	}
+
+	sending = true;
+	while (!outgoing.done) {
+		auto lane = lanes.begin();
+		while (!lane->head) {
+			++lane;
+		}
+		const auto next = &lane->Pop();
+
+		/* the frame of another thread may be gone, once written */
+		lock.unlock();
+		const auto length = next->frame.size();
+		const auto sent = (length == socket.write(next->frame));
+		lock.lock();
+		next->sent = sent;
+		next->done = true;
+		if (next != &outgoing) {
+			sendDone.notify_all();
+		}
+	}
+	sending = false;
+	sendDone.notify_all();
+	return outgoing.sent;
+}
+
+void AmsConnection::SetLatencyTracing(const bool enable)
+{
+	std::lock_guard<std::mutex> lock(latencyMutex);
+	if (enable) {
+		latencies.clear();
+	}
+	latencyTracing = enable;
+}
+
+void AmsConnection::AppendLatencies(
+	std::vector<bhf::ads::RequestLatency> &stats)
+{
+	std::lock_guard<std::mutex> lock(latencyMutex);
+	for (const auto &entry : latencies) {
+		stats.push_back(entry.second);
 	}
-	return response;
+}
+
+bhf::ads::RequestLatency &AmsConnection::Latency(const AmsAddr &target,
+						 const uint16_t cmdId)
+{
+	auto &latency = latencies[LatencyKey{ target, cmdId }];
+	latency.target = target;
+	latency.cmdId = cmdId;
+	return latency;
+}
+
+void AmsConnection::TraceLatency(const AmsRequest &request,
+				 const Timepoint &woken)
+{
+	if (request.received == Timepoint{}) {
+		/* timed out or was never answered */
+		return;
+	}
+	std::lock_guard<std::mutex> lock(latencyMutex);
+	auto &latency = Latency(request.destAddr, request.cmdId);
+	latency.response.Record(
+		Microseconds(request.written, request.received));
+	latency.wakeup.Record(Microseconds(request.received, woken));
+	latency.total.Record(Microseconds(request.written, woken));
 }
 
 long AmsConnection::AdsRequest(AmsRequest &request, const uint32_t timeout)
@@ -149,14 +366,92 @@ long AmsConnection::AdsRequest(AmsRequest &request, const uint32_t timeout)
 		return status;
 	}
 	request.SetDeadline(timeout);
-	AmsResponse *response = Write(request, srcAddr);
-	if (response) {
-		const auto errorCode = response->Wait();
+	AmsResponse response{ request };
+	if (!Write(response, srcAddr)) {
+		return -1;
+	}
+	const auto errorCode = response.Wait();
+	if (ADSERR_CLIENT_SYNCTIMEOUT == errorCode) {
+		metrics.Add(metrics.timeouts);
+	}
+	if (response.tracer) {
+		TraceLatency(request, std::chrono::steady_clock::now());
+	}
+	Withdraw(response.id, &response);
+	return errorCode;
+}
+
+long AmsConnection::AdsRequestAsync(std::unique_ptr<AmsRequest> request,
+				    AmsCompletion completion,
+				    const uint32_t timeout)
+{
+	AmsAddr srcAddr;
+	const auto status = router.GetLocalAddress(request->port, &srcAddr);
+	if (status) {
+		return status;
+	}
+	request->SetDeadline(timeout);
+	const auto deadline = request->deadline;
+
+	std::call_once(timeoutWatcherStarted, [this]() {
+		timeoutWatcher = std::thread(&AmsConnection::WatchTimeouts, this);
+	});
+
+	auto response = std::unique_ptr<AmsAsyncResponse>(
+		new AmsAsyncResponse{ std::move(request), completion, metrics });
+	const auto id = Write(*response, srcAddr);
+	if (!id) {
+		return -1;
+	}
+
+	/* from now on the response is owned by Recv() or WatchTimeouts() */
+	const auto owned = response.release();
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	const auto it = asyncDeadlines.emplace(deadline,
+					       std::make_pair(id, owned));
+	if (it == asyncDeadlines.begin()) {
+		asyncDeadlinesChanged.notify_one();
+	}
+	return 0;
+}
+
+void AmsConnection::WatchTimeouts()
+{
+	std::unique_lock<std::mutex> lock(pendingMutex);
+	while (!stopTimeoutWatcher) {
+		const auto now = std::chrono::steady_clock::now();
+		std::vector<AmsResponse *> expired;
+		auto next = asyncDeadlines.begin();
+		for (; (next != asyncDeadlines.end()) && (next->first <= now);
+		     ++next) {
+			const auto id = next->second.first;
+			const auto response = next->second.second;
+			if (pending.Find(id) != response) {
+				/* response arrived in time */
+				continue;
+			}
+			auto currentId = id;
+			if (response->invokeId.compare_exchange_strong(currentId,
+								       0)) {
+				expired.push_back(response);
+			}
+			ErasePending(id, *response);
+		}
+		asyncDeadlines.erase(asyncDeadlines.begin(), next);
 
-		response->Release();
-		return errorCode;
+		if (!expired.empty()) {
+			lock.unlock();
+			for (const auto response : expired) {
+				response->Notify(ADSERR_CLIENT_SYNCTIMEOUT);
+			}
+			lock.lock();
+		} else if (asyncDeadlines.empty()) {
+			asyncDeadlinesChanged.wait(lock);
+		} else {
+			asyncDeadlinesChanged.wait_until(
+				lock, asyncDeadlines.begin()->first);
+		}
 	}
-	return -1;
 }
 
 uint32_t AmsConnection::GetInvokeId()
@@ -170,51 +465,102 @@ uint32_t AmsConnection::GetInvokeId()
 
 AmsResponse *AmsConnection::GetPending(const uint32_t id, const uint16_t port)
 {
-	const uint16_t portIndex = port - Router::PORT_BASE;
-	if (portIndex >= Router::NUM_PORTS_MAX) {
-		LOG_WARN("Port 0x" << std::hex << port << " is out of range");
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	const auto response = pending.Find(id);
+	if (!response) {
+		LOG_WARN("InvokeId 0x" << std::hex << id << " is not pending");
+		metrics.Add(metrics.invokeIdMismatches);
 		return nullptr;
 	}
 
+	if (response->request.port != port) {
+		LOG_WARN("InvokeId 0x" << std::hex << id << " was sent from port "
+					<< std::dec << response->request.port
+					<< " but received on " << port);
+		metrics.Add(metrics.invokeIdMismatches);
+		return nullptr;
+	}
+	ErasePending(id, *response);
+
+	/* claim the response, unless the waiter ran into its timeout already */
 	auto currentId = id;
-	if (queue[portIndex].invokeId.compare_exchange_strong(currentId, 0)) {
-		return &queue[portIndex];
+	if (response->invokeId.compare_exchange_strong(currentId, 0)) {
+		if (response->tracer) {
+			response->request.received =
+				std::chrono::steady_clock::now();
+		}
+		metrics.Add(metrics.responses, response->request.cmdId);
+		return response;
 	}
-	LOG_WARN("InvokeId mismatch: waiting for 0x" << std::hex << currentId
-						     << " received 0x" << id);
 	return nullptr;
 }
 
-AmsResponse *AmsConnection::Reserve(AmsRequest *request, const uint16_t port)
+void AmsConnection::Reserve(AmsResponse &response)
 {
-	AmsRequest *isFree = nullptr;
-	if (!queue[port - Router::PORT_BASE].request.compare_exchange_strong(
-		    isFree, request)) {
-		LOG_WARN("Port: " << port << " already in use as " << isFree);
-		return nullptr;
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	do {
+		response.id = GetInvokeId();
+	} while (!pending.Insert(response.id, &response));
+	response.invokeId.store(response.id);
+}
+
+bool AmsConnection::Withdraw(const uint32_t id,
+			     const AmsResponse *const response)
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	if (response && (pending.Find(id) == response)) {
+		ErasePending(id, *response);
+		return true;
 	}
-	return &queue[port - Router::PORT_BASE];
+	return false;
 }
 
-void AmsResponse::Release()
+size_t AmsConnection::Load(const AmsRequest &request)
 {
-	wasWritten = false;
-	request.store(nullptr);
+	return request.frame.size() + request.bufferLength;
 }
 
-void AmsConnection::Receive(void *buffer, size_t bytesToRead,
-			    timeval *timeout) const
+void AmsConnection::ErasePending(const uint32_t id,
+				 const AmsResponse &response)
+{
+	/* Write() added the load after prepending the headers, so it matches */
+	pendingBytes -= Load(response.request);
+	pending.Erase(id);
+}
+
+void AmsConnection::Receive(void *buffer, size_t bytesToRead, timeval *timeout)
 {
 	auto pos = reinterpret_cast<uint8_t *>(buffer);
-	while (bytesToRead) {
+	for (;;) {
+		const auto buffered = std::min(bytesToRead, rxBytes - rxPos);
+		if (buffered) {
+			memcpy(pos, rxBuffer.data() + rxPos, buffered);
+			rxPos += buffered;
+			pos += buffered;
+			bytesToRead -= buffered;
+		}
+		if (bytesToRead < RX_DIRECT_READ_SIZE) {
+			break;
+		}
+		/* large payloads are copied straight into their destination */
 		const size_t bytesRead = socket.read(pos, bytesToRead, timeout);
 		bytesToRead -= bytesRead;
 		pos += bytesRead;
 	}
+
+	while (bytesToRead) {
+		rxPos = 0;
+		rxBytes = socket.read(rxBuffer.data(), rxBuffer.size(), timeout);
+		const auto chunk = std::min(bytesToRead, rxBytes);
+		memcpy(pos, rxBuffer.data(), chunk);
+		rxPos = chunk;
+		pos += chunk;
+		bytesToRead -= chunk;
+	}
 }
 
 void AmsConnection::Receive(void *buffer, size_t bytesToRead,
-			    const Timepoint &deadline) const
+			    const Timepoint &deadline)
 {
 	const auto now = std::chrono::steady_clock::now();
 	const auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
@@ -228,21 +574,25 @@ void AmsConnection::Receive(void *buffer, size_t bytesToRead,
 	Receive(buffer, bytesToRead, &timeout);
 }
 
-void AmsConnection::ReceiveJunk(size_t bytesToRead) const
+void AmsConnection::ReceiveJunk(size_t bytesToRead)
 {
-	uint8_t buffer[1024];
-	while (bytesToRead > sizeof(buffer)) {
-		Receive(buffer, sizeof(buffer));
-		bytesToRead -= sizeof(buffer);
+	for (;;) {
+		const auto buffered = std::min(bytesToRead, rxBytes - rxPos);
+		rxPos += buffered;
+		bytesToRead -= buffered;
+		if (!bytesToRead) {
+			return;
+		}
+		rxPos = 0;
+		rxBytes = socket.read(rxBuffer.data(), rxBuffer.size(), nullptr);
 	}
-	Receive(buffer, bytesToRead);
 }
 
 template <class T>
 void AmsConnection::ReceiveFrame(AmsResponse *const response, size_t bytesLeft,
-				 uint32_t aoeError) const
+				 uint32_t aoeError)
 {
-	AmsRequest *const request = response->request.load();
+	AmsRequest *const request = &response->request;
 	const auto responseId = response->invokeId.load();
 	T header;
 
@@ -257,6 +607,7 @@ void AmsConnection::ReceiveFrame(AmsResponse *const response, size_t bytesLeft,
 			 << std::dec << bytesLeft << '>'
 			 << sizeof(header) + request->bufferLength);
 		response->Notify(ADSERR_DEVICE_INVALIDSIZE);
+		metrics.Add(metrics.junkBytes, bytesLeft);
 		ReceiveJunk(bytesLeft);
 		return;
 	}
@@ -277,7 +628,12 @@ void AmsConnection::ReceiveFrame(AmsResponse *const response, size_t bytesLeft,
 		LOG_WARN("InvokeId of response: " << std::dec << responseId
 						  << " timed out");
 		response->Notify(ADSERR_CLIENT_SYNCTIMEOUT);
+		metrics.Add(metrics.junkBytes, bytesLeft);
 		ReceiveJunk(bytesLeft);
+	} catch (const std::runtime_error &) {
+		/* the response left pending already, nobody else completes it */
+		response->Notify(GLOBALERR_MISSING_ROUTE);
+		throw;
 	}
 }
 
@@ -288,44 +644,402 @@ bool AmsConnection::ReceiveNotification(const AoEHeader &header)
 	if (!dispatcher) {
 		ReceiveJunk(header.length());
 		LOG_WARN("No dispatcher found for notification");
+		metrics.Add(metrics.droppedNotificationFrames);
+		metrics.Add(metrics.droppedNotificationBytes, header.length());
 		return false;
 	}
 
-	auto &ring = dispatcher->ring;
-	auto bytesLeft = header.length();
-	if (bytesLeft + sizeof(bytesLeft) > ring.BytesFree()) {
-		ReceiveJunk(bytesLeft);
+	/* enqueue frames, which were received completely, straight from rxBuffer */
+	const auto length = header.length();
+	const uint8_t *frame = rxBuffer.data() + rxPos;
+	if (rxBytes - rxPos >= length) {
+		rxPos += length;
+	} else {
+		notificationFrame.resize(length);
+		Receive(notificationFrame.data(), length);
+		frame = notificationFrame.data();
+	}
+
+	if (!dispatcher->Enqueue(frame, length)) {
 		LOG_WARN("port " << std::dec << header.targetPort()
 				 << " receive buffer was full");
 		return false;
 	}
+	metrics.Add(metrics.notificationFrames);
+	return true;
+}
+
+template <class T>
+void AmsConnection::CompleteResponse(AmsResponse *const response,
+				     const uint8_t *const data, size_t length,
+				     const uint32_t aoeError) const
+{
+	if (aoeError) {
+		response->Notify(aoeError);
+		return;
+	}
 
-	/** store AoEHeader.length() in ring buffer to support notification parsing */
-	for (size_t i = 0; i < sizeof(bytesLeft); ++i) {
-		*ring.write = (bytesLeft >> (8 * i)) & 0xFF;
-		ring.Write(1);
+	AmsRequest *const request = &response->request;
+	if ((length < sizeof(T)) ||
+	    (length > sizeof(T) + request->bufferLength)) {
+		LOG_WARN("Frame has invalid length: "
+			 << std::dec << length << " expected <= "
+			 << sizeof(T) + request->bufferLength);
+		response->Notify(ADSERR_DEVICE_INVALIDSIZE);
+		metrics.Add(metrics.junkBytes, length);
+		return;
 	}
 
-	auto chunk = ring.WriteChunk();
-	while (bytesLeft > chunk) {
-		Receive(ring.write, chunk);
-		ring.Write(chunk);
-		// We already checked bytesLeft > chunk, well it was not obvious enough for MSVC
-		bytesLeft -= static_cast<decltype(bytesLeft)>(chunk);
-		chunk = ring.WriteChunk();
+	const T header{ data };
+	length -= sizeof(header);
+	if (length) {
+		memcpy(request->buffer, data + sizeof(header), length);
 	}
-	Receive(ring.write, bytesLeft);
-	ring.Write(bytesLeft);
-	dispatcher->Notify();
-	return true;
+	if (request->bytesRead) {
+		// We already checked length <= request->bufferLength
+		*(request->bytesRead) = static_cast<uint32_t>(length);
+	}
+	response->Notify(header.result());
 }
 
-void AmsConnection::TryRecv()
+void AmsConnection::DispatchNotification(const AoEHeader &header,
+					 const uint8_t *const data)
+{
+	const auto dispatcher = DispatcherListGet(
+		VirtualConnection{ header.targetPort(), header.sourceAms() });
+	if (!dispatcher) {
+		LOG_WARN("No dispatcher found for notification");
+		metrics.Add(metrics.droppedNotificationFrames);
+		metrics.Add(metrics.droppedNotificationBytes, header.length());
+		return;
+	}
+
+	if (!dispatcher->Enqueue(data, header.length())) {
+		LOG_WARN("port " << std::dec << header.targetPort()
+				 << " receive buffer was full");
+		return;
+	}
+	metrics.Add(metrics.notificationFrames);
+}
+
+void AmsConnection::ProcessFrame(const uint8_t *const frame,
+				 const size_t length)
+{
+	if (length < sizeof(AoEHeader)) {
+		LOG_WARN("Frame to short to be AoE");
+		metrics.Add(metrics.junkBytes, length);
+		return;
+	}
+
+	const AoEHeader aoeHeader{ frame };
+	const auto data = frame + sizeof(aoeHeader);
+	if (aoeHeader.length() > length - sizeof(aoeHeader)) {
+		LOG_WARN("AoE frame exceeds AMS/TCP frame");
+		metrics.Add(metrics.junkBytes, length);
+		return;
+	}
+
+	if (aoeHeader.cmdId() == AoEHeader::DEVICE_NOTIFICATION) {
+		DispatchNotification(aoeHeader, data);
+		return;
+	}
+
+	auto response =
+		GetPending(aoeHeader.invokeId(), aoeHeader.targetPort());
+	if (!response) {
+		LOG_WARN("No response pending");
+		metrics.Add(metrics.junkBytes, aoeHeader.length());
+		return;
+	}
+
+	switch (aoeHeader.cmdId()) {
+	case AoEHeader::READ_DEVICE_INFO:
+	case AoEHeader::WRITE:
+	case AoEHeader::READ_STATE:
+	case AoEHeader::WRITE_CONTROL:
+	case AoEHeader::ADD_DEVICE_NOTIFICATION:
+	case AoEHeader::DEL_DEVICE_NOTIFICATION:
+		CompleteResponse<AoEResponseHeader>(response, data,
+						    aoeHeader.length(),
+						    aoeHeader.errorCode());
+		return;
+
+	case AoEHeader::READ:
+	case AoEHeader::READ_WRITE:
+		CompleteResponse<AoEReadResponseHeader>(response, data,
+							aoeHeader.length(),
+							aoeHeader.errorCode());
+		return;
+
+	default:
+		LOG_WARN("Unkown AMS command id");
+		response->Notify(ADSERR_CLIENT_SYNCRESINVALID);
+		metrics.Add(metrics.junkBytes, aoeHeader.length());
+	}
+}
+
+void AmsConnection::ParseFrames()
+{
+	size_t pos = 0;
+	while (rxBytes - pos >= sizeof(AmsTcpHeader)) {
+		const AmsTcpHeader amsTcpHeader{ rxBuffer.data() + pos };
+		const auto frameLength =
+			sizeof(amsTcpHeader) + amsTcpHeader.length();
+		if (rxBytes - pos < frameLength) {
+			break;
+		}
+		metrics.Add(metrics.bytesReceived, frameLength);
+		ProcessFrame(rxBuffer.data() + pos + sizeof(amsTcpHeader),
+			     amsTcpHeader.length());
+		pos += frameLength;
+	}
+	rxBytes -= pos;
+	memmove(rxBuffer.data(), rxBuffer.data() + pos, rxBytes);
+}
+
+bool AmsConnection::OnReadable()
 {
 	try {
-		Recv();
+		for (;;) {
+			if (rxBytes == rxBuffer.size()) {
+				/* frame is larger than our buffer */
+				rxBuffer.resize(2 * rxBuffer.size());
+			}
+			const auto bytesRead =
+				socket.TryRead(rxBuffer.data() + rxBytes,
+					       rxBuffer.size() - rxBytes);
+			if (!bytesRead) {
+				return true;
+			}
+			rxBytes += bytesRead;
+			ParseFrames();
+		}
 	} catch (const std::runtime_error &e) {
 		LOG_INFO(e.what());
+		rxBytes = 0;
+		ConnectionLost();
+		return false;
+	}
+}
+
+void AmsConnection::TryRecv()
+{
+	for (;;) {
+		try {
+			Recv();
+			return;
+		} catch (const std::runtime_error &e) {
+			LOG_INFO(e.what());
+		}
+		if (!AwaitReconnect()) {
+			return;
+		}
+		rxPos = 0;
+		rxBytes = 0;
+	}
+}
+
+void AmsConnection::ConnectionLost()
+{
+	std::lock_guard<std::mutex> lock(linkMutex);
+	if (LinkState::CONNECTED != linkState) {
+		/* we are shutting down */
+		return;
+	}
+	linkState = LinkState::LOST;
+	linkUp = false;
+	if (!supervisor.joinable()) {
+		supervisor = std::thread(&AmsConnection::Supervise, this);
+	}
+	linkChanged.notify_all();
+}
+
+bool AmsConnection::AwaitReconnect()
+{
+	ConnectionLost();
+	std::unique_lock<std::mutex> lock(linkMutex);
+	linkChanged.wait(lock,
+			 [&]() { return LinkState::LOST != linkState; });
+	return LinkState::CONNECTED == linkState;
+}
+
+void AmsConnection::Supervise()
+{
+	static const auto minBackoff = std::chrono::milliseconds(100);
+	static const auto maxBackoff = std::chrono::seconds(10);
+	auto backoff = std::chrono::milliseconds(minBackoff);
+
+	std::unique_lock<std::mutex> lock(linkMutex);
+	while (LinkState::STOPPED != linkState) {
+		if (LinkState::LOST == linkState) {
+			lock.unlock();
+			const auto reconnected = Reconnect();
+			lock.lock();
+			if (reconnected && (LinkState::LOST == linkState)) {
+				LOG_INFO("connection reestablished");
+				metrics.Add(metrics.reconnects);
+				if (reactor) {
+					reactorId = reactor->Add(
+						socket.NativeHandle(), [this]() {
+							return OnReadable();
+						});
+				}
+				linkState = LinkState::CONNECTED;
+				linkUp = true;
+				resubscribe = true;
+				backoff = minBackoff;
+				linkChanged.notify_all();
+				continue;
+			}
+		} else if (resubscribe) {
+			lock.unlock();
+			const auto complete = Resubscribe();
+			lock.lock();
+			if (complete) {
+				resubscribe = false;
+				backoff = minBackoff;
+				continue;
+			}
+		} else {
+			linkChanged.wait(lock);
+			continue;
+		}
+
+		linkChanged.wait_for(lock, backoff);
+		backoff = std::min<std::chrono::milliseconds>(2 * backoff,
+							      maxBackoff);
+	}
+}
+
+bool AmsConnection::Reconnect()
+{
+	if (reactor) {
+		/* waits for OnReadable() to return */
+		reactor->Remove(reactorId);
+	}
+
+	/* notifications of the old connection can't arrive anymore */
+	{
+		std::lock_guard<std::recursive_mutex> lock(dispatcherListMutex);
+		for (const auto &d : dispatcherList) {
+			d.second->Detach();
+		}
+	}
+
+	/* block writers, while the socket is replaced */
+	std::unique_lock<std::mutex> lock(writeMutex);
+	sendDone.wait(lock, [&]() { return !sending; });
+	sending = true;
+	lock.unlock();
+	const auto reconnected = socket.Reconnect();
+	lock.lock();
+	sending = false;
+	sendDone.notify_all();
+	return reconnected;
+}
+
+bool AmsConnection::Resubscribe()
+{
+	std::vector<std::pair<VirtualConnection, SharedDispatcher> > dispatchers;
+	{
+		std::lock_guard<std::recursive_mutex> lock(dispatcherListMutex);
+		dispatchers.assign(dispatcherList.begin(), dispatcherList.end());
+	}
+
+	bool complete = true;
+	for (const auto &d : dispatchers) {
+		const auto &connection = d.first;
+		complete &= d.second->Reattach(
+			[&](const Notification &notification, uint32_t &hNotify) {
+				return Subscribe(connection, notification,
+						 hNotify);
+			});
+	}
+	return complete;
+}
+
+long AmsConnection::Subscribe(const VirtualConnection &connection,
+			      const Notification &notification,
+			      uint32_t &hNotify)
+{
+	static const uint32_t SUBSCRIBE_TIMEOUT = 5000;
+	/* keep late responses around, to delete what they subscribed */
+	static const uint32_t LATE_SUBSCRIBE_TIMEOUT = 60000;
+
+	struct Result {
+		std::mutex mutex;
+		std::condition_variable done;
+		bool completed;
+		bool abandoned;
+		uint32_t status;
+		uint8_t buffer[sizeof(hNotify)];
+	};
+	const auto result = std::make_shared<Result>();
+	result->completed = false;
+	result->abandoned = false;
+
+	const auto &s = notification.subscription;
+	std::unique_ptr<AmsRequest> request(
+		new AmsRequest{ connection.second, connection.first,
+				AoEHeader::ADD_DEVICE_NOTIFICATION,
+				sizeof(result->buffer), result->buffer, nullptr,
+				sizeof(AdsAddDeviceNotificationRequest) });
+	request->frame.prepend(AdsAddDeviceNotificationRequest{
+		s.indexGroup, s.indexOffset, s.attrib.cbLength,
+		s.attrib.nTransMode, s.attrib.nMaxDelay, s.attrib.nCycleTime });
+
+	const auto completion = [this, connection, result](uint32_t error,
+							   uint32_t) {
+		std::unique_lock<std::mutex> lock(result->mutex);
+		result->completed = true;
+		result->status = error;
+		if (!result->abandoned) {
+			result->done.notify_all();
+			return;
+		}
+		lock.unlock();
+		if (!error) {
+			/* nobody waits for this handle anymore */
+			DeleteLateNotification(
+				connection,
+				bhf::ads::letoh<uint32_t>(result->buffer));
+		}
+	};
+	const auto status =
+		AdsRequestAsync(std::move(request), completion,
+				SUBSCRIBE_TIMEOUT + LATE_SUBSCRIBE_TIMEOUT);
+	if (status) {
+		return status;
+	}
+
+	std::unique_lock<std::mutex> lock(result->mutex);
+	if (!result->done.wait_for(lock,
+				   std::chrono::milliseconds(SUBSCRIBE_TIMEOUT),
+				   [&]() { return result->completed; })) {
+		result->abandoned = true;
+		metrics.Add(metrics.timeouts);
+		return ADSERR_CLIENT_SYNCTIMEOUT;
+	}
+	if (!result->status) {
+		hNotify = bhf::ads::letoh<uint32_t>(result->buffer);
+	}
+	return result->status;
+}
+
+void AmsConnection::DeleteLateNotification(const VirtualConnection &connection,
+					   const uint32_t hNotify)
+{
+	static const uint32_t DELETE_TIMEOUT = 5000;
+	std::unique_ptr<AmsRequest> request(new AmsRequest{
+		connection.second, connection.first,
+		AoEHeader::DEL_DEVICE_NOTIFICATION, 0, nullptr, nullptr,
+		sizeof(hNotify) });
+	request->frame.prepend(bhf::ads::htole(hNotify));
+	const auto status = AdsRequestAsync(
+		std::move(request), [](uint32_t, uint32_t) {}, DELETE_TIMEOUT);
+	if (status) {
+		LOG_WARN("Deleting late notification 0x"
+			 << std::hex << hNotify << " failed with 0x" << status);
 	}
 }
 
@@ -335,8 +1049,11 @@ void AmsConnection::Recv()
 	AoEHeader aoeHeader;
 	for (; ownIp;) {
 		Receive(amsTcpHeader);
+		metrics.Add(metrics.bytesReceived,
+			    sizeof(amsTcpHeader) + amsTcpHeader.length());
 		if (amsTcpHeader.length() < sizeof(aoeHeader)) {
 			LOG_WARN("Frame to short to be AoE");
+			metrics.Add(metrics.junkBytes, amsTcpHeader.length());
 			ReceiveJunk(amsTcpHeader.length());
 			continue;
 		}
@@ -351,6 +1068,7 @@ void AmsConnection::Recv()
 					   aoeHeader.targetPort());
 		if (!response) {
 			LOG_WARN("No response pending");
+			metrics.Add(metrics.junkBytes, aoeHeader.length());
 			ReceiveJunk(aoeHeader.length());
 			continue;
 		}
@@ -377,6 +1095,7 @@ void AmsConnection::Recv()
 		default:
 			LOG_WARN("Unkown AMS command id");
 			response->Notify(ADSERR_CLIENT_SYNCRESINVALID);
+			metrics.Add(metrics.junkBytes, aoeHeader.length());
 			ReceiveJunk(aoeHeader.length());
 		}
 	}
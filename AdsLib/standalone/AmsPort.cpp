@@ -13,10 +13,32 @@ bool operator==(const AmsAddr &lhs, const AmsAddr &rhs)
 }
 }
 
+const bhf::ads::NotificationBufferConfig AmsPort::DEFAULT_BUFFER{
+	DEFAULT_NOTIFICATION_CAPACITY, bhf::ads::NOTIFICATION_DROP_NEWEST
+};
+
 AmsPort::AmsPort()
 	: tmms(DEFAULT_TIMEOUT)
 	, port(0)
+	, trafficClass(bhf::ads::TRAFFIC_INTERACTIVE)
+	, notificationBuffer(DEFAULT_BUFFER)
+{
+}
+
+void AmsPort::ConfigureNotifications(
+	const bhf::ads::NotificationBufferConfig &config)
 {
+	std::lock_guard<std::mutex> lock(mutex);
+	notificationBuffer = config;
+	for (auto &d : dispatcherList) {
+		d.second->Configure(config);
+	}
+}
+
+bhf::ads::NotificationBufferConfig AmsPort::NotificationBuffer()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return notificationBuffer;
 }
 
 void AmsPort::AddNotification(const AmsAddr ams, const uint32_t hNotify,
@@ -35,6 +57,8 @@ void AmsPort::Close()
 	}
 	dispatcherList.clear();
 	tmms = DEFAULT_TIMEOUT;
+	trafficClass = bhf::ads::TRAFFIC_INTERACTIVE;
+	notificationBuffer = DEFAULT_BUFFER;
 	port = 0;
 }
 
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "AmsReactor.h"
+#include "Log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+/** epoll data of the eventfd used to wake up all threads */
+static const uint64_t WAKEUP_ID = 0;
+
+AmsReactor::AmsReactor(const size_t numThreads)
+	: epollFd(epoll_create1(EPOLL_CLOEXEC))
+	, wakeupFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+	, nextId(WAKEUP_ID + 1)
+	, stopped(false)
+{
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u64 = WAKEUP_ID;
+	if ((epollFd < 0) || (wakeupFd < 0) ||
+	    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupFd, &event)) {
+		const auto error = errno;
+		if (epollFd >= 0) {
+			close(epollFd);
+		}
+		if (wakeupFd >= 0) {
+			close(wakeupFd);
+		}
+		throw std::system_error(error, std::system_category());
+	}
+
+	for (size_t i = 0; i < numThreads; ++i) {
+		threads.emplace_back(&AmsReactor::Run, this);
+	}
+}
+
+AmsReactor::~AmsReactor()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	/* the eventfd stays readable, so it wakes up every thread */
+	const uint64_t one = 1;
+	if (sizeof(one) != write(wakeupFd, &one, sizeof(one))) {
+		LOG_ERROR("AmsReactor wakeup failed: " << strerror(errno));
+	}
+	for (auto &t : threads) {
+		t.join();
+	}
+	close(wakeupFd);
+	close(epollFd);
+}
+
+uint64_t AmsReactor::Add(const SOCKET socket, Handler onReadable)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto id = nextId++;
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.u64 = id;
+	sources.emplace(id, Source{ socket, onReadable, false, false });
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, socket, &event)) {
+		const auto error = errno;
+		sources.erase(id);
+		throw std::system_error(error, std::system_category());
+	}
+	return id;
+}
+
+void AmsReactor::Remove(const uint64_t id)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	const auto it = sources.find(id);
+	if (it == sources.end()) {
+		return;
+	}
+
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.socket, nullptr);
+	if (!it->second.busy) {
+		sources.erase(it);
+		return;
+	}
+
+	/* Handle() erases the source, once its handler returned */
+	it->second.removed = true;
+	idle.wait(lock, [&]() { return sources.find(id) == sources.end(); });
+}
+
+void AmsReactor::Run()
+{
+	epoll_event events[4];
+	for (;;) {
+		const int n = epoll_wait(epollFd, events,
+					 sizeof(events) / sizeof(events[0]), -1);
+		if (n < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			LOG_ERROR("epoll_wait() failed: " << strerror(errno));
+			return;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			if (WAKEUP_ID == events[i].data.u64) {
+				std::lock_guard<std::mutex> lock(mutex);
+				if (stopped) {
+					return;
+				}
+				continue;
+			}
+			Handle(events[i].data.u64);
+		}
+	}
+}
+
+void AmsReactor::Handle(const uint64_t id)
+{
+	Handler onReadable;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto it = sources.find(id);
+		if ((it == sources.end()) || it->second.removed) {
+			return;
+		}
+		it->second.busy = true;
+		onReadable = it->second.onReadable;
+	}
+
+	bool keepWatching = false;
+	try {
+		keepWatching = onReadable();
+	} catch (const std::exception &e) {
+		LOG_ERROR("AmsReactor handler failed: " << e.what());
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto it = sources.find(id);
+	auto &source = it->second;
+	source.busy = false;
+	if (source.removed) {
+		sources.erase(it);
+		idle.notify_all();
+		return;
+	}
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.u64 = id;
+	if (!keepWatching ||
+	    epoll_ctl(epollFd, EPOLL_CTL_MOD, source.socket, &event)) {
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, source.socket, nullptr);
+		sources.erase(it);
+	}
+}
+#else
+AmsReactor::AmsReactor(size_t)
+	: epollFd(-1)
+	, wakeupFd(-1)
+	, nextId(1)
+	, stopped(true)
+{
+	throw std::runtime_error("AmsReactor is only available on Linux");
+}
+
+AmsReactor::~AmsReactor()
+{
+}
+
+uint64_t AmsReactor::Add(SOCKET, Handler)
+{
+	return 0;
+}
+
+void AmsReactor::Remove(uint64_t)
+{
+}
+#endif
@@ -8,9 +8,61 @@
 
 #include <algorithm>
 
+static uint64_t Pack(const AmsNetId &netId)
+{
+	uint64_t value = 0;
+	memcpy(&value, netId.b, sizeof(netId.b));
+	return value;
+}
+
+static AmsNetId Unpack(const uint64_t value)
+{
+	AmsNetId netId;
+	memcpy(netId.b, &value, sizeof(netId.b));
+	return netId;
+}
+
+/** versions of route tables are unique among all routers */
+static std::atomic<uint64_t> g_RouteTableVersion{ 0 };
+
 AmsRouter::AmsRouter(AmsNetId netId)
-	: localAddr(netId)
+	: localAddr(Pack(netId))
+	, latencyTracing(false)
+	, routesVersion(0)
+{
+	PublishRoutes();
+}
+
+void AmsRouter::PublishRoutes()
 {
+	std::unique_ptr<RouteTable> table{ new RouteTable };
+	for (const auto &route : mapping) {
+		auto &conns = (*table)[route.first];
+		conns.push_back(route.second);
+		const auto it = stripes.find(route.first);
+		if (it != stripes.end()) {
+			conns.insert(conns.end(), it->second.begin(),
+				     it->second.end());
+		}
+	}
+	std::lock_guard<std::mutex> lock(routesMutex);
+	routes = std::move(table);
+	routesVersion.store(++g_RouteTableVersion, std::memory_order_release);
+}
+
+const AmsRouter::RouteTable &AmsRouter::Routes()
+{
+	struct Cache {
+		uint64_t version;
+		std::shared_ptr<const RouteTable> table;
+	};
+	static thread_local Cache cache{ 0, nullptr };
+	if (cache.version != routesVersion.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> lock(routesMutex);
+		cache.table = routes;
+		cache.version = routesVersion.load(std::memory_order_relaxed);
+	}
+	return *cache.table;
 }
 
 long AmsRouter::AddRoute(AmsNetId ams, const IpV4 &ip)
@@ -26,7 +78,8 @@ long AmsRouter::AddRoute(AmsNetId ams, const IpV4 &ip)
 	return AddRoute(ams, std::string(inet_ntoa(addr)));
 }
 
-long AmsRouter::AddRoute(AmsNetId ams, const std::string &host)
+long AmsRouter::AddRoute(AmsNetId ams, const std::string &host,
+			 const size_t numConnections)
 {
 	/**
         DNS lookups are pretty time consuming, we shouldn't do them
@@ -49,34 +102,52 @@ long AmsRouter::AddRoute(AmsNetId ams, const std::string &host)
 		return ROUTERERR_PORTALREADYINUSE;
 	}
 
+	const auto numStripes =
+		(oldConnection || !numConnections) ? 0 : numConnections - 1;
 	for (const auto &conn : connections) {
-		if (conn->IsConnectedTo(hostAddresses.get())) {
+		if (!IsStripe(conn.get()) &&
+		    conn->IsConnectedTo(hostAddresses.get())) {
 			conn->refCount++;
-			mapping[ams] = conn.get();
-			return 0;
+			/* every AdsDevice adds its route, mostly a known one */
+			auto &route = mapping[ams];
+			if (route != conn.get()) {
+				route = conn.get();
+				PublishRoutes();
+			}
+			return AddStripes(ams, hostAddresses.get(), numStripes,
+					  lock);
 		}
 	}
 
 	connection_attempts[ams] = {};
+	const auto connectionReactor = reactor.get();
+	const auto connectionPool = notificationPool.get();
 	lock.unlock();
 
 	try {
 		auto new_connection = std::unique_ptr<AmsConnection>(
-			new AmsConnection{ *this, hostAddresses.get() });
+			new AmsConnection{ *this, hostAddresses.get(),
+					   connectionReactor, connectionPool });
 		lock.lock();
 		connection_attempts.erase(ams);
 		connection_attempt_events.notify_all();
 
+		new_connection->SetLatencyTracing(latencyTracing);
 		auto conn = connections.emplace(std::move(new_connection));
 		if (conn.second) {
 			/** in case no local AmsNetId was set previously, we derive one */
-			if (!localAddr) {
-				localAddr =
-					AmsNetId{ conn.first->get()->ownIp };
+			if (!Unpack(localAddr)) {
+				localAddr = Pack(
+					AmsNetId{ conn.first->get()->ownIp });
 			}
 			conn.first->get()->refCount++;
 			mapping[ams] = conn.first->get();
-			return !conn.first->get()->ownIp;
+			PublishRoutes();
+			if (!conn.first->get()->ownIp) {
+				return 1;
+			}
+			return AddStripes(ams, hostAddresses.get(), numStripes,
+					  lock);
 		}
 
 		return -1;
@@ -99,11 +170,87 @@ void AmsRouter::DelRoute(const AmsNetId &ams)
 		AmsConnection *conn = route->second;
 		if (0 == --conn->refCount) {
 			mapping.erase(route);
+			DelStripes(ams);
+			PublishRoutes();
 			DeleteIfLastConnection(conn);
 		}
 	}
 }
 
+bool AmsRouter::IsStripe(const AmsConnection *const conn) const
+{
+	for (const auto &route : stripes) {
+		const auto &conns = route.second;
+		if (std::find(conns.begin(), conns.end(), conn) != conns.end()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+long AmsRouter::AddStripes(const AmsNetId &ams,
+			   const struct addrinfo *const destination,
+			   const size_t count,
+			   std::unique_lock<std::recursive_mutex> &lock)
+{
+	if (!count) {
+		return 0;
+	}
+
+	connection_attempts[ams] = {};
+	const auto connectionReactor = reactor.get();
+	const auto connectionPool = notificationPool.get();
+	lock.unlock();
+
+	std::vector<std::unique_ptr<AmsConnection> > added;
+	try {
+		for (size_t i = 0; i < count; ++i) {
+			added.emplace_back(new AmsConnection{
+				*this, destination, connectionReactor,
+				connectionPool });
+		}
+	} catch (std::exception &e) {
+		added.clear();
+		lock.lock();
+		connection_attempts.erase(ams);
+		connection_attempt_events.notify_all();
+		DelRoute(ams);
+		throw;
+	}
+
+	lock.lock();
+	connection_attempts.erase(ams);
+	connection_attempt_events.notify_all();
+
+	auto &conns = stripes[ams];
+	for (auto &conn : added) {
+		conn->SetLatencyTracing(latencyTracing);
+		conn->refCount++;
+		conns.push_back(conn.get());
+		connections.emplace(std::move(conn));
+	}
+	PublishRoutes();
+	return 0;
+}
+
+void AmsRouter::DelStripes(const AmsNetId &ams)
+{
+	const auto route = stripes.find(ams);
+	if (route == stripes.end()) {
+		return;
+	}
+	for (const auto conn : route->second) {
+		for (auto it = connections.begin(); it != connections.end();
+		     ++it) {
+			if (conn == it->get()) {
+				connections.erase(it);
+				break;
+			}
+		}
+	}
+	stripes.erase(route);
+}
+
 void AmsRouter::DeleteIfLastConnection(const AmsConnection *const conn)
 {
 	if (conn) {
@@ -147,13 +294,12 @@ long AmsRouter::ClosePort(uint16_t port)
 
 long AmsRouter::GetLocalAddress(uint16_t port, AmsAddr *pAddr)
 {
-	std::lock_guard<std::recursive_mutex> lock(mutex);
 	if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
 		return ADSERR_CLIENT_PORTNOTOPEN;
 	}
 
 	if (ports[port - PORT_BASE].IsOpen()) {
-		memcpy(&pAddr->netId, &localAddr, sizeof(localAddr));
+		pAddr->netId = Unpack(localAddr);
 		pAddr->port = port;
 		return 0;
 	}
@@ -162,8 +308,7 @@ long AmsRouter::GetLocalAddress(uint16_t port, AmsAddr *pAddr)
 
 void AmsRouter::SetLocalAddress(AmsNetId netId)
 {
-	std::lock_guard<std::recursive_mutex> lock(mutex);
-	localAddr = netId;
+	localAddr = Pack(netId);
 }
 
 long AmsRouter::GetTimeout(uint16_t port, uint32_t &timeout)
@@ -188,28 +333,172 @@ long AmsRouter::SetTimeout(uint16_t port, uint32_t timeout)
 	return 0;
 }
 
-AmsConnection *AmsRouter::GetConnection(const AmsNetId &amsDest)
+long AmsRouter::SetTrafficClass(const uint16_t port,
+				const bhf::ads::TrafficClass trafficClass)
+{
+	if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX) ||
+	    !ports[port - PORT_BASE].IsOpen()) {
+		return ADSERR_CLIENT_PORTNOTOPEN;
+	}
+	if (trafficClass >= bhf::ads::NUM_TRAFFIC_CLASSES) {
+		return ADSERR_CLIENT_INVALIDPARM;
+	}
+
+	ports[port - PORT_BASE].trafficClass = trafficClass;
+	return 0;
+}
+
+long AmsRouter::SetNotificationBuffer(
+	uint16_t port, const bhf::ads::NotificationBufferConfig &config)
 {
 	std::lock_guard<std::recursive_mutex> lock(mutex);
-	const auto it = mapping.find(amsDest);
-	if (it != mapping.end()) {
-		return it->second;
+	if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
+		return ADSERR_CLIENT_PORTNOTOPEN;
+	}
+
+	ports[port - PORT_BASE].ConfigureNotifications(config);
+	return 0;
+}
+
+long AmsRouter::GetNotificationStats(uint16_t port, const AmsAddr &addr,
+				     bhf::ads::NotificationStats &stats)
+{
+	if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
+		return ADSERR_CLIENT_PORTNOTOPEN;
+	}
+
+	auto ads = GetConnection(addr.netId);
+	if (!ads) {
+		return GLOBALERR_MISSING_ROUTE;
+	}
+
+	const auto dispatcher =
+		ads->DispatcherListGet(VirtualConnection{ port, addr });
+	if (!dispatcher) {
+		return ADSERR_CLIENT_REMOVEHASH;
+	}
+	stats = dispatcher->GetStats();
+	return 0;
+}
+
+AmsConnection *AmsRouter::GetConnection(const AmsNetId &amsDest)
+{
+	const auto &table = Routes();
+	const auto it = table.find(amsDest);
+	if (it != table.end()) {
+		return it->second.front();
 	}
 	return nullptr;
 }
 
+AmsConnection *AmsRouter::SelectConnection(const AmsNetId &amsDest)
+{
+	const auto &table = Routes();
+	const auto it = table.find(amsDest);
+	if (it == table.end()) {
+		return nullptr;
+	}
+
+	auto selected = it->second.front();
+	auto least = selected->pendingBytes.load(std::memory_order_relaxed);
+	for (const auto conn : it->second) {
+		const auto bytes =
+			conn->pendingBytes.load(std::memory_order_relaxed);
+		if (bytes < least) {
+			selected = conn;
+			least = bytes;
+		}
+	}
+	return selected;
+}
+
 long AmsRouter::AdsRequest(AmsRequest &request)
 {
 	if (request.bytesRead) {
 		*request.bytesRead = 0;
 	}
 
-	auto ads = GetConnection(request.destAddr.netId);
+	auto ads = SelectConnection(request.destAddr.netId);
+	if (!ads) {
+		return GLOBALERR_MISSING_ROUTE;
+	}
+	const auto &port = ports[request.port - Router::PORT_BASE];
+	request.trafficClass = port.trafficClass;
+	return ads->AdsRequest(request, port.tmms);
+}
+
+long AmsRouter::AdsRequestAsync(std::unique_ptr<AmsRequest> request,
+				AmsCompletion completion)
+{
+	auto ads = SelectConnection(request->destAddr.netId);
 	if (!ads) {
 		return GLOBALERR_MISSING_ROUTE;
 	}
-	return ads->AdsRequest(request,
-			       ports[request.port - Router::PORT_BASE].tmms);
+	const auto &port = ports[request->port - Router::PORT_BASE];
+	request->trafficClass = port.trafficClass;
+	return ads->AdsRequestAsync(std::move(request), completion, port.tmms);
+}
+
+long AmsRouter::SetReactorThreads(const size_t numThreads)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	if (!connections.empty() || !connection_attempts.empty()) {
+		return ADSERR_DEVICE_INVALIDSTATE;
+	}
+
+	try {
+		reactor.reset(numThreads ? new AmsReactor{ numThreads } :
+					   nullptr);
+	} catch (const std::bad_alloc &) {
+		return GLOBALERR_NO_MEMORY;
+	} catch (const std::exception &e) {
+		LOG_ERROR("Creating AmsReactor failed: " << e.what());
+		return ADSERR_DEVICE_SRVNOTSUPP;
+	}
+	return 0;
+}
+
+long AmsRouter::SetNotificationThreads(const size_t numThreads)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	if (!connections.empty() || !connection_attempts.empty()) {
+		return ADSERR_DEVICE_INVALIDSTATE;
+	}
+
+	try {
+		notificationPool.reset(numThreads ?
+					       new NotificationPool{ numThreads } :
+					       nullptr);
+	} catch (const std::bad_alloc &) {
+		return GLOBALERR_NO_MEMORY;
+	} catch (const std::exception &e) {
+		LOG_ERROR("Creating NotificationPool failed: " << e.what());
+		return ADSERR_DEVICE_SRVNOTSUPP;
+	}
+	return 0;
+}
+
+void AmsRouter::SetLatencyTracing(const bool enable)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	latencyTracing = enable;
+	for (const auto &conn : connections) {
+		conn->SetLatencyTracing(enable);
+	}
+}
+
+void AmsRouter::GetLatencyStats(std::vector<bhf::ads::RequestLatency> &stats)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	stats.clear();
+	for (const auto &conn : connections) {
+		conn->AppendLatencies(stats);
+	}
+}
+
+bhf::ads::MetricsSnapshot AmsRouter::GetMetrics() const
+{
+	return metrics.Snapshot();
 }
 
 long AmsRouter::AddNotification(AmsRequest &request, uint32_t *pNotification,
@@ -225,11 +514,12 @@ long AmsRouter::AddNotification(AmsRequest &request, uint32_t *pNotification,
 	}
 
 	auto &port = ports[request.port - Router::PORT_BASE];
+	request.trafficClass = port.trafficClass;
 	const long status = ads->AdsRequest(request, port.tmms);
 	if (!status) {
 		*pNotification = bhf::ads::letoh<uint32_t>(request.buffer);
-		auto dispatcher =
-			ads->CreateNotifyMapping(*pNotification, notify);
+		auto dispatcher = ads->CreateNotifyMapping(
+			*pNotification, notify, port.NotificationBuffer());
 		port.AddNotification(request.destAddr, *pNotification,
 				     dispatcher);
 	}
@@ -5,22 +5,81 @@
 
 #include "NotificationDispatcher.h"
 #include "Log.h"
+#include <algorithm>
 #include <future>
 
+NotificationPool::NotificationPool(const size_t numThreads)
+	: stopped(false)
+{
+	for (size_t i = 0; i < numThreads; ++i) {
+		threads.emplace_back(&NotificationPool::Run, this);
+	}
+}
+
+NotificationPool::~NotificationPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	ready.notify_all();
+	for (auto &t : threads) {
+		t.join();
+	}
+}
+
+void NotificationPool::Schedule(SharedDispatcher dispatcher)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(dispatcher));
+	}
+	ready.notify_one();
+}
+
+void NotificationPool::Run()
+{
+	for (;;) {
+		SharedDispatcher dispatcher;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			ready.wait(lock,
+				   [&]() { return stopped || !queue.empty(); });
+			if (stopped) {
+				return;
+			}
+			dispatcher = std::move(queue.front());
+			queue.pop_front();
+		}
+		dispatcher->Drain();
+	}
+}
+
 NotificationDispatcher::NotificationDispatcher(
-	DeleteNotificationCallback callback)
+	DeleteNotificationCallback callback, NotificationPool *const __pool,
+	bhf::ads::Metrics *const __metrics)
 	: deleteNotification(callback)
-	, ring(4 * 1024 * 1024)
+	, pool(__pool)
+	, metrics(__metrics)
+	, config{ DEFAULT_NOTIFICATION_CAPACITY, bhf::ads::NOTIFICATION_DROP_NEWEST }
+	, stats{ 0, 0, 0 }
+	, scheduled(false)
 	, stopExecution(false)
-	, thread(&NotificationDispatcher::Run, this)
+	, thread(pool ? std::thread{} :
+			std::thread(&NotificationDispatcher::Run, this))
 {
 }
 
 NotificationDispatcher::~NotificationDispatcher()
 {
-	stopExecution = true;
-	sem.release();
-	thread.join();
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopExecution = true;
+	}
+	queueChanged.notify_all();
+	if (thread.joinable()) {
+		thread.join();
+	}
 }
 
 void NotificationDispatcher::Emplace(uint32_t hNotify,
@@ -32,12 +91,85 @@ void NotificationDispatcher::Emplace(uint32_t hNotify,
 
 long NotificationDispatcher::Erase(uint32_t hNotify, uint32_t tmms)
 {
-	const auto status = deleteNotification(hNotify, tmms);
-	std::lock_guard<std::recursive_mutex> lock(mutex);
-	notifications.erase(hNotify);
+	const auto isNotification =
+		[hNotify](const std::shared_ptr<Notification> &n) {
+			return n->hNotify() == hNotify;
+		};
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	const auto gone =
+		std::find_if(detached.begin(), detached.end(), isNotification);
+	if (gone != detached.end()) {
+		/* the server forgot it already */
+		detached.erase(gone);
+		return 0;
+	}
+
+	/* handles differ only for notifications, which were reattached */
+	auto serverHandle = hNotify;
+	const auto it = notifications.find(hNotify);
+	if ((it == notifications.end()) || !isNotification(it->second)) {
+		for (const auto &n : notifications) {
+			if (isNotification(n.second)) {
+				serverHandle = n.first;
+				break;
+			}
+		}
+	}
+	lock.unlock();
+
+	const auto status = deleteNotification(serverHandle, tmms);
+	lock.lock();
+	notifications.erase(serverHandle);
 	return status;
 }
 
+void NotificationDispatcher::Detach()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	for (const auto &n : notifications) {
+		detached.push_back(n.second);
+	}
+	notifications.clear();
+}
+
+bool NotificationDispatcher::Reattach(const SubscribeCallback &subscribe)
+{
+	static const uint32_t DELETE_TIMEOUT = 5000;
+
+	/* subscribing takes round trips, which must not block dispatching */
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	const auto snapshot = detached;
+	lock.unlock();
+
+	for (const auto &notification : snapshot) {
+		uint32_t hNotify = 0;
+		const auto status = subscribe(*notification, hNotify);
+		if (status) {
+			LOG_WARN("Subscribing notification 0x"
+				 << std::hex << notification->hNotify()
+				 << " again failed with 0x" << status);
+			continue;
+		}
+
+		lock.lock();
+		const auto it = std::find(detached.begin(), detached.end(),
+					  notification);
+		if (it != detached.end()) {
+			notifications.emplace(hNotify, notification);
+			detached.erase(it);
+			lock.unlock();
+			continue;
+		}
+		lock.unlock();
+
+		/* the application deleted it, while we were subscribing */
+		deleteNotification(hNotify, DELETE_TIMEOUT);
+	}
+
+	lock.lock();
+	return detached.empty();
+}
+
 std::shared_ptr<Notification> NotificationDispatcher::Find(uint32_t hNotify)
 {
 	std::lock_guard<std::recursive_mutex> lock(mutex);
@@ -48,54 +180,231 @@ std::shared_ptr<Notification> NotificationDispatcher::Find(uint32_t hNotify)
 	return {};
 }
 
-void NotificationDispatcher::Notify()
+void NotificationDispatcher::Configure(
+	const bhf::ads::NotificationBufferConfig &newConfig)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		config = newConfig;
+	}
+	/* blocked receivers might fit now */
+	queueChanged.notify_all();
+}
+
+bhf::ads::NotificationStats NotificationDispatcher::GetStats()
 {
-	sem.release();
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return stats;
+}
+
+bool NotificationDispatcher::MakeRoom(std::unique_lock<std::mutex> &lock,
+				      const size_t length)
+{
+	/* a frame larger than the capacity is accepted, if nothing is queued */
+	const auto fits = [&](const size_t dropped) {
+		const auto queued = queue.size() - dropped;
+		return !queued || (queued + length <= config.capacity);
+	};
+
+	switch (config.overflow) {
+	case bhf::ads::NOTIFICATION_DROP_OLDEST: {
+		size_t dropped = 0;
+		while (!fits(dropped)) {
+			const auto oldest =
+				bhf::ads::letoh<uint32_t>(queue.data() + dropped);
+			dropped += sizeof(oldest) + oldest;
+			CountDropped(oldest);
+		}
+		queue.erase(queue.begin(), queue.begin() + dropped);
+		return true;
+	}
+
+	case bhf::ads::NOTIFICATION_BLOCK:
+		queueChanged.wait(lock, [&]() {
+			return stopExecution ||
+			       (config.overflow != bhf::ads::NOTIFICATION_BLOCK) ||
+			       fits(0);
+		});
+		if (stopExecution) {
+			return false;
+		}
+		/* the policy might have been changed, while we were waiting */
+		return fits(0) || MakeRoom(lock, length);
+
+	case bhf::ads::NOTIFICATION_GROW:
+		return true;
+
+	default:
+		return fits(0);
+	}
+}
+
+bool NotificationDispatcher::Enqueue(const uint8_t *const frame,
+				     const uint32_t length)
+{
+	/** store AoEHeader.length() in front of the frame to support parsing */
+	const auto leLength = bhf::ads::htole(length);
+	bool schedule;
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		if (!MakeRoom(lock, sizeof(leLength) + length)) {
+			CountDropped(length);
+			return false;
+		}
+		const auto bytes = reinterpret_cast<const uint8_t *>(&leLength);
+		queue.insert(queue.end(), bytes, bytes + sizeof(leLength));
+		queue.insert(queue.end(), frame, frame + length);
+		stats.maxQueuedBytes =
+			std::max<uint64_t>(stats.maxQueuedBytes, queue.size());
+		if (metrics) {
+			metrics->Max(metrics->maxQueuedNotificationBytes,
+				     queue.size());
+		}
+		schedule = pool && !scheduled;
+		scheduled = true;
+	}
+	if (schedule) {
+		pool->Schedule(shared_from_this());
+	} else if (!pool) {
+		queueChanged.notify_all();
+	}
+	return true;
+}
+
+void NotificationDispatcher::DispatchFrames()
+{
+	/* the queue is empty now, so blocked receivers can continue */
+	queueChanged.notify_all();
+	size_t pos = 0;
+	while (processing.size() - pos >= sizeof(uint32_t)) {
+		const auto length =
+			bhf::ads::letoh<uint32_t>(processing.data() + pos);
+		pos += sizeof(length);
+		Dispatch(processing.data() + pos, length);
+		pos += length;
+	}
+	processing.clear();
 }
 
 void NotificationDispatcher::Run()
 {
+	std::unique_lock<std::mutex> lock(queueMutex);
 	for (;;) {
-		sem.acquire();
+		queueChanged.wait(lock,
+				  [&]() { return stopExecution || !queue.empty(); });
 		if (stopExecution) {
 			return;
 		}
-		auto fullLength = ring.ReadFromLittleEndian<uint32_t>();
-		const auto length = ring.ReadFromLittleEndian<uint32_t>();
-		(void)length;
-		const auto numStamps = ring.ReadFromLittleEndian<uint32_t>();
-		fullLength -= sizeof(length) + sizeof(numStamps);
-		for (uint32_t stamp = 0; stamp < numStamps; ++stamp) {
-			const auto timestamp =
-				ring.ReadFromLittleEndian<uint64_t>();
-			const auto numSamples =
-				ring.ReadFromLittleEndian<uint32_t>();
-			fullLength -= sizeof(timestamp) + sizeof(numSamples);
-			for (uint32_t sample = 0; sample < numSamples;
-			     ++sample) {
-				const auto hNotify =
-					ring.ReadFromLittleEndian<uint32_t>();
-				const auto size =
-					ring.ReadFromLittleEndian<uint32_t>();
-				fullLength -= sizeof(hNotify) + sizeof(size);
-				const auto notification = Find(hNotify);
-				if (notification) {
-					if (size != notification->Size()) {
-						LOG_WARN(
-							"Notification sample size: "
-							<< size
-							<< " doesn't match: "
-							<< notification->Size());
-						goto cleanup;
-					}
-					notification->Notify(timestamp, ring);
-				} else {
-					ring.Read(size);
+		processing.swap(queue);
+		lock.unlock();
+		DispatchFrames();
+		lock.lock();
+	}
+}
+
+void NotificationDispatcher::Drain()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		processing.swap(queue);
+	}
+	DispatchFrames();
+
+	/* requeue instead of looping, so busy dispatchers can't starve others */
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (queue.empty()) {
+			scheduled = false;
+			return;
+		}
+	}
+	pool->Schedule(shared_from_this());
+}
+
+void NotificationDispatcher::Deliver(Notification &notification,
+				     const uint64_t timestamp,
+				     const uint32_t hNotify,
+				     uint8_t *const data)
+{
+	AdsNotificationHeader header;
+	header.nTimeStamp = timestamp;
+	header.hNotification = hNotify;
+	header.cbSampleSize = notification.Size();
+
+	/*
+	 * The bytes in front of the sample data were parsed already, so we
+	 * overwrite them with the header and pass the sample to the callback
+	 * without copying it.
+	 */
+	const auto inplace = data - sizeof(header);
+	memcpy(inplace, &header, sizeof(header));
+	notification.Notify(
+		reinterpret_cast<const AdsNotificationHeader *>(inplace));
+	if (metrics) {
+		metrics->Add(metrics->notificationSamples);
+	}
+}
+
+void NotificationDispatcher::CountDropped(const uint64_t length)
+{
+	++stats.droppedFrames;
+	stats.droppedBytes += length;
+	if (metrics) {
+		metrics->Add(metrics->droppedNotificationFrames);
+		metrics->Add(metrics->droppedNotificationBytes, length);
+	}
+}
+
+void NotificationDispatcher::Dispatch(uint8_t *const frame,
+				      const size_t length)
+{
+	static const size_t stampHeaderSize =
+		sizeof(uint64_t) + sizeof(uint32_t);
+	static const size_t sampleHeaderSize = 2 * sizeof(uint32_t);
+
+	/* skip the length, which duplicates AoEHeader.length() */
+	auto pos = frame + sizeof(uint32_t);
+	const auto end = frame + length;
+	if (length < 2 * sizeof(uint32_t)) {
+		LOG_WARN("Notification frame too short");
+		return;
+	}
+	const auto numStamps = bhf::ads::letoh<uint32_t>(pos);
+	pos += sizeof(numStamps);
+	for (uint32_t stamp = 0; stamp < numStamps; ++stamp) {
+		if (static_cast<size_t>(end - pos) < stampHeaderSize) {
+			LOG_WARN("Notification frame too short");
+			return;
+		}
+		const auto timestamp = bhf::ads::letoh<uint64_t>(pos);
+		const auto numSamples =
+			bhf::ads::letoh<uint32_t>(pos + sizeof(timestamp));
+		pos += stampHeaderSize;
+		for (uint32_t sample = 0; sample < numSamples; ++sample) {
+			if (static_cast<size_t>(end - pos) < sampleHeaderSize) {
+				LOG_WARN("Notification frame too short");
+				return;
+			}
+			const auto hNotify = bhf::ads::letoh<uint32_t>(pos);
+			const auto size =
+				bhf::ads::letoh<uint32_t>(pos + sizeof(hNotify));
+			pos += sampleHeaderSize;
+			if (static_cast<size_t>(end - pos) < size) {
+				LOG_WARN("Notification sample exceeds frame");
+				return;
+			}
+			const auto notification = Find(hNotify);
+			if (notification) {
+				if (size != notification->Size()) {
+					LOG_WARN("Notification sample size: "
+						 << size << " doesn't match: "
+						 << notification->Size());
+					return;
 				}
-				fullLength -= size;
+				Deliver(*notification, timestamp,
+					notification->hNotify(), pos);
 			}
+			pos += size;
 		}
-cleanup:
-		ring.Read(fullLength);
 	}
 }
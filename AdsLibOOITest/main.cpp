@@ -13,6 +13,7 @@
 #include <iostream>
 #include <iomanip>
 #include <thread>
+#include <vector>
 
 #include <fructose/fructose.h>
 using namespace fructose;
@@ -149,6 +150,140 @@ struct TestAds : test_base<TestAds> {
 		std::cout << buffer.operator LargeBuffer()[0] << '\n';
 	}
 
+	void testAdsReadReqAsync(const std::string &)
+	{
+		AdsDevice route{ "ads-server", serverNetId,
+				 AMSPORT_R0_PLC_TC3 };
+		const uint32_t outBuffer = 0;
+		route.WriteReqAsync(0x4020, 0, sizeof(outBuffer), &outBuffer)
+			.get();
+
+		std::array<uint32_t, NUM_TEST_LOOPS> buffer;
+		std::vector<std::future<uint32_t> > pending;
+		for (auto &b : buffer) {
+			b = 0xDEADBEEF;
+			pending.push_back(
+				route.ReadReqAsync(0x4020, 0, sizeof(b), &b));
+		}
+		for (size_t i = 0; i < buffer.size(); ++i) {
+			fructose_loop_assert(i, sizeof(buffer[i]) ==
+							pending[i].get());
+			fructose_loop_assert(i, 0 == buffer[i]);
+		}
+
+		// ADS errors are thrown by the future
+		auto unsupported = route.ReadReqAsync(0, 0, sizeof(buffer[0]),
+						      &buffer[0]);
+		try {
+			unsupported.get();
+			fructose_assert(false);
+		} catch (const AdsException &ex) {
+			fructose_assert(ADSERR_DEVICE_SRVNOTSUPP ==
+					ex.errorCode);
+		}
+	}
+
+	void testSumRead(const std::string &)
+	{
+		AdsDevice route{ "ads-server", serverNetId,
+				 AMSPORT_R0_PLC_TC3 };
+		const uint32_t outBuffer = 0;
+		fructose_assert(0 == route.WriteReqEx(0x4020, 0,
+						      sizeof(outBuffer),
+						      &outBuffer));
+
+		// more items than fit into a single sum command
+		std::vector<uint32_t> buffer(SUM_COMMAND_MAX_ITEMS + 10,
+					     0xDEADBEEF);
+		std::vector<AdsDevice::ReadItem> items;
+		for (auto &b : buffer) {
+			items.push_back({ 0x4020, 0, sizeof(b), &b });
+		}
+		// provide invalid indexGroup
+		items[1].indexGroup = 0;
+
+		fructose_assert(0 == route.SumRead(items));
+		for (size_t i = 0; i < items.size(); ++i) {
+			if (1 == i) {
+				fructose_assert(ADSERR_DEVICE_SRVNOTSUPP ==
+						items[i].error);
+				fructose_assert(0xDEADBEEF == buffer[i]);
+			} else {
+				fructose_loop_assert(i, 0 == items[i].error);
+				fructose_loop_assert(i, 0 == buffer[i]);
+			}
+		}
+	}
+
+	void testSumWriteAndReadWrite(const std::string &)
+	{
+		AdsDevice route{ "ads-server", serverNetId,
+				 AMSPORT_R0_PLC_TC3 };
+
+		const uint32_t outBuffer[] = { 0x11223344, 0x55667788 };
+		std::vector<AdsDevice::WriteItem> writes{
+			{ 0x4020, 0, sizeof(outBuffer[0]), &outBuffer[0] },
+			{ 0, 0, sizeof(outBuffer[1]), &outBuffer[1] },
+			{ 0x4020, 4, sizeof(outBuffer[1]), &outBuffer[1] },
+		};
+		fructose_assert(0 == route.SumWrite(writes));
+		fructose_assert(0 == writes[0].error);
+		fructose_assert(ADSERR_DEVICE_SRVNOTSUPP == writes[1].error);
+		fructose_assert(0 == writes[2].error);
+
+		static const char handleName[] = "MAIN.byByte";
+		uint32_t handle = 0;
+		uint32_t inBuffer[2] = {};
+		std::vector<AdsDevice::ReadWriteItem> readWrites{
+			{ ADSIGRP_SYM_HNDBYNAME, 0, sizeof(handle), &handle,
+			  sizeof(handleName), handleName },
+			{ 0x4020, 0, sizeof(inBuffer), &inBuffer, 0, nullptr },
+		};
+		fructose_assert(0 == route.SumReadWrite(readWrites));
+		fructose_assert(0 == readWrites[0].error);
+		fructose_assert(sizeof(handle) == readWrites[0].bytesRead);
+		fructose_assert(0 == readWrites[1].error);
+		fructose_assert(sizeof(inBuffer) == readWrites[1].bytesRead);
+		fructose_assert(outBuffer[0] == inBuffer[0]);
+		fructose_assert(outBuffer[1] == inBuffer[1]);
+
+		fructose_assert(0 == route.WriteReqEx(ADSIGRP_SYM_RELEASEHND, 0,
+						      sizeof(handle), &handle));
+	}
+
+	void testGetHandles(const std::string &)
+	{
+		AdsDevice route{ "ads-server", serverNetId,
+				 AMSPORT_R0_PLC_TC3 };
+		const std::vector<std::string> names(NUM_TEST_LOOPS,
+						     "MAIN.byByte");
+		{
+			const auto handles = route.GetHandles(names);
+			fructose_assert(names.size() == handles.size());
+			for (size_t i = 0; i < handles.size(); ++i) {
+				uint32_t buffer;
+				uint32_t bytesRead = 0;
+				fructose_loop_assert(
+					i, 0 == route.ReadReqEx2(
+						       ADSIGRP_SYM_VALBYHND,
+						       *handles[i],
+						       sizeof(buffer), &buffer,
+						       &bytesRead));
+				fructose_loop_assert(i, sizeof(buffer) ==
+								bytesRead);
+			}
+		}
+
+		// provide unknown symbol
+		try {
+			route.GetHandles({ "MAIN.byByte", "MAIN.unknown" });
+			fructose_assert(false);
+		} catch (const AdsException &ex) {
+			fructose_assert(ADSERR_DEVICE_SYMBOLNOTFOUND ==
+					ex.errorCode);
+		}
+	}
+
 	void testAdsReadDeviceInfoReqEx(const std::string &)
 	{
 		static const char NAME[] = "Plc30 App";
@@ -670,6 +805,11 @@ int main()
 	adsTest.add_test("testAdsReadReqEx2", &TestAds::testAdsReadReqEx2);
 	adsTest.add_test("testAdsReadReqEx2LargeBuffer",
 			 &TestAds::testAdsReadReqEx2LargeBuffer);
+	adsTest.add_test("testAdsReadReqAsync", &TestAds::testAdsReadReqAsync);
+	adsTest.add_test("testSumRead", &TestAds::testSumRead);
+	adsTest.add_test("testSumWriteAndReadWrite",
+			 &TestAds::testSumWriteAndReadWrite);
+	adsTest.add_test("testGetHandles", &TestAds::testGetHandles);
 	adsTest.add_test("testAdsReadDeviceInfoReqEx",
 			 &TestAds::testAdsReadDeviceInfoReqEx);
 	adsTest.add_test("testAdsReadStateReqEx",
@@ -0,0 +1,963 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "AdsServer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+namespace bhf
+{
+namespace adstest
+{
+/** 100ns intervals between 1601-01-01 (FILETIME) and 1970-01-01 */
+static const uint64_t FILETIME_UNIX_EPOCH = 116444736000000000ULL;
+
+const uint32_t AdsServer::MEMORY_GROUP;
+
+template <typename T> static void Append(std::vector<uint8_t> &out, T value)
+{
+	value = bhf::ads::htole(value);
+	const auto bytes = reinterpret_cast<const uint8_t *>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+static void Append(std::vector<uint8_t> &out, const void *data, size_t length)
+{
+	const auto bytes = static_cast<const uint8_t *>(data);
+	out.insert(out.end(), bytes, bytes + length);
+}
+
+/** AMS/TCP header and AoE header with an arbitrary stateFlags field */
+static std::vector<uint8_t> MakeFrame(const AmsAddr &target,
+				      const AmsAddr &source, uint16_t cmdId,
+				      uint16_t stateFlags, uint32_t errorCode,
+				      uint32_t invokeId,
+				      const std::vector<uint8_t> &body)
+{
+	std::vector<uint8_t> frame;
+	frame.reserve(sizeof(AmsTcpHeader) + sizeof(AoEHeader) + body.size());
+	const auto length = static_cast<uint32_t>(body.size());
+	Append<uint16_t>(frame, 0);
+	Append<uint32_t>(frame, sizeof(AoEHeader) + length);
+	Append(frame, &target.netId, sizeof(target.netId));
+	Append(frame, target.port);
+	Append(frame, &source.netId, sizeof(source.netId));
+	Append(frame, source.port);
+	Append(frame, cmdId);
+	Append(frame, stateFlags);
+	Append(frame, length);
+	Append(frame, errorCode);
+	Append(frame, invokeId);
+	Append(frame, body.data(), body.size());
+	return frame;
+}
+
+/* sending to a closed connection should fail, instead of raising SIGPIPE */
+#if defined(MSG_NOSIGNAL)
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+struct AdsServer::Connection {
+	SOCKET sock;
+	std::mutex sendMutex;
+
+	/** responses waiting for their emulated latency to expire */
+	std::mutex delayedMutex;
+	std::condition_variable delayedChanged;
+	std::multimap<std::chrono::steady_clock::time_point,
+		      std::vector<uint8_t> >
+		delayed;
+	std::mt19937 random;
+	bool closed;
+
+	std::thread receiver;
+	std::thread sender;
+
+	Connection(SOCKET s)
+		: sock(s)
+		, random(0)
+		, closed(false)
+	{
+	}
+
+	bool Recv(uint8_t *data, size_t length)
+	{
+		while (length) {
+			const auto bytesRead =
+				recv(sock, reinterpret_cast<char *>(data),
+				     static_cast<int>(length), 0);
+			if (bytesRead <= 0) {
+				return false;
+			}
+			data += bytesRead;
+			length -= bytesRead;
+		}
+		return true;
+	}
+
+	void Send(const std::vector<uint8_t> &frame)
+	{
+		std::lock_guard<std::mutex> lock(sendMutex);
+		auto data = frame.data();
+		auto length = frame.size();
+		while (length) {
+			const auto sent =
+				send(sock, reinterpret_cast<const char *>(data),
+				     static_cast<int>(length), SEND_FLAGS);
+			if (sent <= 0) {
+				return;
+			}
+			data += sent;
+			length -= sent;
+		}
+	}
+
+	void SendDelayed()
+	{
+		std::unique_lock<std::mutex> lock(delayedMutex);
+		while (!closed) {
+			if (delayed.empty()) {
+				delayedChanged.wait(lock);
+				continue;
+			}
+			const auto next = delayed.begin();
+			if (next->first > std::chrono::steady_clock::now()) {
+				delayedChanged.wait_until(lock, next->first);
+				continue;
+			}
+			const auto frame = std::move(next->second);
+			delayed.erase(next);
+			lock.unlock();
+			Send(frame);
+			lock.lock();
+		}
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(delayedMutex);
+			closed = true;
+		}
+		delayedChanged.notify_all();
+		shutdown(sock, SHUT_RDWR);
+	}
+};
+
+AdsServer::AdsServer(const uint16_t tcpPort, const size_t memorySize)
+	: listener(socket(AF_INET, SOCK_STREAM, 0))
+	, port(0)
+	, stopped(false)
+	, latency(0)
+	, jitter(0)
+	, nextHandle(1)
+	, symbolVersion(1)
+	, nextNotification(1)
+	, adsState(ADSSTATE_RUN)
+	, devState(0)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(tcpPort);
+	socklen_t addrLen = sizeof(addr);
+	if (bind(listener, reinterpret_cast<sockaddr *>(&addr),
+		 sizeof(addr)) ||
+	    listen(listener, 8) ||
+	    getsockname(listener, reinterpret_cast<sockaddr *>(&addr),
+			&addrLen)) {
+		closesocket(listener);
+		throw std::runtime_error("AdsServer listener failed");
+	}
+	port = ntohs(addr.sin_port);
+	memory[MEMORY_GROUP].resize(memorySize);
+
+	acceptor = std::thread(&AdsServer::Accept, this);
+	notifier = std::thread(&AdsServer::Notify, this);
+}
+
+AdsServer::~AdsServer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	notificationsChanged.notify_all();
+	shutdown(listener, SHUT_RDWR);
+	closesocket(listener);
+	acceptor.join();
+	notifier.join();
+
+	/* acceptor is gone, so connections isn't modified anymore */
+	for (auto &c : connections) {
+		c->Close();
+		c->receiver.join();
+		c->sender.join();
+		closesocket(c->sock);
+	}
+}
+
+std::string AdsServer::Host() const
+{
+	return "127.0.0.1:" + std::to_string(port);
+}
+
+void AdsServer::SetLatency(const std::chrono::microseconds newLatency,
+			   const std::chrono::microseconds newJitter)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	latency = newLatency;
+	jitter = newJitter;
+}
+
+void AdsServer::AddSymbol(const std::string &name, const uint32_t indexGroup,
+			  const uint32_t indexOffset, const uint32_t size,
+			  const uint32_t dataType, const std::string &typeName,
+			  const std::string &comment)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	symbols.push_back({ name, indexGroup, indexOffset, size, dataType,
+			    typeName, comment });
+	++symbolVersion;
+}
+
+void AdsServer::AddDataType(const DataType &type)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	dataTypes.push_back(type);
+}
+
+void AdsServer::AddMemory(const uint32_t indexGroup, const size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	memory[indexGroup].resize(size);
+}
+
+void AdsServer::Write(const uint32_t indexGroup, const uint32_t indexOffset,
+		      const void *const data, const size_t length)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t error;
+	const auto dest = Memory(indexGroup, indexOffset,
+				 static_cast<uint32_t>(length), error);
+	if (!dest) {
+		throw std::out_of_range("AdsServer::Write() out of range");
+	}
+	memcpy(dest, data, length);
+}
+
+void AdsServer::OnlineChange()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	handles.clear();
+	++symbolVersion;
+}
+
+void AdsServer::Restart()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto &c : connections) {
+		c->Close();
+	}
+}
+
+void AdsServer::Accept()
+{
+	for (;;) {
+		const auto sock = accept(listener, nullptr, nullptr);
+		if (INVALID_SOCKET == sock) {
+			return;
+		}
+
+		/* answer pipelined requests without waiting for Nagle */
+		const int enable = 1;
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
+			   reinterpret_cast<const char *>(&enable),
+			   sizeof(enable));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopped) {
+			closesocket(sock);
+			return;
+		}
+		const auto c = std::make_shared<Connection>(sock);
+		c->receiver = std::thread(&AdsServer::Serve, this, c);
+		c->sender = std::thread(&Connection::SendDelayed, c.get());
+		connections.push_back(c);
+	}
+}
+
+void AdsServer::Serve(const SharedConnection connection)
+{
+	uint8_t tcpHeader[sizeof(AmsTcpHeader)];
+	std::vector<uint8_t> request;
+	while (connection->Recv(tcpHeader, sizeof(tcpHeader))) {
+		request.resize(AmsTcpHeader{ tcpHeader }.length());
+		if (!connection->Recv(request.data(), request.size())) {
+			break;
+		}
+		if (request.size() < sizeof(AoEHeader)) {
+			continue;
+		}
+
+		const AoEHeader header{ request.data() };
+		const auto length = std::min<size_t>(
+			header.length(), request.size() - sizeof(AoEHeader));
+		uint32_t errorCode = 0;
+		const auto body =
+			Handle(connection, header,
+			       request.data() + sizeof(AoEHeader), length,
+			       errorCode);
+		Respond(*connection, header, body, errorCode);
+	}
+
+	/* the client is gone, so are its notifications */
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto it = notifications.begin(); it != notifications.end();) {
+		if (it->second.connection == connection) {
+			it = notifications.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void AdsServer::Respond(Connection &connection, const AoEHeader &request,
+			const std::vector<uint8_t> &body,
+			const uint32_t errorCode)
+{
+	auto frame = MakeFrame(request.sourceAms(),
+			       AmsAddr{ request.targetAddr(),
+					request.targetPort() },
+			       request.cmdId(), AoEHeader::AMS_RESPONSE,
+			       errorCode, request.invokeId(), body);
+
+	std::chrono::microseconds delay;
+	std::chrono::microseconds maxJitter;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		delay = latency;
+		maxJitter = jitter;
+	}
+	if (!delay.count() && !maxJitter.count()) {
+		connection.Send(frame);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(connection.delayedMutex);
+		if (maxJitter.count()) {
+			std::uniform_int_distribution<int64_t> distribution(
+				0, maxJitter.count());
+			delay += std::chrono::microseconds(
+				distribution(connection.random));
+		}
+		connection.delayed.emplace(std::chrono::steady_clock::now() +
+						   delay,
+					   std::move(frame));
+	}
+	connection.delayedChanged.notify_all();
+}
+
+std::vector<uint8_t> AdsServer::Handle(const SharedConnection &connection,
+				       const AoEHeader &header,
+				       const uint8_t *const data,
+				       const size_t length,
+				       uint32_t &errorCode)
+{
+	std::vector<uint8_t> body;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	switch (header.cmdId()) {
+	case AoEHeader::READ_DEVICE_INFO: {
+		static const char name[16] = "Plc30 App";
+		Append<uint32_t>(body, ADSERR_NOERR);
+		Append<uint8_t>(body, 3);
+		Append<uint8_t>(body, 1);
+		Append<uint16_t>(body, 4024);
+		Append(body, name, sizeof(name));
+		return body;
+	}
+
+	case AoEHeader::READ: {
+		if (length < 3 * sizeof(uint32_t)) {
+			break;
+		}
+		std::vector<uint8_t> out;
+		const auto result = ReadData(
+			bhf::ads::letoh<uint32_t>(data),
+			bhf::ads::letoh<uint32_t>(data + 4),
+			bhf::ads::letoh<uint32_t>(data + 8), out);
+		Append(body, result);
+		Append(body, static_cast<uint32_t>(out.size()));
+		Append(body, out.data(), out.size());
+		return body;
+	}
+
+	case AoEHeader::WRITE: {
+		if (length < 3 * sizeof(uint32_t)) {
+			break;
+		}
+		const auto writeLength = bhf::ads::letoh<uint32_t>(data + 8);
+		if (length - 3 * sizeof(uint32_t) < writeLength) {
+			break;
+		}
+		Append(body, WriteData(bhf::ads::letoh<uint32_t>(data),
+				       bhf::ads::letoh<uint32_t>(data + 4),
+				       data + 12, writeLength));
+		return body;
+	}
+
+	case AoEHeader::READ_STATE:
+		Append<uint32_t>(body, ADSERR_NOERR);
+		Append(body, adsState);
+		Append(body, devState);
+		return body;
+
+	case AoEHeader::WRITE_CONTROL:
+		if (length < 2 * sizeof(uint16_t) + sizeof(uint32_t)) {
+			break;
+		}
+		adsState = bhf::ads::letoh<uint16_t>(data);
+		devState = bhf::ads::letoh<uint16_t>(data + 2);
+		Append<uint32_t>(body, ADSERR_NOERR);
+		return body;
+
+	case AoEHeader::ADD_DEVICE_NOTIFICATION: {
+		if (length < sizeof(AdsAddDeviceNotificationRequest)) {
+			break;
+		}
+		DeviceNotification n;
+		n.connection = connection;
+		n.client = header.sourceAms();
+		n.server = AmsAddr{ header.targetAddr(), header.targetPort() };
+		n.indexGroup = bhf::ads::letoh<uint32_t>(data);
+		n.indexOffset = bhf::ads::letoh<uint32_t>(data + 4);
+		n.length = bhf::ads::letoh<uint32_t>(data + 8);
+		n.transmissionMode = bhf::ads::letoh<uint32_t>(data + 12);
+		/* cycleTime is in 100ns units, one ms is our fastest cycle */
+		n.cycleTime = std::max(
+			std::chrono::microseconds(
+				bhf::ads::letoh<uint32_t>(data + 20) / 10),
+			std::chrono::microseconds(1000));
+		/* the client maps hNotify only after our response arrived */
+		n.due = std::chrono::steady_clock::now() + n.cycleTime;
+
+		std::vector<uint8_t> sample;
+		const auto result = ReadData(n.indexGroup, n.indexOffset,
+					     n.length, sample);
+		Append(body, result);
+		if (result) {
+			Append<uint32_t>(body, 0);
+			return body;
+		}
+		const auto hNotify = nextNotification++;
+		notifications.emplace(hNotify, std::move(n));
+		notificationsChanged.notify_all();
+		Append(body, hNotify);
+		return body;
+	}
+
+	case AoEHeader::DEL_DEVICE_NOTIFICATION: {
+		if (length < sizeof(uint32_t)) {
+			break;
+		}
+		const auto erased =
+			notifications.erase(bhf::ads::letoh<uint32_t>(data));
+		Append<uint32_t>(body, erased ? ADSERR_NOERR :
+						ADSERR_DEVICE_NOTIFYHNDINVALID);
+		return body;
+	}
+
+	case AoEHeader::READ_WRITE: {
+		if (length < 4 * sizeof(uint32_t)) {
+			break;
+		}
+		const auto writeLength = bhf::ads::letoh<uint32_t>(data + 12);
+		if (length - 4 * sizeof(uint32_t) < writeLength) {
+			break;
+		}
+		std::vector<uint8_t> out;
+		const auto result = ReadWriteData(
+			bhf::ads::letoh<uint32_t>(data),
+			bhf::ads::letoh<uint32_t>(data + 4),
+			bhf::ads::letoh<uint32_t>(data + 8), data + 16,
+			writeLength, out);
+		Append(body, result);
+		Append(body, static_cast<uint32_t>(out.size()));
+		Append(body, out.data(), out.size());
+		return body;
+	}
+
+	default:
+		errorCode = ADSERR_DEVICE_SRVNOTSUPP;
+		return body;
+	}
+	errorCode = ADSERR_DEVICE_INVALIDSIZE;
+	return body;
+}
+
+uint8_t *AdsServer::Memory(const uint32_t indexGroup,
+			   const uint32_t indexOffset, const uint32_t length,
+			   uint32_t &error)
+{
+	const auto it = memory.find(indexGroup);
+	if (it == memory.end()) {
+		error = ADSERR_DEVICE_INVALIDGRP;
+		return nullptr;
+	}
+	auto &area = it->second;
+	if (indexOffset > area.size()) {
+		error = ADSERR_DEVICE_INVALIDOFFSET;
+		return nullptr;
+	}
+	if (length > area.size() - indexOffset) {
+		error = ADSERR_DEVICE_INVALIDSIZE;
+		return nullptr;
+	}
+	error = ADSERR_NOERR;
+	return area.data() + indexOffset;
+}
+
+const AdsServer::Symbol *AdsServer::FindSymbol(const uint8_t *name,
+					       uint32_t length) const
+{
+	/* handle requests might include the terminating zero */
+	while (length && !name[length - 1]) {
+		--length;
+	}
+
+	/* like TwinCAT, we ignore the case of symbol names */
+	for (const auto &s : symbols) {
+		if ((s.name.size() == length) &&
+		    std::equal(s.name.begin(), s.name.end(), name,
+			       [](char a, uint8_t b) {
+				       return std::tolower(a) ==
+					      std::tolower(b);
+			       })) {
+			return &s;
+		}
+	}
+	return nullptr;
+}
+
+std::vector<uint8_t> AdsServer::SymbolUpload() const
+{
+	std::vector<uint8_t> out;
+	for (const auto &s : symbols) {
+		const auto entryLength = static_cast<uint32_t>(
+			sizeof(AdsSymbolEntry) + s.name.size() + 1 +
+			s.typeName.size() + 1 + s.comment.size() + 1);
+		Append(out, entryLength);
+		Append(out, s.indexGroup);
+		Append(out, s.indexOffset);
+		Append(out, s.size);
+		Append(out, s.dataType);
+		Append<uint32_t>(out, 0);
+		Append(out, static_cast<uint16_t>(s.name.size()));
+		Append(out, static_cast<uint16_t>(s.typeName.size()));
+		Append(out, static_cast<uint16_t>(s.comment.size()));
+		Append(out, s.name.c_str(), s.name.size() + 1);
+		Append(out, s.typeName.c_str(), s.typeName.size() + 1);
+		Append(out, s.comment.c_str(), s.comment.size() + 1);
+	}
+	return out;
+}
+
+static void AppendDataType(std::vector<uint8_t> &out,
+			   const AdsServer::DataType &t, const uint32_t flags)
+{
+	std::vector<uint8_t> entry;
+	Append<uint32_t>(entry, 1); // version
+	Append<uint32_t>(entry, 0); // hashValue
+	Append<uint32_t>(entry, 0); // typeHashValue
+	Append(entry, t.size);
+	Append(entry, t.offset);
+	Append(entry, t.dataType);
+	Append(entry, flags | (t.enumValues.empty() ? 0 :
+						       ADSDATATYPEFLAG_ENUMINFOS));
+	Append(entry, static_cast<uint16_t>(t.name.size()));
+	Append(entry, static_cast<uint16_t>(t.type.size()));
+	Append<uint16_t>(entry, 0); // comment
+	Append(entry, static_cast<uint16_t>(t.dimensions.size()));
+	Append(entry, static_cast<uint16_t>(t.subItems.size()));
+	Append(entry, t.name.c_str(), t.name.size() + 1);
+	Append(entry, t.type.c_str(), t.type.size() + 1);
+	Append<uint8_t>(entry, 0);
+	for (const auto &d : t.dimensions) {
+		Append(entry, d.lBound);
+		Append(entry, d.elements);
+	}
+	for (const auto &s : t.subItems) {
+		AppendDataType(entry, s, ADSDATATYPEFLAG_DATAITEM);
+	}
+	if (!t.enumValues.empty()) {
+		Append(entry, static_cast<uint16_t>(t.enumValues.size()));
+		for (const auto &e : t.enumValues) {
+			Append(entry, static_cast<uint8_t>(e.first.size()));
+			Append(entry, e.first.c_str(), e.first.size() + 1);
+			const auto value = bhf::ads::htole(e.second);
+			Append(entry, &value, t.size);
+		}
+	}
+	Append(out, static_cast<uint32_t>(sizeof(uint32_t) + entry.size()));
+	Append(out, entry.data(), entry.size());
+}
+
+std::vector<uint8_t> AdsServer::DataTypeUpload() const
+{
+	std::vector<uint8_t> out;
+	for (const auto &t : dataTypes) {
+		AppendDataType(out, t, ADSDATATYPEFLAG_DATATYPE);
+	}
+	return out;
+}
+
+uint32_t AdsServer::ReadData(const uint32_t indexGroup,
+			     const uint32_t indexOffset, const uint32_t length,
+			     std::vector<uint8_t> &out)
+{
+	switch (indexGroup) {
+	case ADSIGRP_SYM_VALBYHND: {
+		const auto it = handles.find(indexOffset);
+		if (it == handles.end()) {
+			return ADSERR_DEVICE_NOTFOUND;
+		}
+		const auto &s = symbols[it->second];
+		return ReadData(s.indexGroup, s.indexOffset,
+				std::min(length, s.size), out);
+	}
+
+	case ADSIGRP_SYM_VERSION:
+		if (length < sizeof(symbolVersion)) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		Append(out, symbolVersion);
+		return ADSERR_NOERR;
+
+	case ADSIGRP_SYM_UPLOADINFO:
+		if (length < 2 * sizeof(uint32_t)) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		Append(out, static_cast<uint32_t>(symbols.size()));
+		Append(out, static_cast<uint32_t>(SymbolUpload().size()));
+		return ADSERR_NOERR;
+
+	case ADSIGRP_SYM_UPLOADINFO2:
+		if (length < 6 * sizeof(uint32_t)) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		Append(out, static_cast<uint32_t>(symbols.size()));
+		Append(out, static_cast<uint32_t>(SymbolUpload().size()));
+		Append(out, static_cast<uint32_t>(dataTypes.size()));
+		Append(out, static_cast<uint32_t>(DataTypeUpload().size()));
+		Append<uint32_t>(out, 0);
+		Append<uint32_t>(out, 0);
+		return ADSERR_NOERR;
+
+	case ADSIGRP_SYM_DT_UPLOAD: {
+		const auto upload = DataTypeUpload();
+		if (length < upload.size()) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		Append(out, upload.data(), upload.size());
+		return ADSERR_NOERR;
+	}
+
+	case ADSIGRP_SYM_UPLOAD: {
+		const auto upload = SymbolUpload();
+		if (length < upload.size()) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		Append(out, upload.data(), upload.size());
+		return ADSERR_NOERR;
+	}
+
+	default: {
+		uint32_t error;
+		const auto src = Memory(indexGroup, indexOffset, length, error);
+		if (src) {
+			Append(out, src, length);
+		}
+		return error;
+	}
+	}
+}
+
+uint32_t AdsServer::WriteData(const uint32_t indexGroup,
+			      const uint32_t indexOffset,
+			      const uint8_t *const data, const uint32_t length)
+{
+	switch (indexGroup) {
+	case ADSIGRP_SYM_VALBYHND: {
+		const auto it = handles.find(indexOffset);
+		if (it == handles.end()) {
+			return ADSERR_DEVICE_NOTFOUND;
+		}
+		const auto &s = symbols[it->second];
+		if (length > s.size) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		return WriteData(s.indexGroup, s.indexOffset, data, length);
+	}
+
+	case ADSIGRP_SYM_RELEASEHND:
+		if (length < sizeof(uint32_t)) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		return handles.erase(bhf::ads::letoh<uint32_t>(data)) ?
+			       ADSERR_NOERR :
+			       ADSERR_DEVICE_NOTFOUND;
+
+	default: {
+		uint32_t error;
+		const auto dest =
+			Memory(indexGroup, indexOffset, length, error);
+		if (dest) {
+			memcpy(dest, data, length);
+		}
+		return error;
+	}
+	}
+}
+
+uint32_t AdsServer::ReadWriteData(const uint32_t indexGroup,
+				  const uint32_t indexOffset,
+				  const uint32_t readLength,
+				  const uint8_t *const data,
+				  const uint32_t writeLength,
+				  std::vector<uint8_t> &out)
+{
+	switch (indexGroup) {
+	case ADSIGRP_SYM_HNDBYNAME: {
+		const auto s = FindSymbol(data, writeLength);
+		if (!s) {
+			return ADSERR_DEVICE_SYMBOLNOTFOUND;
+		}
+		if (readLength < sizeof(uint32_t)) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		const auto handle = nextHandle++;
+		handles[handle] = static_cast<size_t>(s - symbols.data());
+		Append(out, handle);
+		return ADSERR_NOERR;
+	}
+
+	case ADSIGRP_SYM_VALBYNAME: {
+		const auto s = FindSymbol(data, writeLength);
+		if (!s) {
+			return ADSERR_DEVICE_SYMBOLNOTFOUND;
+		}
+		return ReadData(s->indexGroup, s->indexOffset,
+				std::min(readLength, s->size), out);
+	}
+
+	case ADSIGRP_SYM_INFOBYNAMEEX: {
+		const auto s = FindSymbol(data, writeLength);
+		if (!s) {
+			return ADSERR_DEVICE_SYMBOLNOTFOUND;
+		}
+		const Symbol *const begin = symbols.data();
+		const auto upload = SymbolUpload();
+		size_t offset = 0;
+		for (auto it = begin; it != s; ++it) {
+			offset += bhf::ads::letoh<uint32_t>(upload.data() +
+							    offset);
+		}
+		const auto entryLength =
+			bhf::ads::letoh<uint32_t>(upload.data() + offset);
+		if (readLength < entryLength) {
+			return ADSERR_DEVICE_INVALIDSIZE;
+		}
+		Append(out, upload.data() + offset, entryLength);
+		return ADSERR_NOERR;
+	}
+
+	case ADSIGRP_SUMUP_READ:
+	case ADSIGRP_SUMUP_WRITE:
+	case ADSIGRP_SUMUP_READWRITE:
+		return SumCommand(indexGroup, indexOffset, readLength, data,
+				  writeLength, out);
+
+	default: {
+		/* plain memory: write first, then read back */
+		const auto error =
+			WriteData(indexGroup, indexOffset, data, writeLength);
+		if (error) {
+			return error;
+		}
+		return ReadData(indexGroup, indexOffset, readLength, out);
+	}
+	}
+}
+
+uint32_t AdsServer::SumCommand(const uint32_t indexGroup,
+			       const uint32_t count, const uint32_t readLength,
+			       const uint8_t *const data,
+			       const uint32_t writeLength,
+			       std::vector<uint8_t> &out)
+{
+	const size_t itemSize = (ADSIGRP_SUMUP_READWRITE == indexGroup) ?
+					4 * sizeof(uint32_t) :
+					3 * sizeof(uint32_t);
+	if (writeLength < count * itemSize) {
+		return ADSERR_DEVICE_INVALIDSIZE;
+	}
+
+	std::vector<uint8_t> results;
+	std::vector<uint8_t> values;
+	auto writeData = data + count * itemSize;
+	const auto end = data + writeLength;
+	for (uint32_t i = 0; i < count; ++i) {
+		const auto item = data + i * itemSize;
+		const auto group = bhf::ads::letoh<uint32_t>(item);
+		const auto offset = bhf::ads::letoh<uint32_t>(item + 4);
+		const auto length = bhf::ads::letoh<uint32_t>(item + 8);
+
+		switch (indexGroup) {
+		case ADSIGRP_SUMUP_READ: {
+			/* every item occupies its full length, even on error */
+			std::vector<uint8_t> value;
+			Append(results, ReadData(group, offset, length, value));
+			value.resize(length);
+			Append(values, value.data(), value.size());
+			break;
+		}
+
+		case ADSIGRP_SUMUP_WRITE:
+			if (static_cast<size_t>(end - writeData) < length) {
+				return ADSERR_DEVICE_INVALIDSIZE;
+			}
+			Append(results,
+			       WriteData(group, offset, writeData, length));
+			writeData += length;
+			break;
+
+		case ADSIGRP_SUMUP_READWRITE: {
+			const auto itemWriteLength =
+				bhf::ads::letoh<uint32_t>(item + 12);
+			if (static_cast<size_t>(end - writeData) <
+			    itemWriteLength) {
+				return ADSERR_DEVICE_INVALIDSIZE;
+			}
+			std::vector<uint8_t> value;
+			Append(results,
+			       ReadWriteData(group, offset, length, writeData,
+					     itemWriteLength, value));
+			Append(results, static_cast<uint32_t>(value.size()));
+			Append(values, value.data(), value.size());
+			writeData += itemWriteLength;
+			break;
+		}
+		}
+	}
+
+	if (results.size() + values.size() > readLength) {
+		return ADSERR_DEVICE_INVALIDSIZE;
+	}
+	Append(out, results.data(), results.size());
+	Append(out, values.data(), values.size());
+	return ADSERR_NOERR;
+}
+
+void AdsServer::Notify()
+{
+	using Key = std::tuple<Connection *, AmsAddr, AmsAddr>;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopped) {
+		if (notifications.empty()) {
+			notificationsChanged.wait(lock);
+			continue;
+		}
+
+		auto next = std::chrono::steady_clock::time_point::max();
+		for (const auto &n : notifications) {
+			next = std::min(next, n.second.due);
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if (next > now) {
+			notificationsChanged.wait_until(lock, next);
+			continue;
+		}
+
+		const auto timestamp =
+			FILETIME_UNIX_EPOCH +
+			std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::system_clock::now()
+					.time_since_epoch())
+					.count() *
+				10;
+
+		/* all samples due for the same client go into one frame */
+		std::map<Key, std::pair<SharedConnection, std::vector<uint8_t> > >
+			samples;
+		std::map<Key, uint32_t> numSamples;
+		for (auto &entry : notifications) {
+			auto &n = entry.second;
+			if (n.due > now) {
+				continue;
+			}
+			n.due = std::max(n.due + n.cycleTime, now);
+
+			std::vector<uint8_t> sample;
+			if (ReadData(n.indexGroup, n.indexOffset, n.length,
+				     sample)) {
+				continue;
+			}
+			const bool onChange =
+				(ADSTRANS_SERVERONCHA == n.transmissionMode) ||
+				(ADSTRANS_SERVERONCHA2 == n.transmissionMode);
+			if (onChange && (sample == n.lastSample)) {
+				continue;
+			}
+			n.lastSample = sample;
+
+			const Key key{ n.connection.get(), n.client, n.server };
+			auto &s = samples[key];
+			s.first = n.connection;
+			Append(s.second, entry.first);
+			Append(s.second, static_cast<uint32_t>(sample.size()));
+			Append(s.second, sample.data(), sample.size());
+			++numSamples[key];
+		}
+
+		std::vector<std::pair<SharedConnection, std::vector<uint8_t> > >
+			frames;
+		for (auto &s : samples) {
+			std::vector<uint8_t> body;
+			const auto length = static_cast<uint32_t>(
+				2 * sizeof(uint32_t) + sizeof(timestamp) +
+				s.second.second.size());
+			Append(body, length);
+			Append<uint32_t>(body, 1);
+			Append<uint64_t>(body, timestamp);
+			Append(body, numSamples[s.first]);
+			Append(body, s.second.second.data(),
+			       s.second.second.size());
+			frames.emplace_back(
+				s.second.first,
+				MakeFrame(std::get<1>(s.first),
+					  std::get<2>(s.first),
+					  AoEHeader::DEVICE_NOTIFICATION,
+					  AoEHeader::AMS_REQUEST, 0, 0, body));
+		}
+
+		/* never block the request handling with a slow client */
+		lock.unlock();
+		for (const auto &f : frames) {
+			f.first->Send(f.second);
+		}
+		lock.lock();
+	}
+}
+}
+}
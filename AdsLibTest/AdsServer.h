@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AmsHeader.h"
+#include "wrap_socket.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bhf
+{
+namespace adstest
+{
+/**
+ * ADS server emulator listening on the loopback interface. It answers the
+ * requests of AdsLib from process memory, so the tests and benchmarks can
+ * run on any machine without a TwinCAT target.
+ *
+ * Supported are READ, WRITE, READ_WRITE, READ_DEVICE_INFO, READ_STATE,
+ * WRITE_CONTROL, ADD/DEL_DEVICE_NOTIFICATION with cyclic and on change
+ * DEVICE_NOTIFICATION frames, the ADSIGRP_SUMUP_* commands and a symbol
+ * table with handles, SYM_VERSION, SYM_UPLOADINFO(2), SYM_UPLOAD and
+ * SYM_DT_UPLOAD.
+ */
+struct AdsServer {
+	/** index group of the memory, which is available by default */
+	static const uint32_t MEMORY_GROUP = 0x4020;
+
+	/** entry of the datatype table, subItems are the fields of structs */
+	struct DataType {
+		std::string name;
+		std::string type;
+		uint32_t size;
+		uint32_t offset;
+		uint32_t dataType;
+		std::vector<AdsDatatypeArrayInfo> dimensions;
+		std::vector<DataType> subItems;
+		std::vector<std::pair<std::string, int64_t> > enumValues;
+	};
+
+	/**
+	 * @param[in] tcpPort to listen on, 0 to use any free port
+	 * @param[in] memorySize number of bytes in MEMORY_GROUP
+	 */
+	AdsServer(uint16_t tcpPort = 0, size_t memorySize = 64 * 1024);
+	~AdsServer();
+
+	/** @return "127.0.0.1:<port>" to be used with AddRoute() */
+	std::string Host() const;
+
+	/**
+	 * Delay every response by latency plus a uniformly distributed random
+	 * share of jitter. With jitter, responses may overtake each other.
+	 */
+	void SetLatency(std::chrono::microseconds latency,
+			std::chrono::microseconds jitter);
+
+	/** Make size bytes of an index group accessible as symbol */
+	void AddSymbol(const std::string &name, uint32_t indexGroup,
+		       uint32_t indexOffset, uint32_t size, uint32_t dataType,
+		       const std::string &typeName,
+		       const std::string &comment = {});
+
+	/** Make a type available through ADSIGRP_SYM_DT_UPLOAD */
+	void AddDataType(const DataType &type);
+
+	/** Add another index group with size bytes of memory */
+	void AddMemory(uint32_t indexGroup, size_t size);
+
+	/** Change the emulated memory, e.g. to trigger on change notifications */
+	void Write(uint32_t indexGroup, uint32_t indexOffset, const void *data,
+		   size_t length);
+
+	/** Invalidate all symbol handles like an online change would do */
+	void OnlineChange();
+
+	/** Drop all client connections like a restarting PLC would do */
+	void Restart();
+
+    private:
+	struct Connection;
+	using SharedConnection = std::shared_ptr<Connection>;
+
+	struct Symbol {
+		std::string name;
+		uint32_t indexGroup;
+		uint32_t indexOffset;
+		uint32_t size;
+		uint32_t dataType;
+		std::string typeName;
+		std::string comment;
+	};
+
+	struct DeviceNotification {
+		SharedConnection connection;
+		AmsAddr client;
+		AmsAddr server;
+		uint32_t indexGroup;
+		uint32_t indexOffset;
+		uint32_t length;
+		uint32_t transmissionMode;
+		std::chrono::microseconds cycleTime;
+		std::chrono::steady_clock::time_point due;
+		std::vector<uint8_t> lastSample;
+	};
+
+	SOCKET listener;
+	uint16_t port;
+
+	std::mutex mutex;
+	std::condition_variable notificationsChanged;
+	bool stopped;
+	std::chrono::microseconds latency;
+	std::chrono::microseconds jitter;
+	std::map<uint32_t, std::vector<uint8_t> > memory;
+	std::vector<Symbol> symbols;
+	std::vector<DataType> dataTypes;
+	std::map<uint32_t, size_t> handles;
+	uint32_t nextHandle;
+	uint8_t symbolVersion;
+	std::map<uint32_t, DeviceNotification> notifications;
+	uint32_t nextNotification;
+	uint16_t adsState;
+	uint16_t devState;
+	std::list<SharedConnection> connections;
+
+	std::thread acceptor;
+	std::thread notifier;
+
+	void Accept();
+	void Serve(SharedConnection connection);
+	void Notify();
+	void Respond(Connection &connection, const AoEHeader &request,
+		     const std::vector<uint8_t> &body, uint32_t errorCode = 0);
+
+	std::vector<uint8_t> Handle(const SharedConnection &connection,
+				    const AoEHeader &header,
+				    const uint8_t *data, size_t length,
+				    uint32_t &errorCode);
+	uint32_t ReadData(uint32_t indexGroup, uint32_t indexOffset,
+			  uint32_t length, std::vector<uint8_t> &out);
+	uint32_t WriteData(uint32_t indexGroup, uint32_t indexOffset,
+			   const uint8_t *data, uint32_t length);
+	uint32_t ReadWriteData(uint32_t indexGroup, uint32_t indexOffset,
+			       uint32_t readLength, const uint8_t *data,
+			       uint32_t writeLength, std::vector<uint8_t> &out);
+	uint32_t SumCommand(uint32_t indexGroup, uint32_t count,
+			    uint32_t readLength, const uint8_t *data,
+			    uint32_t writeLength, std::vector<uint8_t> &out);
+	uint8_t *Memory(uint32_t indexGroup, uint32_t indexOffset,
+			uint32_t length, uint32_t &error);
+	const Symbol *FindSymbol(const uint8_t *name, uint32_t length) const;
+	std::vector<uint8_t> SymbolUpload() const;
+	std::vector<uint8_t> DataTypeUpload() const;
+};
+}
+}
@@ -5,19 +5,91 @@
 
 #include <AdsLib.h>
 
+#include "AdsNotificationOOI.h"
+#include "AdsServer.h"
+#include "AdsVariable.h"
 #include "AmsRouter.h"
-
+#include "Log.h"
+#include "PendingTable.h"
+#include "RingBuffer.h"
+#include "SymbolAccess.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
+#include <new>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <vector>
 
 #include <fructose/fructose.h>
 using namespace fructose;
 
+/** heap allocations of the current thread, to check allocation free paths */
+static thread_local size_t g_Allocations = 0;
+
+void *operator new(size_t size)
+{
+	++g_Allocations;
+	if (auto p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
 static const AmsNetId serverNetId{ 192, 168, 0, 231, 1, 1 };
 static const AmsAddr server{ serverNetId, AMSPORT_R0_PLC_TC3 };
 static const AmsAddr serverBadPort{ serverNetId, 1000 };
 static const char *const remote_name = "ads-server";
-static const IpV4 ip_remote(remote_name);
+
+struct AsyncCompletions {
+	std::mutex mutex;
+	std::condition_variable cv;
+	size_t count = 0;
+	size_t failed = 0;
+	long lastError = 0;
+	uint32_t bytesRead = 0;
+
+	static void Complete(long errorCode, uint32_t bytesRead, void *pContext)
+	{
+		auto &self = *static_cast<AsyncCompletions *>(pContext);
+		std::lock_guard<std::mutex> lock(self.mutex);
+		self.failed += !!errorCode;
+		self.lastError = errorCode;
+		self.bytesRead += bytesRead;
+		++self.count;
+		self.cv.notify_all();
+	}
+
+	/**
+	 * Completions are called after the timeout of the port at the latest,
+	 * so the bound only protects the suite against a broken library.
+	 * @return false if less than expected completions arrived in time
+	 */
+	bool WaitFor(size_t expected)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return cv.wait_for(lock, std::chrono::seconds(30),
+				   [&]() { return count >= expected; });
+	}
+};
 
 static size_t g_NumNotifications = 0;
 static void NotifyCallback(const AmsAddr *pAddr,
@@ -39,6 +111,124 @@ static void NotifyCallback(const AmsAddr *pAddr,
 		<< " value: 0x" << std::hex << (int)pData[0] << '\n';
 }
 
+static std::atomic<size_t> g_NumCallbacks{ 0 };
+static void CountCallback(const AmsAddr *, const AdsNotificationHeader *,
+			  uint32_t)
+{
+	++g_NumCallbacks;
+}
+
+static std::atomic<uint32_t> g_LastNotification{ 0 };
+static void HandleCallback(const AmsAddr *,
+			   const AdsNotificationHeader *pNotification, uint32_t)
+{
+	g_LastNotification = pNotification->hNotification;
+	++g_NumCallbacks;
+}
+
+/**
+ * Minimal AMS/TCP peer on the loopback interface, used to feed frames into
+ * an AmsConnection without a real target.
+ */
+struct LoopbackPeer {
+	SOCKET listener;
+	SOCKET peer;
+	uint16_t port;
+
+	LoopbackPeer()
+		: listener(socket(AF_INET, SOCK_STREAM, 0))
+		, peer(INVALID_SOCKET)
+		, port(0)
+	{
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t addrLen = sizeof(addr);
+		if (bind(listener, reinterpret_cast<sockaddr *>(&addr),
+			 sizeof(addr)) ||
+		    listen(listener, 1) ||
+		    getsockname(listener, reinterpret_cast<sockaddr *>(&addr),
+				&addrLen)) {
+			throw std::runtime_error("loopback listener failed");
+		}
+		port = ntohs(addr.sin_port);
+	}
+
+	~LoopbackPeer()
+	{
+		if (peer != INVALID_SOCKET) {
+			closesocket(peer);
+		}
+		closesocket(listener);
+	}
+
+	std::string Host() const
+	{
+		return "127.0.0.1:" + std::to_string(port);
+	}
+
+	void Accept()
+	{
+		peer = accept(listener, nullptr, nullptr);
+	}
+
+	void Send(const uint8_t *data, size_t length)
+	{
+		while (length) {
+			const auto sent =
+				send(peer, reinterpret_cast<const char *>(data),
+				     static_cast<int>(length), 0);
+			if (sent <= 0) {
+				throw std::runtime_error("send failed");
+			}
+			data += sent;
+			length -= sent;
+		}
+	}
+
+	void Recv(uint8_t *data, size_t length)
+	{
+		while (length) {
+			const auto bytesRead = recv(
+				peer, reinterpret_cast<char *>(data),
+				static_cast<int>(length), 0);
+			if (bytesRead <= 0) {
+				throw std::runtime_error("recv failed");
+			}
+			data += bytesRead;
+			length -= bytesRead;
+		}
+	}
+
+	/** Answer a single request successfully, notifications get hNotify */
+	void Answer(uint32_t hNotify)
+	{
+		uint8_t tcpHeader[sizeof(AmsTcpHeader)];
+		Recv(tcpHeader, sizeof(tcpHeader));
+		std::vector<uint8_t> request(AmsTcpHeader{ tcpHeader }.length());
+		Recv(request.data(), request.size());
+		const AoEHeader header{ request.data() };
+
+		const bool isAdd =
+			(AoEHeader::ADD_DEVICE_NOTIFICATION == header.cmdId());
+		const uint32_t length = isAdd ? 8 : 4;
+		Frame reply(sizeof(AmsTcpHeader) + sizeof(AoEHeader) + length);
+		if (isAdd) {
+			reply.prepend(bhf::ads::htole(hNotify));
+		}
+		reply.prepend(bhf::ads::htole<uint32_t>(0));
+		reply.prepend(AoEHeader{ header.sourceAddr(),
+					 header.sourcePort(),
+					 header.targetAddr(),
+					 header.targetPort(), header.cmdId(),
+					 length, header.invokeId() });
+		reply.prepend(AmsTcpHeader{ static_cast<uint32_t>(
+			reply.size()) });
+		Send(reply.data(), reply.size());
+	}
+};
+
 void print(const AmsAddr &addr, std::ostream &out)
 {
 	out << "AmsAddr: " << std::dec << (int)addr.netId.b[0] << '.'
@@ -98,9 +288,16 @@ struct TestAmsAddr : test_base<TestAmsAddr> {
 
 struct TestAmsRouter : test_base<TestAmsRouter> {
 	std::ostream &out;
+	/* two ADS servers with different addresses, so no PLC is needed */
+	bhf::adstest::AdsServer remote;
+	bhf::adstest::AdsServer local;
+	const std::string remote_name;
+	const std::string local_name;
 
 	TestAmsRouter(std::ostream &outstream)
 		: out(outstream)
+		, remote_name(remote.Host())
+		, local_name(local.Host())
 	{
 	}
 
@@ -108,7 +305,6 @@ struct TestAmsRouter : test_base<TestAmsRouter> {
 	{
 		static const AmsNetId netId_1{ 192, 168, 0, 231, 1, 1 };
 		static const AmsNetId netId_2{ 127, 0, 0, 1, 2, 1 };
-		static const auto local_name = "127.0.0.1";
 		AmsRouter testee;
 
 		// test new Ams with new Ip
@@ -136,7 +332,6 @@ struct TestAmsRouter : test_base<TestAmsRouter> {
 	{
 		static const AmsNetId netId_1{ 192, 168, 0, 231, 1, 1 };
 		static const AmsNetId netId_2{ 127, 0, 0, 1, 2, 1 };
-		static const auto local_name = "127.0.0.1";
 		AmsRouter testee;
 
 		// add + remove -> null
@@ -155,6 +350,54 @@ struct TestAmsRouter : test_base<TestAmsRouter> {
 		fructose_assert(!!testee.GetConnection(netId_2));
 	}
 
+	void testAmsRouterReactor(const std::string &)
+	{
+		static const AmsNetId netId_1{ 192, 168, 0, 231, 1, 1 };
+		AmsRouter testee;
+#if defined(__linux__)
+		fructose_assert(0 == testee.SetReactorThreads(2));
+		fructose_assert(0 == testee.AddRoute(netId_1, remote_name));
+
+		// reactor can't be changed while connections exist
+		fructose_assert(ADSERR_DEVICE_INVALIDSTATE ==
+				testee.SetReactorThreads(0));
+
+		const auto port = testee.OpenPort();
+		const AmsAddr addr{ netId_1, AMSPORT_R0_PLC_TC3 };
+		uint16_t state[2];
+		uint32_t bytesRead;
+		AmsRequest request{ addr,
+				    port,
+				    AoEHeader::READ_STATE,
+				    sizeof(state),
+				    state,
+				    &bytesRead };
+		fructose_assert(0 == testee.AdsRequest(request));
+		fructose_assert(sizeof(state) == bytesRead);
+		testee.ClosePort(port);
+		testee.DelRoute(netId_1);
+		fructose_assert(0 == testee.SetReactorThreads(0));
+#else
+		fructose_assert(ADSERR_DEVICE_SRVNOTSUPP ==
+				testee.SetReactorThreads(2));
+#endif
+	}
+
+	void testAmsRouterNotificationThreads(const std::string &)
+	{
+		static const AmsNetId netId_1{ 192, 168, 0, 231, 1, 1 };
+		LoopbackPeer peer;
+		AmsRouter testee;
+		fructose_assert(0 == testee.SetNotificationThreads(2));
+		fructose_assert(0 == testee.AddRoute(netId_1, peer.Host()));
+
+		// pool can't be changed while connections exist
+		fructose_assert(ADSERR_DEVICE_INVALIDSTATE ==
+				testee.SetNotificationThreads(0));
+		testee.DelRoute(netId_1);
+		fructose_assert(0 == testee.SetNotificationThreads(0));
+	}
+
 	void testAmsRouterSetLocalAddress(const std::string &)
 	{
 		const AmsNetId newNetId{ 1, 2, 3, 4, 5, 6 };
@@ -288,6 +531,1237 @@ struct TestRingBuffer : test_base<TestRingBuffer> {
 	}
 };
 
+/**
+ * Callback, which blocks the dispatcher until the test opens the gate. It
+ * records the values of all samples it was invoked for.
+ */
+struct NotificationGate {
+	static std::mutex mutex;
+	static std::condition_variable cv;
+	static bool open;
+	static size_t entered;
+	static std::vector<uint32_t> seen;
+
+	static void Reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		open = false;
+		entered = 0;
+		seen.clear();
+	}
+
+	static void Callback(const AmsAddr *, const AdsNotificationHeader *pNotify,
+			     uint32_t)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		seen.push_back(bhf::ads::letoh<uint32_t>(
+			reinterpret_cast<const uint8_t *>(pNotify + 1)));
+		++entered;
+		cv.notify_all();
+		cv.wait(lock, []() { return open; });
+	}
+
+	static void WaitEntered(size_t count)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [count]() { return entered >= count; });
+	}
+
+	static void Open()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		open = true;
+		cv.notify_all();
+	}
+};
+std::mutex NotificationGate::mutex;
+std::condition_variable NotificationGate::cv;
+bool NotificationGate::open;
+size_t NotificationGate::entered;
+std::vector<uint32_t> NotificationGate::seen;
+
+struct TestNotificationDispatcher : test_base<TestNotificationDispatcher> {
+	/** 4 byte length prefix + 32 bytes frame with a single 4 byte sample */
+	static const size_t QUEUED_FRAME_SIZE = 4 + 32;
+	static const size_t NUM_FRAMES = 6;
+	std::ostream &out;
+
+	TestNotificationDispatcher(std::ostream &outstream)
+		: out(outstream)
+	{
+	}
+
+	void testDropNewest(const std::string &)
+	{
+		const auto stats = Overflow(bhf::ads::NOTIFICATION_DROP_NEWEST);
+		fructose_assert(2 == stats.droppedFrames);
+		fructose_assert(2 * 32 == stats.droppedBytes);
+		fructose_assert(3 * QUEUED_FRAME_SIZE == stats.maxQueuedBytes);
+		const std::vector<uint32_t> expected{ 0, 1, 2, 3 };
+		fructose_assert(expected == NotificationGate::seen);
+	}
+
+	void testDropOldest(const std::string &)
+	{
+		const auto stats = Overflow(bhf::ads::NOTIFICATION_DROP_OLDEST);
+		fructose_assert(2 == stats.droppedFrames);
+		fructose_assert(2 * 32 == stats.droppedBytes);
+		fructose_assert(3 * QUEUED_FRAME_SIZE == stats.maxQueuedBytes);
+		const std::vector<uint32_t> expected{ 0, 3, 4, 5 };
+		fructose_assert(expected == NotificationGate::seen);
+	}
+
+	void testGrow(const std::string &)
+	{
+		const auto stats = Overflow(bhf::ads::NOTIFICATION_GROW);
+		fructose_assert(0 == stats.droppedFrames);
+		fructose_assert(0 == stats.droppedBytes);
+		fructose_assert(5 * QUEUED_FRAME_SIZE == stats.maxQueuedBytes);
+		const std::vector<uint32_t> expected{ 0, 1, 2, 3, 4, 5 };
+		fructose_assert(expected == NotificationGate::seen);
+	}
+
+	void testBlock(const std::string &)
+	{
+		const auto stats = Overflow(bhf::ads::NOTIFICATION_BLOCK);
+		fructose_assert(0 == stats.droppedFrames);
+		fructose_assert(0 == stats.droppedBytes);
+		fructose_assert(3 * QUEUED_FRAME_SIZE >= stats.maxQueuedBytes);
+		const std::vector<uint32_t> expected{ 0, 1, 2, 3, 4, 5 };
+		fructose_assert(expected == NotificationGate::seen);
+	}
+
+    private:
+	static std::vector<uint8_t> MakeFrame(uint32_t value)
+	{
+		Frame frame(32);
+		frame.prepend(bhf::ads::htole(value));
+		frame.prepend(bhf::ads::htole<uint32_t>(sizeof(value)));
+		frame.prepend(bhf::ads::htole<uint32_t>(1)); // hNotify
+		frame.prepend(bhf::ads::htole<uint32_t>(1)); // samples
+		frame.prepend(bhf::ads::htole<uint64_t>(0)); // timestamp
+		frame.prepend(bhf::ads::htole<uint32_t>(1)); // stamps
+		frame.prepend(bhf::ads::htole<uint32_t>(28)); // length
+		return std::vector<uint8_t>(frame.data(),
+					    frame.data() + frame.size());
+	}
+
+	/**
+	 * Block the dispatcher in the callback of the first frame, then queue
+	 * the remaining frames into a buffer, which only has room for three.
+	 */
+	bhf::ads::NotificationStats
+	Overflow(const bhf::ads::NotificationOverflow overflow)
+	{
+		NotificationGate::Reset();
+		const auto testee = std::make_shared<NotificationDispatcher>(
+			[](uint32_t, uint32_t) { return 0L; });
+		testee->Configure({ 3 * QUEUED_FRAME_SIZE, overflow });
+		testee->Emplace(1, std::make_shared<Notification>(
+					   &NotificationGate::Callback, 0,
+					   sizeof(uint32_t), server, 0));
+
+		auto frame = MakeFrame(0);
+		fructose_assert(
+			testee->Enqueue(frame.data(), (uint32_t)frame.size()));
+		NotificationGate::WaitEntered(1);
+
+		std::thread producer([&]() {
+			for (uint32_t i = 1; i < NUM_FRAMES; ++i) {
+				const auto f = MakeFrame(i);
+				testee->Enqueue(f.data(), (uint32_t)f.size());
+			}
+		});
+		if (bhf::ads::NOTIFICATION_BLOCK != overflow) {
+			producer.join();
+		}
+		NotificationGate::Open();
+		if (producer.joinable()) {
+			producer.join();
+		}
+
+		const auto stats = testee->GetStats();
+		NotificationGate::WaitEntered(NUM_FRAMES -
+					      stats.droppedFrames);
+		return stats;
+	}
+};
+
+struct TestLogger : test_base<TestLogger> {
+	std::ostream &out;
+
+	TestLogger(std::ostream &outstream)
+		: out(outstream)
+	{
+	}
+
+	void testFilteredNotFormatted(const std::string &)
+	{
+		const auto logLevel = Logger::logLevel;
+		Logger::logLevel = 1;
+		int evaluated = 0;
+		LOG_VERBOSE("never formatted " << ++evaluated);
+		Logger::logLevel = logLevel;
+		fructose_assert(0 == evaluated);
+	}
+
+	void testAsync(const std::string &)
+	{
+		static const size_t numThreads = 4;
+		static const size_t numMessages = 100 * numThreads;
+		std::stringstream captured;
+		const auto cerr = std::cerr.rdbuf(captured.rdbuf());
+		Logger::SetAsync(8);
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < numThreads; ++t) {
+			threads.emplace_back([]() {
+				for (size_t i = 0; i < numMessages / numThreads;
+				     ++i) {
+					LOG_ERROR("message " << i);
+				}
+			});
+		}
+		for (auto &t : threads) {
+			t.join();
+		}
+		/* disabling waits for the writer to flush */
+		Logger::SetAsync(0);
+		std::cerr.rdbuf(cerr);
+
+		size_t written = 0;
+		size_t dropped = 0;
+		std::string line;
+		while (std::getline(captured, line)) {
+			const auto pos = line.find(" log messages dropped");
+			if (pos != std::string::npos) {
+				const auto start = line.rfind(' ', pos - 1) + 1;
+				dropped += std::stoul(line.substr(start));
+			} else if (line.find("Error: message ") !=
+				   std::string::npos) {
+				++written;
+			}
+		}
+		fructose_assert(written >= 1);
+		fructose_assert(numMessages == written + dropped);
+	}
+
+	void testStream(const std::string &)
+	{
+		std::stringstream captured;
+		const auto cerr = std::cerr.rdbuf(captured.rdbuf());
+		LOG_ERROR(std::hex << 255 << ' '
+			  << std::string(2 * LogStream::CAPACITY, 'x'));
+		LOG_ERROR(255);
+		std::cerr.rdbuf(cerr);
+
+		/* long messages are truncated, formatting doesn't stick */
+		std::string line;
+		fructose_assert(!!std::getline(captured, line));
+		const auto first = line.find("Error: ff x");
+		fructose_assert(std::string::npos != first);
+		fructose_assert(line.size() - first - 7 == LogStream::CAPACITY);
+		fructose_assert(!!std::getline(captured, line));
+		fructose_assert(std::string::npos != line.find("Error: 255"));
+	}
+};
+
+struct TestFrame : test_base<TestFrame> {
+	std::ostream &out;
+
+	TestFrame(std::ostream &outstream)
+		: out(outstream)
+	{
+	}
+
+	void testHeadroom(const std::string &)
+	{
+		static const uint8_t payload[] = { 1, 2, 3, 4 };
+		Frame frame(sizeof(payload), payload);
+		const auto buffer = frame.rawData();
+		for (size_t i = 0; i < Frame::HEADROOM / sizeof(uint32_t); ++i) {
+			frame.prepend(bhf::ads::htole<uint32_t>(0));
+		}
+		fructose_assert(buffer == frame.rawData());
+		fructose_assert(sizeof(payload) + Frame::HEADROOM == frame.size());
+
+		/* growing beyond the headroom keeps the content */
+		std::vector<uint8_t> large(frame.capacity());
+		frame.prepend(large.data(), large.size());
+		fructose_assert(buffer != frame.rawData());
+		fructose_assert(large.size() + sizeof(payload) + Frame::HEADROOM ==
+				frame.size());
+		fructose_assert(0 == memcmp(payload,
+					    frame.data() + frame.size() -
+						    sizeof(payload),
+					    sizeof(payload)));
+	}
+
+	void testPool(const std::string &)
+	{
+		const uint8_t *buffer;
+		{
+			Frame frame(100);
+			buffer = frame.rawData();
+		}
+		Frame sameClass(120);
+		fructose_assert(buffer == sameClass.rawData());
+		Frame other(100);
+		fructose_assert(buffer != other.rawData());
+
+		/* large frames are not cached, but work as before */
+		Frame large(1024 * 1024);
+		fructose_assert(1024 * 1024 + Frame::HEADROOM <= large.capacity());
+	}
+};
+
+struct TestPendingTable : test_base<TestPendingTable> {
+	std::ostream &out;
+
+	TestPendingTable(std::ostream &outstream)
+		: out(outstream)
+	{
+	}
+
+	void testInsertErase(const std::string &)
+	{
+		int values[3];
+		PendingTable<int> testee{ 8 };
+		fructose_assert(testee.Insert(1, &values[0]));
+		fructose_assert(!testee.Insert(1, &values[1]));
+		/* same slot, as the capacity grows only beyond half load */
+		fructose_assert(testee.Insert(9, &values[1]));
+		fructose_assert(testee.Insert(17, &values[2]));
+		fructose_assert(3 == testee.Size());
+		fructose_assert(&values[1] == testee.Find(9));
+		fructose_assert(nullptr == testee.Find(2));
+
+		/* later entries of the probe sequence stay reachable */
+		testee.Erase(1);
+		fructose_assert(nullptr == testee.Find(1));
+		fructose_assert(&values[1] == testee.Find(9));
+		fructose_assert(&values[2] == testee.Find(17));
+		testee.Erase(17);
+		fructose_assert(&values[1] == testee.Find(9));
+		fructose_assert(1 == testee.Size());
+
+		/* probe sequences wrap around the end of the table */
+		fructose_assert(testee.Insert(7, &values[0]));
+		fructose_assert(testee.Insert(15, &values[2]));
+		testee.Erase(7);
+		fructose_assert(&values[2] == testee.Find(15));
+		fructose_assert(&values[1] == testee.Find(9));
+	}
+
+	void testGrow(const std::string &)
+	{
+		std::vector<int> values(1000);
+		PendingTable<int> testee{ 2 };
+		for (uint32_t i = 0; i < values.size(); ++i) {
+			fructose_loop_assert(i, testee.Insert(0xFFFFFF00 + i * 7,
+							      &values[i]));
+		}
+		for (uint32_t i = 0; i < values.size(); i += 2) {
+			testee.Erase(0xFFFFFF00 + i * 7);
+		}
+		for (uint32_t i = 0; i < values.size(); ++i) {
+			const auto expected = (i % 2) ? &values[i] : nullptr;
+			fructose_loop_assert(i, expected ==
+							testee.Find(0xFFFFFF00 +
+								    i * 7));
+		}
+
+		/* slots are reused once the table is large enough */
+		const auto before = g_Allocations;
+		for (uint32_t i = 0; i < values.size(); i += 2) {
+			testee.Insert(0xFFFFFF00 + i * 7, &values[i]);
+			testee.Erase(0xFFFFFF00 + i * 7);
+		}
+		const auto allocations = g_Allocations - before;
+		fructose_assert(0 == allocations);
+	}
+};
+
+struct TestLatencyHistogram : test_base<TestLatencyHistogram> {
+	std::ostream &out;
+
+	TestLatencyHistogram(std::ostream &outstream)
+		: out(outstream)
+	{
+	}
+
+	void testPercentiles(const std::string &)
+	{
+		bhf::ads::LatencyHistogram histogram;
+		fructose_assert(0 == histogram.Percentile(99));
+		for (uint64_t i = 1; i <= 1000; ++i) {
+			histogram.Record(i);
+		}
+		fructose_assert(1000 == histogram.count);
+		fructose_assert(1 == histogram.min);
+		fructose_assert(1000 == histogram.max);
+		fructose_assert(500500 == histogram.sum);
+
+		/* buckets keep a relative precision of 1/16 */
+		const auto p50 = histogram.Percentile(50);
+		fructose_assert(p50 >= 500 && p50 <= 500 + 500 / 16);
+		const auto p99 = histogram.Percentile(99);
+		fructose_assert(p99 >= 990 && p99 <= 990 + 990 / 16);
+		fructose_assert(1000 == histogram.Percentile(100));
+		fructose_assert(11 == histogram.Percentile(1));
+
+		bhf::ads::LatencyHistogram other;
+		other.Record(1ULL << 40);
+		histogram.Add(other);
+		fructose_assert(1001 == histogram.count);
+		fructose_assert((1ULL << 40) == histogram.Percentile(100));
+	}
+};
+
+struct TestAdsServer : test_base<TestAdsServer> {
+	static const uint16_t PORT = AMSPORT_R0_PLC_TC3;
+	std::ostream &out;
+	bhf::adstest::AdsServer emulator;
+	const AmsNetId netId;
+
+	TestAdsServer(std::ostream &outstream)
+		: out(outstream)
+		, netId{ 127, 0, 0, 1, 2, 1 }
+	{
+		emulator.AddSymbol("MAIN.counter", bhf::adstest::AdsServer::MEMORY_GROUP,
+				   16, sizeof(uint32_t), 0x13, "UDINT");
+		emulator.AddSymbol("MAIN.flag", bhf::adstest::AdsServer::MEMORY_GROUP,
+				   20, sizeof(uint8_t), 0x21, "BOOL",
+				   "some comment");
+	}
+
+	void testReadWrite(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		const uint32_t value = 0xDEADBEEF;
+		fructose_assert(0 == device.WriteReqEx(0x4020, 8, sizeof(value),
+						       &value));
+		uint32_t buffer = 0;
+		uint32_t bytesRead = 0;
+		fructose_assert(0 == device.ReadReqEx2(0x4020, 8, sizeof(buffer),
+						       &buffer, &bytesRead));
+		fructose_assert(sizeof(buffer) == bytesRead);
+		fructose_assert(value == buffer);
+
+		fructose_assert(ADSERR_DEVICE_INVALIDGRP ==
+				device.ReadReqEx2(0x4025, 0, sizeof(buffer),
+						  &buffer, &bytesRead));
+		fructose_assert(ADSERR_DEVICE_INVALIDSIZE ==
+				device.ReadReqEx2(0x4020, 64 * 1024 - 2,
+						  sizeof(buffer), &buffer,
+						  &bytesRead));
+
+		const auto info = device.GetDeviceInfo();
+		fructose_assert(0 == strcmp("Plc30 App", info.name));
+		fructose_assert(ADSSTATE_RUN == device.GetState().ads);
+	}
+
+	void testRequestAllocations(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		uint32_t value = 0;
+		uint32_t bytesRead = 0;
+		/* the first requests fill the frame pool of this thread */
+		for (int i = 0; i < 8; ++i) {
+			device.ReadReqEx2(0x4020, 8, sizeof(value), &value,
+					  &bytesRead);
+		}
+
+		/* fructose allocates for every assertion, so they come last */
+		const auto before = g_Allocations;
+		long errors = 0;
+		for (int i = 0; i < 100; ++i) {
+			errors |= device.WriteReqEx(0x4020, 8, sizeof(value),
+						    &value);
+			errors |= device.ReadReqEx2(0x4020, 8, sizeof(value),
+						    &value, &bytesRead);
+		}
+		const auto allocations = g_Allocations - before;
+		fructose_assert(0 == errors);
+		fructose_assert(0 == allocations);
+	}
+
+	void testSumCommands(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		uint32_t values[] = { 1, 2, 3 };
+		std::vector<AdsDevice::WriteItem> writes;
+		for (uint32_t i = 0; i < 3; ++i) {
+			writes.push_back({ 0x4020, 32 + 4 * i, 4, &values[i] });
+		}
+		writes.push_back({ 0x4025, 0, 4, &values[0] });
+		fructose_assert(0 == device.SumWrite(writes));
+		fructose_assert(0 == writes[2].error);
+		fructose_assert(ADSERR_DEVICE_INVALIDGRP == writes[3].error);
+
+		uint32_t buffer[3] = {};
+		std::vector<AdsDevice::ReadItem> reads;
+		for (uint32_t i = 0; i < 3; ++i) {
+			reads.push_back({ 0x4020, 32 + 4 * i, 4, &buffer[i] });
+		}
+		fructose_assert(0 == device.SumRead(reads));
+		for (uint32_t i = 0; i < 3; ++i) {
+			fructose_loop_assert(i, 0 == reads[i].error);
+			fructose_loop_assert(i, values[i] == buffer[i]);
+		}
+	}
+
+	void testSymbols(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		{
+			AdsVariable<uint32_t> counter{ device, "main.COUNTER" };
+			counter = 0x12345678;
+			fructose_assert(0x12345678 == counter);
+		}
+		const auto handles = device.GetHandles({ "MAIN.counter",
+							 "MAIN.flag" });
+		fructose_assert(2 == handles.size());
+		fructose_assert(*handles[0] != *handles[1]);
+		fructose_assert_exception(device.GetHandle("MAIN.missing"),
+					  AdsException);
+
+		/* batches outlive the AdsDevice object, they were moved from */
+		{
+			std::unique_ptr<AdsDevice> original{ new AdsDevice{
+				emulator.Host(), netId, PORT } };
+			auto batch = original->GetHandles({ "MAIN.counter" });
+			const auto handle = *batch[0];
+			AdsDevice moved{ std::move(*original) };
+			original.reset();
+			batch.clear();
+			uint32_t value = 0;
+			fructose_assert(ADSERR_DEVICE_NOTFOUND ==
+					moved.ReadReqEx2(ADSIGRP_SYM_VALBYHND,
+							 handle, sizeof(value),
+							 &value, nullptr));
+		}
+
+		const bhf::ads::SymbolAccess symbols{ emulator.Host(), netId,
+						      PORT };
+		const auto entries = symbols.FetchSymbolEntries();
+		fructose_assert(2 == entries.size());
+		const auto &flag = entries.at("MAIN.flag");
+		fructose_assert(20 == flag.header.iOffs);
+		fructose_assert("BOOL" == flag.typeName);
+		fructose_assert("some comment" == flag.comment);
+
+		const auto index = symbols.FetchSymbolIndex();
+		fructose_assert(2 == index.size());
+		const auto pos = index.Find("MAIN.flag");
+		fructose_assert(bhf::ads::SymbolIndex::npos != pos);
+		fructose_assert(20 == index[pos].header.iOffs);
+		fructose_assert(index[pos].typeName == "BOOL");
+		fructose_assert(bhf::ads::SymbolIndex::npos ==
+				index.Find("MAIN.fla"));
+		const auto all = index.Prefix("MAIN.");
+		fructose_assert(0 == all.first && 2 == all.second);
+		fructose_assert(index[0].name == "MAIN.counter");
+		const auto none = index.Prefix("MAIN.x");
+		fructose_assert(none.first == none.second);
+
+		/* a corrupt upload is rejected */
+		const auto corrupt =
+			std::make_shared<std::vector<uint8_t> >(64, 0xff);
+		fructose_assert_exception(
+			bhf::ads::SymbolIndex(
+				std::shared_ptr<const uint8_t>(corrupt,
+							       corrupt->data()),
+				corrupt->size(), 1),
+			AdsException);
+	}
+
+	void testSymbolCache(const std::string &)
+	{
+		static const char *const cacheFile = "AdsLibTest.symbols";
+		std::remove(cacheFile);
+		const auto reads = []() {
+			bhf::ads::MetricsSnapshot snapshot;
+			bhf::ads::GetMetrics(snapshot);
+			return snapshot.requests[AoEHeader::READ];
+		};
+
+		/* version and upload info, followed by the upload */
+		auto before = reads();
+		{
+			const bhf::ads::SymbolAccess symbols{
+				emulator.Host(), netId, PORT, cacheFile
+			};
+			fructose_assert(2 == symbols.FetchSymbolEntries().size());
+		}
+		fructose_assert(3 == reads() - before);
+
+		/* the next process skips the upload */
+		before = reads();
+		{
+			const bhf::ads::SymbolAccess symbols{
+				emulator.Host(), netId, PORT, cacheFile
+			};
+			const auto entries = symbols.FetchSymbolEntries();
+			fructose_assert(2 == reads() - before);
+			fructose_assert(2 == entries.size());
+			fructose_assert("some comment" ==
+					entries.at("MAIN.flag").comment);
+
+			/* an online change invalidates the cache */
+			emulator.AddSymbol("MAIN.cached",
+					   bhf::adstest::AdsServer::MEMORY_GROUP,
+					   24, sizeof(uint32_t), 0x13, "UDINT");
+			before = reads();
+			fructose_assert(3 == symbols.FetchSymbolEntries().size());
+			fructose_assert(3 == reads() - before);
+		}
+
+		/* a corrupt cache is uploaded again and replaced */
+		{
+			std::fstream file(cacheFile, std::ios::binary |
+							     std::ios::in |
+							     std::ios::out);
+			/* the checksum notices, what the index can't */
+			file.seekp(-3, std::ios::end);
+			file.put('X');
+		}
+		const auto fetch = [&](uint16_t port) {
+			const auto start = reads();
+			const bhf::ads::SymbolAccess symbols{
+				emulator.Host(), netId, port, cacheFile
+			};
+			const auto entries = symbols.FetchSymbolEntries();
+			fructose_assert(3 == entries.size());
+			return reads() - start;
+		};
+		fructose_assert(3 == fetch(PORT));
+		fructose_assert(2 == fetch(PORT));
+
+		/* the same symbols of another PLC aren't taken from the cache */
+		fructose_assert(3 == fetch(PORT + 1));
+		fructose_assert(3 == fetch(PORT));
+		std::remove(cacheFile);
+	}
+
+	void testDataTypes(const std::string &)
+	{
+		using Type = bhf::adstest::AdsServer::DataType;
+		const auto scalar = [](const char *name, const char *type,
+				       uint32_t size, uint32_t offset,
+				       uint32_t dataType) {
+			return Type{ name, type, size, offset, dataType, {}, {}, {} };
+		};
+		emulator.AddDataType(scalar("INT", "", 2, 0, ADST_INT16));
+		emulator.AddDataType(scalar("REAL", "", 4, 0, ADST_REAL32));
+		emulator.AddDataType(scalar("BOOL", "", 1, 0, ADST_BIT));
+		auto mode = scalar("E_Mode", "INT", 2, 0, ADST_INT16);
+		mode.enumValues = { { "Idle", 0 }, { "Run", 1 }, { "Error", -1 } };
+		emulator.AddDataType(mode);
+		auto target =
+			scalar("ARRAY [1..3] OF INT", "INT", 6, 0, ADST_INT16);
+		target.dimensions = { { 1, 3 } };
+		emulator.AddDataType(target);
+		auto axis = scalar("ST_Axis", "", 16, 0, ADST_BIGTYPE);
+		axis.subItems = {
+			scalar("bEnable", "BOOL", 1, 0, ADST_BIT),
+			scalar("eMode", "E_Mode", 2, 2, ADST_INT16),
+			scalar("fPos", "REAL", 4, 4, ADST_REAL32),
+			scalar("aTarget", "ARRAY [1..3] OF INT", 6, 8, ADST_INT16),
+		};
+		emulator.AddDataType(axis);
+		emulator.AddSymbol("MAIN.stAxis",
+				   bhf::adstest::AdsServer::MEMORY_GROUP, 200, 16,
+				   ADST_BIGTYPE, "ST_Axis");
+
+		std::vector<uint8_t> value(16);
+		value[0] = 1;
+		const auto error = bhf::ads::htole<int16_t>(-1);
+		memcpy(value.data() + 2, &error, sizeof(error));
+		const auto pos = bhf::ads::htole(1.5f);
+		memcpy(value.data() + 4, &pos, sizeof(pos));
+		const auto first = bhf::ads::htole<int16_t>(-7);
+		memcpy(value.data() + 8, &first, sizeof(first));
+		const auto last = bhf::ads::htole<int16_t>(9);
+		memcpy(value.data() + 12, &last, sizeof(last));
+		emulator.Write(bhf::adstest::AdsServer::MEMORY_GROUP, 200,
+			       value.data(), value.size());
+
+		const bhf::ads::SymbolAccess symbols{ emulator.Host(), netId,
+						      PORT };
+		const auto types = symbols.FetchDataTypes();
+		fructose_assert(6 == types.size());
+		const auto stAxis = types.Find("ST_Axis");
+		fructose_assert(!!stAxis);
+		fructose_assert(4 == stAxis->fields.size());
+		fructose_assert(types.Find("E_Mode") == stAxis->fields[1].base);
+		fructose_assert(3 == types.Find("E_Mode")->enumValues.size());
+
+		/* a single read decodes into all fields */
+		std::map<std::string, std::string> fields;
+		types.Decode(*stAxis, value.data(), value.size(),
+			     [&](const std::string &path,
+				 const bhf::ads::DataType &type,
+				 const uint8_t *data) {
+				     fields[path] =
+					     bhf::ads::DataTypeTable::Format(
+						     type, data);
+			     });
+		fructose_assert(6 == fields.size());
+		fructose_assert("TRUE" == fields[".bEnable"]);
+		fructose_assert("Error" == fields[".eMode"]);
+		fructose_assert("1.5" == fields[".fPos"]);
+		fructose_assert("-7" == fields[".aTarget[1]"]);
+		fructose_assert("0" == fields[".aTarget[2]"]);
+		fructose_assert("9" == fields[".aTarget[3]"]);
+
+		std::ostringstream os;
+		fructose_assert(0 == symbols.Read("MAIN.stAxis", os));
+		fructose_assert(std::string::npos !=
+				os.str().find("MAIN.stAxis.eMode: Error\n"));
+
+		/* sizes, which don't fit the ADST type, aren't decoded */
+		bhf::ads::DataType corrupt{};
+		corrupt.adsType = ADST_REAL64;
+		corrupt.size = 4;
+		fructose_assert_exception(
+			bhf::ads::DataTypeTable::Format(corrupt, value.data()),
+			AdsException);
+		corrupt.adsType = ADST_BIGTYPE;
+		corrupt.size = 0;
+		corrupt.enumValues = { { "Zero", 0 } };
+		fructose_assert_exception(
+			bhf::ads::DataTypeTable::Format(corrupt, value.data()),
+			AdsException);
+	}
+
+	void testGenerateHeader(const std::string &)
+	{
+		/* uses the types of testDataTypes() */
+		using Type = bhf::adstest::AdsServer::DataType;
+		const auto boolean = [](const char *name, uint32_t offset) {
+			return Type{ name, "BOOL", 1, offset, ADST_BIT,
+				     {}, {}, {} };
+		};
+		auto names =
+			Type{ "ST_Names", "", 3, 0, ADST_BIGTYPE, {}, {}, {} };
+		names.subItems = { boolean("b.c", 0), boolean("b_c", 1),
+				   boolean("class", 2) };
+		emulator.AddDataType(names);
+		const auto group = bhf::adstest::AdsServer::MEMORY_GROUP;
+		emulator.AddSymbol("MAIN.stNames", group, 216, 3, ADST_BIGTYPE,
+				   "ST_Names");
+		emulator.AddSymbol("MAIN.stX.y", group, 220, 4, ADST_UINT32,
+				   "UDINT");
+		emulator.AddSymbol("MAIN.stX_y", group, 224, 4, ADST_UINT32,
+				   "UDINT");
+		/* a builtin type of the wrong width can't describe the symbol */
+		emulator.AddSymbol("MAIN.stWide", group, 228, 4, ADST_INT16,
+				   "INT");
+		/* enums take their underlying type from size and signedness */
+		emulator.AddDataType(Type{ "E_Flags", "T_Flags", 4, 0,
+					   ADST_BIGTYPE, {}, {},
+					   { { "High", 0x80000000 } } });
+		emulator.AddSymbol("MAIN.stFlags", group, 232, 4, ADST_BIGTYPE,
+				   "E_Flags");
+		emulator.AddDataType(Type{ "E_Wide", "ULINT", 8, 0,
+					   ADST_UINT64, {}, {},
+					   { { "Max", -1 } } });
+		emulator.AddSymbol("MAIN.stWideEnum", group, 240, 8,
+				   ADST_UINT64, "E_Wide");
+		emulator.AddDataType(Type{ "E_Odd", "T_Odd", 3, 0,
+					   ADST_BIGTYPE, {}, {},
+					   { { "One", 1 } } });
+		emulator.AddSymbol("MAIN.stOdd", group, 248, 3, ADST_BIGTYPE,
+				   "E_Odd");
+
+		const bhf::ads::SymbolAccess symbols{ emulator.Host(), netId,
+						      PORT };
+		std::ostringstream os;
+		fructose_assert(0 == symbols.GenerateHeader(os, "MAIN.st"));
+		const auto header = os.str();
+		const auto contains = [&header](const std::string &s) {
+			return std::string::npos != header.find(s);
+		};
+		fructose_assert(contains("enum class E_Mode : int16_t {\n"
+					 "\tIdle = 0,\n"
+					 "\tRun = 1,\n"
+					 "\tError = -1,\n"));
+		fructose_assert(contains("struct ST_Axis {\n"
+					 "\tuint8_t bEnable; // BOOL\n"
+					 "\tuint8_t reserved0[1];\n"
+					 "\tE_Mode eMode; // E_Mode\n"
+					 "\tfloat fPos; // REAL\n"
+					 "\tint16_t aTarget[3]; // ARRAY [1..3] OF INT\n"
+					 "\tuint8_t reserved1[2];\n"
+					 "};\n"
+					 "static_assert(sizeof(ST_Axis) == 16"));
+		fructose_assert(contains("constexpr Symbol<ST_Axis> MAIN_stAxis"
+					 "{ 0x4020, 0xc8 };\n"));
+		fructose_assert(!contains("MAIN_counter"));
+		fructose_assert(contains("struct ST_Names {\n"
+					 "\tuint8_t b_c; // BOOL\n"
+					 "\tuint8_t b_c_2; // BOOL\n"
+					 "\tuint8_t class_; // BOOL\n"));
+		fructose_assert(contains("Symbol<uint32_t> MAIN_stX_y{"));
+		fructose_assert(contains("Symbol<uint32_t> MAIN_stX_y_2{"));
+		fructose_assert(contains("using MAIN_stWide_t = uint8_t[4];"));
+		fructose_assert(contains("enum class E_Flags : uint32_t {\n"
+					 "\tHigh = 2147483648u,\n"));
+		fructose_assert(contains("enum class E_Wide : uint64_t {\n"
+					 "\tMax = 18446744073709551615u,\n"));
+		fructose_assert(contains("using MAIN_stOdd_t = uint8_t[3];"));
+		fructose_assert(!contains("enum class E_Odd"));
+
+		/* every declaration has its own name within its scope */
+		const std::regex declaration{
+			"^(?:struct|enum class|using|constexpr Symbol<\\w+>) "
+			"(\\w+)"
+		};
+		const std::regex member{ "^\t(?:[\\w:]+ )?(\\w+)(?: =|\\[|;)" };
+		std::set<std::string> global;
+		std::set<std::string> members;
+		std::istringstream lines{ header };
+		for (std::string line; std::getline(lines, line);) {
+			std::smatch match;
+			if (std::regex_search(line, match, declaration)) {
+				fructose_assert(global.insert(match[1]).second);
+				members.clear();
+			} else if (std::regex_search(line, match, member)) {
+				fructose_assert(members.insert(match[1]).second);
+			}
+		}
+		fructose_assert(global.count("MAIN_stNames"));
+	}
+
+	void testSymbolHandleCache(const std::string &)
+	{
+		const auto metrics = []() {
+			bhf::ads::MetricsSnapshot snapshot;
+			bhf::ads::GetMetrics(snapshot);
+			return snapshot;
+		};
+		const auto lookups = [&metrics]() {
+			return metrics().requests[AoEHeader::READ_WRITE];
+		};
+		AdsDevice device{ emulator.Host(), netId, PORT };
+
+		/* only the first variable resolves the handle */
+		auto before = lookups();
+		for (uint32_t i = 0; i < 3; ++i) {
+			const AdsVariable<uint32_t> counter{ device,
+							     "MAIN.counter" };
+			counter = i;
+			fructose_loop_assert(i, i == counter);
+		}
+		const AdsNotificationAttrib attrib = { sizeof(uint32_t),
+						       ADSTRANS_SERVERONCHA, 0,
+						       { 0 } };
+		{
+			const AdsNotification notification{
+				device, "MAIN.counter", attrib, &CountCallback, 0
+			};
+		}
+		fructose_assert(1 == lookups() - before);
+
+		/* the version notification flushes the cache */
+		const AdsVariable<uint32_t> counter{ device, "MAIN.counter" };
+		const auto samples = metrics().notificationSamples;
+		emulator.OnlineChange();
+		const auto deadline = std::chrono::steady_clock::now() +
+				      std::chrono::seconds(5);
+		while ((samples == metrics().notificationSamples) &&
+		       (std::chrono::steady_clock::now() < deadline)) {
+			std::this_thread::sleep_for(
+				std::chrono::milliseconds(1));
+		}
+		fructose_assert(samples != metrics().notificationSamples);
+		before = lookups();
+		const auto writes = metrics().requests[AoEHeader::WRITE];
+		counter = 42;
+		fructose_assert(42 == counter);
+		fructose_assert(1 == lookups() - before);
+		/* the release of the stale handle, which wasn't used anymore */
+		const auto allWrites = metrics().requests[AoEHeader::WRITE];
+		fructose_assert(2 == allWrites - writes);
+
+		/* handles rejected before the notification arrived, too */
+		emulator.OnlineChange();
+		fructose_assert(42 == counter);
+		fructose_assert_exception(
+			(AdsVariable<uint32_t>{ device, "MAIN.missing" }),
+			AdsException);
+	}
+
+	void testNotifications(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		const AdsNotificationAttrib attrib = { sizeof(uint32_t),
+						       ADSTRANS_SERVERONCHA, 0,
+						       { 100000 } };
+		g_NumCallbacks = 0;
+		const auto notification = device.GetHandle(
+			0x4020, 48, attrib, &CountCallback, 0);
+		WaitForCallbacks(1);
+
+		/* no change, no notification */
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		fructose_assert(1 == g_NumCallbacks);
+
+		const uint32_t value = 42;
+		emulator.Write(0x4020, 48, &value, sizeof(value));
+		WaitForCallbacks(2);
+	}
+
+	void testLatency(const std::string &)
+	{
+		static const auto latency = std::chrono::milliseconds(5);
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		emulator.SetLatency(latency, std::chrono::microseconds(0));
+
+		uint32_t buffer = 0;
+		uint32_t bytesRead = 0;
+		const auto start = std::chrono::steady_clock::now();
+		fructose_assert(0 == device.ReadReqEx2(0x4020, 0, sizeof(buffer),
+						       &buffer, &bytesRead));
+		fructose_assert(latency <= std::chrono::steady_clock::now() - start);
+		emulator.SetLatency(std::chrono::microseconds(0),
+				    std::chrono::microseconds(0));
+	}
+
+	void testLatencyTracing(const std::string &)
+	{
+		static const auto latency = std::chrono::milliseconds(2);
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		emulator.SetLatency(latency, std::chrono::microseconds(0));
+		fructose_assert(0 == bhf::ads::SetLatencyTracing(true));
+
+		uint32_t buffer = 0;
+		uint32_t bytesRead = 0;
+		for (int i = 0; i < 10; ++i) {
+			fructose_loop_assert(
+				i, 0 == device.ReadReqEx2(0x4020, 0,
+							  sizeof(buffer),
+							  &buffer, &bytesRead));
+		}
+		device.ReadReqAsync(0x4020, 0, sizeof(buffer), &buffer).get();
+		fructose_assert(0 == bhf::ads::SetLatencyTracing(false));
+		device.ReadReqEx2(0x4020, 0, sizeof(buffer), &buffer, &bytesRead);
+		emulator.SetLatency(std::chrono::microseconds(0),
+				    std::chrono::microseconds(0));
+
+		std::vector<bhf::ads::RequestLatency> stats;
+		fructose_assert(0 == bhf::ads::GetLatencyStats(stats));
+		const auto it = std::find_if(
+			stats.begin(), stats.end(),
+			[](const bhf::ads::RequestLatency &l) {
+				return (PORT == l.target.port) &&
+				       (AoEHeader::READ == l.cmdId);
+			});
+		fructose_assert(it != stats.end());
+		fructose_assert(11 == it->send.count);
+		fructose_assert(11 == it->response.count);
+		fructose_assert(11 == it->total.count);
+		fructose_assert(2000 <= it->response.min);
+		fructose_assert(it->response.Percentile(50) <=
+				it->total.Percentile(50));
+		fructose_assert(it->total.max == it->total.Percentile(100));
+	}
+
+	void testMetrics(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		bhf::ads::MetricsSnapshot before;
+		fructose_assert(0 == bhf::ads::GetMetrics(before));
+
+		uint32_t buffer = 0;
+		uint32_t bytesRead = 0;
+		for (int i = 0; i < 3; ++i) {
+			device.ReadReqEx2(0x4020, 0, sizeof(buffer), &buffer,
+					  &bytesRead);
+		}
+		const AdsNotificationAttrib attrib = { sizeof(uint32_t),
+						       ADSTRANS_SERVERCYCLE, 0,
+						       { 2000000 } };
+		g_NumCallbacks = 0;
+		{
+			const auto notification = device.GetHandle(
+				0x4020, 0, attrib, &CountCallback, 0);
+			WaitForCallbacks(1);
+		}
+
+		bhf::ads::MetricsSnapshot after;
+		fructose_assert(0 == bhf::ads::GetMetrics(after));
+		fructose_assert(3 == after.requests[AoEHeader::READ] -
+					     before.requests[AoEHeader::READ]);
+		fructose_assert(3 == after.responses[AoEHeader::READ] -
+					     before.responses[AoEHeader::READ]);
+		static const auto ADD = AoEHeader::ADD_DEVICE_NOTIFICATION;
+		fructose_assert(1 == after.requests[ADD] - before.requests[ADD]);
+		fructose_assert(after.bytesSent > before.bytesSent);
+		fructose_assert(after.bytesReceived > before.bytesReceived);
+		fructose_assert(after.notificationFrames >
+				before.notificationFrames);
+		fructose_assert(after.notificationSamples >
+				before.notificationSamples);
+		fructose_assert(after.maxQueuedNotificationBytes > 0);
+
+		const auto text = after.ToPrometheus();
+		const auto reads = "ads_requests_total{command=\"READ\"} " +
+				   std::to_string(after.requests[AoEHeader::READ]);
+		fructose_assert(std::string::npos !=
+				text.find("# TYPE ads_requests_total counter\n"));
+		fructose_assert(std::string::npos != text.find(reads + '\n'));
+	}
+
+	void testStripedRoute(const std::string &)
+	{
+		static const AmsNetId striped{ 127, 0, 0, 1, 2, 3 };
+		{
+			AmsRouter testee;
+			fructose_assert(0 == testee.AddRoute(striped,
+							     emulator.Host(), 3));
+			const auto first = testee.GetConnection(striped);
+			fructose_assert(first == testee.SelectConnection(striped));
+
+			/* a request in flight moves the next to another connection */
+			emulator.SetLatency(std::chrono::milliseconds(100),
+					    std::chrono::microseconds(0));
+			uint32_t buffer = 0;
+			std::unique_ptr<AmsRequest> request{ new AmsRequest{
+				{ striped, PORT }, testee.OpenPort(),
+				AoEHeader::READ, sizeof(buffer), &buffer, nullptr,
+				sizeof(AoERequestHeader) } };
+			request->frame.prepend(AoERequestHeader{
+				0x4020u, 0u, uint32_t{ sizeof(buffer) } });
+			std::promise<uint32_t> done;
+			fructose_assert(0 == testee.AdsRequestAsync(
+						     std::move(request),
+						     [&done](uint32_t error, uint32_t) {
+							     done.set_value(error);
+						     }));
+			const auto second = testee.SelectConnection(striped);
+			fructose_assert(!!second);
+			fructose_assert(first != second);
+			fructose_assert(0 == done.get_future().get());
+			emulator.SetLatency(std::chrono::microseconds(0),
+					    std::chrono::microseconds(0));
+			testee.DelRoute(striped);
+			fructose_assert(!testee.SelectConnection(striped));
+		}
+
+		/* notifications still reach their callback */
+		fructose_assert(0 == bhf::ads::AddLocalRoute(
+					     striped, emulator.Host().c_str(), 3));
+		{
+			AdsDevice device{ emulator.Host(), striped, PORT };
+			uint32_t buffer = 0;
+			uint32_t bytesRead = 0;
+			for (int i = 0; i < 10; ++i) {
+				fructose_loop_assert(
+					i, 0 == device.ReadReqEx2(0x4020, 0,
+								  sizeof(buffer),
+								  &buffer,
+								  &bytesRead));
+			}
+			const AdsNotificationAttrib attrib = {
+				sizeof(uint32_t), ADSTRANS_SERVERONCHA, 0, { 100000 }
+			};
+			g_NumCallbacks = 0;
+			const auto notification = device.GetHandle(
+				0x4020, 52, attrib, &CountCallback, 0);
+			WaitForCallbacks(1);
+		}
+		bhf::ads::DelLocalRoute(striped);
+	}
+
+	void testAsyncTimeout(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		device.SetTimeout(100);
+		emulator.SetLatency(std::chrono::milliseconds(500),
+				    std::chrono::microseconds(0));
+		bhf::ads::MetricsSnapshot before;
+		bhf::ads::GetMetrics(before);
+
+		const AmsAddr addr{ netId, PORT };
+		uint32_t buffer = 0xDEADBEEF;
+		AsyncCompletions completions;
+		fructose_assert(0 == AdsReadReqAsync(device.GetLocalPort(),
+						     &addr, 0x4020, 0,
+						     sizeof(buffer), &buffer,
+						     AsyncCompletions::Complete,
+						     &completions));
+		fructose_assert(completions.WaitFor(1));
+		fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT ==
+				completions.lastError);
+
+		/* the late response neither completes again nor fills buffer */
+		std::this_thread::sleep_for(std::chrono::milliseconds(600));
+		fructose_assert(1 == completions.count);
+		fructose_assert(0xDEADBEEF == buffer);
+		bhf::ads::MetricsSnapshot after;
+		bhf::ads::GetMetrics(after);
+		fructose_assert(1 == after.timeouts - before.timeouts);
+
+		emulator.SetLatency(std::chrono::microseconds(0),
+				    std::chrono::microseconds(0));
+		fructose_assert(0 == device.ReadReqEx2(0x4020, 0, sizeof(buffer),
+						       &buffer, nullptr));
+	}
+
+	void testTrafficClasses(const std::string &)
+	{
+		AdsDevice realtime{ emulator.Host(), netId, PORT };
+		AdsDevice interactive{ emulator.Host(), netId, PORT };
+		AdsDevice bulk{ emulator.Host(), netId, PORT };
+		realtime.SetTrafficClass(bhf::ads::TRAFFIC_REALTIME);
+		bulk.SetTrafficClass(bhf::ads::TRAFFIC_BULK);
+		fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+				bhf::ads::SetTrafficClass(
+					bulk.GetLocalPort(),
+					bhf::ads::TrafficClass(
+						bhf::ads::NUM_TRAFFIC_CLASSES)));
+
+		/* all lanes share one connection and are drained completely */
+		std::atomic<size_t> failed{ 0 };
+		const auto run = [&failed](const AdsDevice &device,
+					   const size_t length) {
+			std::vector<uint8_t> buffer(length);
+			uint32_t bytesRead = 0;
+			for (int i = 0; i < 200; ++i) {
+				if (device.ReadReqEx2(0x4020, 0, buffer.size(),
+						      buffer.data(), &bytesRead) ||
+				    (bytesRead != buffer.size())) {
+					++failed;
+				}
+			}
+		};
+		std::thread t1{ run, std::cref(realtime), 4 };
+		std::thread t2{ run, std::cref(interactive), 64 };
+		std::thread t3{ run, std::cref(bulk), 32 * 1024 };
+		t1.join();
+		t2.join();
+		t3.join();
+		fructose_assert(0 == failed);
+	}
+
+	void testReconnect(const std::string &)
+	{
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		bhf::ads::MetricsSnapshot before;
+		fructose_assert(0 == bhf::ads::GetMetrics(before));
+
+		const AdsNotificationAttrib attrib = { sizeof(uint32_t),
+						       ADSTRANS_SERVERCYCLE, 0,
+						       { 100000 } };
+		g_NumCallbacks = 0;
+		{
+			const auto notification = device.GetHandle(
+				0x4020, 0, attrib, &HandleCallback, 0);
+			for (int i = 0; (i < 1000) && !g_NumCallbacks; ++i) {
+				std::this_thread::sleep_for(
+					std::chrono::milliseconds(1));
+			}
+			fructose_assert(*notification == g_LastNotification);
+
+			/* the same handle keeps delivering after the restart */
+			emulator.Restart();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			g_NumCallbacks = 0;
+			g_LastNotification = 0;
+			for (int i = 0; (i < 5000) && (g_NumCallbacks < 3); ++i) {
+				std::this_thread::sleep_for(
+					std::chrono::milliseconds(1));
+			}
+			fructose_assert(3 <= g_NumCallbacks);
+			fructose_assert(*notification == g_LastNotification);
+
+			uint32_t buffer = 0;
+			uint32_t bytesRead = 0;
+			fructose_assert(0 == device.ReadReqEx2(0x4020, 0,
+							       sizeof(buffer),
+							       &buffer,
+							       &bytesRead));
+		}
+
+		/* deleting the handle stops the resubscribed notification */
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		const size_t callbacks = g_NumCallbacks;
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		fructose_assert(callbacks == g_NumCallbacks);
+
+		bhf::ads::MetricsSnapshot after;
+		fructose_assert(0 == bhf::ads::GetMetrics(after));
+		fructose_assert(after.reconnects > before.reconnects);
+	}
+
+	void testRestartDuringRead(const std::string &)
+	{
+		static const uint32_t group = 0x4030;
+		static const size_t size = 16 * 1024 * 1024;
+		emulator.AddMemory(group, size);
+		const std::vector<uint8_t> pattern(size, 0xA5);
+		emulator.Write(group, 0, pattern.data(), pattern.size());
+
+		/* the reader owns everything it uses, in case it never returns */
+		struct Transfer {
+			std::vector<uint8_t> buffer;
+			std::promise<long> done;
+		};
+		const auto transfer = std::make_shared<Transfer>();
+		transfer->buffer.resize(size);
+		const volatile uint8_t *const first = &transfer->buffer.front();
+		const volatile uint8_t *const last = &transfer->buffer.back();
+		auto done = transfer->done.get_future();
+		AdsDevice device{ emulator.Host(), netId, PORT };
+		const auto host = emulator.Host();
+		const auto target = netId;
+		std::thread([transfer, host, target]() {
+			AdsDevice reader{ host, target, PORT };
+			uint32_t bytesRead = 0;
+			transfer->done.set_value(reader.ReadReqEx2(
+				group, 0, transfer->buffer.size(),
+				transfer->buffer.data(), &bytesRead));
+		}).detach();
+
+		/* restart, while the response is copied into the buffer */
+		const auto deadline =
+			std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (!*first && (std::chrono::steady_clock::now() < deadline)) {
+		}
+		emulator.Restart();
+
+		/* the rest of the frame may have arrived before the close */
+		const auto status = done.wait_for(std::chrono::seconds(10));
+		fructose_assert(std::future_status::ready == status);
+		if (std::future_status::ready == status) {
+			const auto error = done.get();
+			fructose_assert((GLOBALERR_MISSING_ROUTE == error) ||
+					(!error && (0xA5 == *last)));
+		}
+
+		/* the connection is usable again */
+		uint32_t buffer = 0;
+		uint32_t bytesRead = 0;
+		long error = -1;
+		for (int i = 0; (i < 100) && error; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			error = device.ReadReqEx2(0x4020, 0, sizeof(buffer),
+						  &buffer, &bytesRead);
+		}
+		fructose_assert(0 == error);
+	}
+
+    private:
+	void WaitForCallbacks(const size_t count)
+	{
+		for (int i = 0; (i < 1000) && (g_NumCallbacks < count); ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		fructose_assert(count == g_NumCallbacks);
+	}
+};
+
 struct TestAds : test_base<TestAds> {
 	static const int NUM_TEST_LOOPS = 10;
 	std::ostream &out;
@@ -453,6 +1927,67 @@ struct TestAds : test_base<TestAds> {
 		fructose_assert(0 == AdsPortCloseEx(port));
 	}
 
+	void testAdsReadReqAsync(const std::string &)
+	{
+		const long port = AdsPortOpenEx();
+		fructose_assert(0 != port);
+
+		const uint32_t outBuffer = 0;
+		AsyncCompletions written;
+		const auto writeError = AdsWriteReqAsync(
+			port, &server, 0x4020, 0, sizeof(outBuffer), &outBuffer,
+			AsyncCompletions::Complete, &written);
+		fructose_assert(0 == writeError);
+		if (!writeError) {
+			fructose_assert(written.WaitFor(1));
+			fructose_assert(0 == written.failed);
+		}
+
+		uint32_t buffer[NUM_TEST_LOOPS];
+		AsyncCompletions completions;
+		size_t submitted = 0;
+		for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+			buffer[i] = 0xDEADBEEF;
+			const auto error = AdsReadReqAsync(
+				port, &server, 0x4020, 0, sizeof(buffer[i]),
+				&buffer[i], AsyncCompletions::Complete,
+				&completions);
+			fructose_loop_assert(i, 0 == error);
+			submitted += !error;
+		}
+		fructose_assert(completions.WaitFor(submitted));
+		fructose_assert(0 == completions.failed);
+		fructose_assert(NUM_TEST_LOOPS * sizeof(buffer[0]) ==
+				completions.bytesRead);
+		for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+			fructose_loop_assert(i, 0 == buffer[i]);
+		}
+
+		// completion is never called if the request wasn't sent
+		fructose_assert(ADSERR_CLIENT_NOAMSADDR ==
+				AdsReadReqAsync(port, nullptr, 0x4020, 0,
+						sizeof(buffer[0]), &buffer[0],
+						AsyncCompletions::Complete,
+						&completions));
+		fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+				AdsReadReqAsync(port, &server, 0x4020, 0,
+						sizeof(buffer[0]), &buffer[0],
+						nullptr, &completions));
+		fructose_assert(submitted == completions.count);
+
+		// ADS errors are reported through the completion
+		AsyncCompletions unsupported;
+		const auto readError = AdsReadReqAsync(
+			port, &server, 0x4025, 0x10000, sizeof(buffer[0]),
+			&buffer[0], AsyncCompletions::Complete, &unsupported);
+		fructose_assert(0 == readError);
+		if (!readError) {
+			fructose_assert(unsupported.WaitFor(1));
+			fructose_assert(1 == unsupported.failed);
+		}
+		fructose_assert(0 == AdsPortCloseEx(port));
+	}
+
 	void testAdsReadDeviceInfoReqEx(const std::string &)
 	{
 		static const char NAME[] = "Plc30 App";
@@ -970,22 +2505,193 @@ struct TestAds : test_base<TestAds> {
 	}
 };
 
+/**
+ * Microbenchmarks of the receive path, which run against a loopback peer or
+ * feed the dispatcher directly, so they don't need a PLC.
+ */
+struct TestLocalPerformance : test_base<TestLocalPerformance> {
+	std::ostream &out;
+
+	TestLocalPerformance(std::ostream &outstream)
+		: out(outstream)
+	{
+	}
+
+	void testRecvFramesPerSecond(const std::string &testname)
+	{
+		static const size_t framesPerBurst = 16384;
+		static const size_t numBursts = 32;
+		static const uint32_t hNotify = 0x1234;
+		static const AmsNetId netId{ 127, 0, 0, 1, 1, 1 };
+		const AmsAddr addr{ netId, AMSPORT_R0_PLC_TC3 };
+		LoopbackPeer peer;
+		AmsRouter testee;
+
+		fructose_assert(0 == testee.AddRoute(netId, peer.Host()));
+		peer.Accept();
+		const auto port = testee.OpenPort();
+
+		uint8_t buffer[sizeof(hNotify)];
+		AmsRequest request{ addr,
+				    port,
+				    AoEHeader::ADD_DEVICE_NOTIFICATION,
+				    sizeof(buffer),
+				    buffer,
+				    nullptr,
+				    sizeof(AdsAddDeviceNotificationRequest) };
+		request.frame.prepend(AdsAddDeviceNotificationRequest{
+			0x4020, 0, sizeof(uint32_t), ADSTRANS_SERVERCYCLE, 0,
+			0 });
+		auto answer = std::thread(&LoopbackPeer::Answer, &peer, hNotify);
+		uint32_t handle = 0;
+		fructose_assert(0 ==
+				testee.AddNotification(
+					request, &handle,
+					std::make_shared<Notification>(
+						&CountCallback, 0,
+						sizeof(uint32_t), addr, port)));
+		answer.join();
+		fructose_assert(hNotify == handle);
+
+		/* one stamp with a single sample of 4 bytes per frame */
+		Frame notification(64);
+		notification.prepend(bhf::ads::htole<uint32_t>(0xDEADBEEF));
+		notification.prepend(bhf::ads::htole<uint32_t>(sizeof(uint32_t)));
+		notification.prepend(bhf::ads::htole(hNotify));
+		notification.prepend(bhf::ads::htole<uint32_t>(1));
+		notification.prepend(bhf::ads::htole<uint64_t>(0));
+		notification.prepend(bhf::ads::htole<uint32_t>(1));
+		notification.prepend(bhf::ads::htole<uint32_t>(
+			static_cast<uint32_t>(notification.size())));
+		notification.prepend(AoEHeader{
+			AmsNetId{}, port, netId, AMSPORT_R0_PLC_TC3,
+			AoEHeader::DEVICE_NOTIFICATION,
+			static_cast<uint32_t>(notification.size()), 0 });
+		notification.prepend(AmsTcpHeader{
+			static_cast<uint32_t>(notification.size()) });
+
+		std::vector<uint8_t> burst;
+		for (size_t i = 0; i < framesPerBurst; ++i) {
+			burst.insert(burst.end(), notification.data(),
+				     notification.data() + notification.size());
+		}
+
+		/* wait for each burst, to never overrun the notification ring */
+		g_NumCallbacks = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 1; i <= numBursts; ++i) {
+			peer.Send(burst.data(), burst.size());
+			while (g_NumCallbacks < i * framesPerBurst) {
+				std::this_thread::yield();
+			}
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		const auto tmms =
+			std::chrono::duration_cast<std::chrono::milliseconds>(
+				end - start)
+				.count();
+		out << testname << ' '
+		    << 1000 * g_NumCallbacks / std::max<int64_t>(1, tmms)
+		    << " frames/s (" << g_NumCallbacks << '/' << tmms << "ms)\n";
+
+		answer = std::thread(&LoopbackPeer::Answer, &peer, 0);
+		fructose_assert(0 == testee.DelNotification(port, &addr, handle));
+		answer.join();
+		testee.ClosePort(port);
+		testee.DelRoute(netId);
+	}
+
+	void testDispatcherSamplesPerSecond(const std::string &testname)
+	{
+		static const uint32_t samplesPerFrame = 16;
+		static const size_t numFrames = 16384;
+
+		for (size_t numThreads = 0; numThreads <= 2; numThreads += 2) {
+			for (uint32_t size = 4; size <= 4096; size *= 16) {
+				DispatchSamples(testname, numThreads, size,
+						samplesPerFrame, numFrames);
+			}
+		}
+	}
+
+    private:
+	void DispatchSamples(const std::string &testname, size_t numThreads,
+			     uint32_t size, uint32_t samplesPerFrame,
+			     size_t numFrames)
+	{
+		static const uint32_t hNotify = 1;
+		std::unique_ptr<NotificationPool> pool;
+		if (numThreads) {
+			pool.reset(new NotificationPool{ numThreads });
+		}
+		const auto testee = std::make_shared<NotificationDispatcher>(
+			[](uint32_t, uint32_t) { return 0L; }, pool.get());
+		testee->Configure({ DEFAULT_NOTIFICATION_CAPACITY,
+				    bhf::ads::NOTIFICATION_BLOCK });
+		testee->Emplace(hNotify,
+				std::make_shared<Notification>(
+					&CountCallback, 0, size, AmsAddr{}, 0));
+
+		/* one stamp with samplesPerFrame samples */
+		const std::vector<uint8_t> sample(size, 0xA5);
+		Frame frame(12 + samplesPerFrame * (8 + size));
+		for (uint32_t i = 0; i < samplesPerFrame; ++i) {
+			frame.prepend(sample.data(), sample.size());
+			frame.prepend(bhf::ads::htole(size));
+			frame.prepend(bhf::ads::htole(hNotify));
+		}
+		frame.prepend(bhf::ads::htole(samplesPerFrame));
+		frame.prepend(bhf::ads::htole<uint64_t>(0));
+		frame.prepend(bhf::ads::htole<uint32_t>(1));
+		frame.prepend(bhf::ads::htole<uint32_t>(
+			static_cast<uint32_t>(frame.size())));
+		const auto length = static_cast<uint32_t>(frame.size());
+
+		g_NumCallbacks = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < numFrames; ++i) {
+			testee->Enqueue(frame.data(), length);
+		}
+		while (g_NumCallbacks < numFrames * samplesPerFrame) {
+			std::this_thread::yield();
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		const auto tmms =
+			std::chrono::duration_cast<std::chrono::milliseconds>(
+				end - start)
+				.count();
+		out << testname << " threads " << std::dec << numThreads
+		    << " size " << size << ": "
+		    << 1000 * g_NumCallbacks / std::max<int64_t>(1, tmms)
+		    << " samples/s (" << g_NumCallbacks << '/' << tmms
+		    << "ms)\n";
+	}
+};
+
 struct TestAdsPerformance : test_base<TestAdsPerformance> {
 	std::ostream &out;
+	const AmsAddr target;
+	/** only set, if target is emulated */
+	bhf::adstest::AdsServer *const emulator;
 	bool runEndurance;
 
-	TestAdsPerformance(std::ostream &outstream)
+	TestAdsPerformance(std::ostream &outstream,
+			   const AmsAddr &targetAddr = server,
+			   const std::string &host = remote_name,
+			   bhf::adstest::AdsServer *const __emulator = nullptr)
 		: out(outstream)
+		, target(targetAddr)
+		, emulator(__emulator)
 		, runEndurance(false)
 	{
-		bhf::ads::AddLocalRoute(serverNetId, remote_name);
+		bhf::ads::AddLocalRoute(target.netId, host.c_str());
 	}
 #ifdef WIN32
 	~TestAdsPerformance()
 	{
 		// WORKAROUND: On Win7-64 AdsConnection::~AdsConnection() is triggered by the destruction
 		//             of the static AdsRouter object and hangs in receive.join()
-		bhf::ads::DelLocalRoute(serverNetId);
+		bhf::ads::DelLocalRoute(target.netId);
 	}
 #endif
 
@@ -1035,6 +2741,53 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
 		out << testname << " took " << tmms << "ms\n";
 	}
 
+	void testPipelineDepth(const std::string &testname)
+	{
+		/*
+		 * Without latency only the loopback CPU cost is measured, so
+		 * the emulator answers after a fixed delay like a real PLC.
+		 */
+		const size_t numRequests = emulator ? 1024 : 8192;
+		if (emulator) {
+			emulator->SetLatency(std::chrono::milliseconds(1),
+					     std::chrono::microseconds(0));
+		}
+		const long port = AdsPortOpenEx();
+		fructose_assert(0 != port);
+
+		std::map<size_t, int64_t> rates;
+		for (size_t depth = 1; depth <= 64; depth *= 2) {
+			std::vector<std::thread> threads(depth);
+			const auto start =
+				std::chrono::high_resolution_clock::now();
+			for (auto &t : threads) {
+				t = std::thread(&TestAdsPerformance::ReadOnPort,
+						this, port, numRequests / depth);
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			const auto end =
+				std::chrono::high_resolution_clock::now();
+			const auto tmms = std::chrono::duration_cast<
+						  std::chrono::milliseconds>(
+						  end - start)
+						  .count();
+			rates[depth] =
+				1000 * numRequests / std::max<int64_t>(1, tmms);
+			out << testname << " depth " << std::dec << depth << ": "
+			    << rates[depth] << " requests/s (" << numRequests
+			    << '/' << tmms << "ms)\n";
+		}
+		fructose_assert(0 == AdsPortCloseEx(port));
+		if (emulator) {
+			emulator->SetLatency(std::chrono::microseconds(0),
+					     std::chrono::microseconds(0));
+			/* requests in flight hide the latency */
+			fructose_assert(rates[16] > 4 * rates[1]);
+		}
+	}
+
 	void testEndurance(const std::string &testname)
 	{
 		static const size_t numNotifications = 1024;
@@ -1057,7 +2810,7 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
 		const auto start = std::chrono::high_resolution_clock::now();
 		for (hUser = 0; hUser < numNotifications; ++hUser) {
 			fructose_assert_eq(0, AdsSyncAddDeviceNotificationReqEx(
-						      port, &server, 0x4020, 4,
+						      port, &target, 0x4020, 4,
 						      &attrib, &NotifyCallback,
 						      hUser,
 						      &notification[hUser]));
@@ -1069,7 +2822,7 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
 
 		for (hUser = 0; hUser < numNotifications; ++hUser) {
 			fructose_assert_eq(0, AdsSyncDelDeviceNotificationReqEx(
-						      port, &server,
+						      port, &target,
 						      notification[hUser]));
 		}
 		const auto end = std::chrono::high_resolution_clock::now();
@@ -1101,7 +2854,7 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
 
 		for (hUser = 0; hUser < numNotifications; ++hUser) {
 			fructose_assert_eq(0, AdsSyncAddDeviceNotificationReqEx(
-						      port, &server, 0x4020, 4,
+						      port, &target, 0x4020, 4,
 						      &attrib, &NotifyCallback,
 						      hUser,
 						      &notification[hUser]));
@@ -1109,12 +2862,25 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
 		std::this_thread::sleep_for(std::chrono::seconds(5));
 		for (hUser = 0; hUser < numNotifications; ++hUser) {
 			fructose_assert_eq(0, AdsSyncDelDeviceNotificationReqEx(
-						      port, &server,
+						      port, &target,
 						      notification[hUser]));
 		}
 		fructose_assert(0 == AdsPortCloseEx(port));
 	}
 
+	void ReadOnPort(const long port, const size_t numLoops)
+	{
+		uint32_t bytesRead;
+		uint32_t buffer;
+		for (size_t i = 0; i < numLoops; ++i) {
+			fructose_loop_assert(
+				i, 0 == AdsSyncReadReqEx2(port, &target, 0x4020,
+							  0, sizeof(buffer),
+							  &buffer, &bytesRead));
+			fructose_loop_assert(i, sizeof(buffer) == bytesRead);
+		}
+	}
+
 	void Read(const size_t numLoops)
 	{
 		const long port = AdsPortOpenEx();
@@ -1126,7 +2892,7 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
 			for (size_t i = 0; i < numLoops; ++i) {
 				fructose_loop_assert(
 					i, 0 == AdsSyncReadReqEx2(
-							port, &server, 0x4020,
+							port, &target, 0x4020,
 							0, sizeof(buffer),
 							&buffer, &bytesRead));
 				fructose_loop_assert(i, sizeof(buffer) ==
@@ -1138,9 +2904,12 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
 	}
 };
 
-int main()
+int main(int argc, char *argv[])
 {
 	int failedTests = 0;
+
+	/* --emulator [<latency us> [<jitter us>]] runs without a PLC */
+	const bool emulated = (argc > 1) && !strcmp("--emulator", argv[1]);
 #if 0
     std::ostream nowhere(0);
     std::ostream& errorstream = nowhere;
@@ -1159,6 +2928,10 @@ int main()
 	routerTest.add_test("testAmsRouterDelRoute",
 			    &TestAmsRouter::testAmsRouterDelRoute);
 	//    routerTest.add_test("testConcurrentRoutes", &TestAmsRouter::testConcurrentRoutes);
+	routerTest.add_test("testAmsRouterReactor",
+			    &TestAmsRouter::testAmsRouterReactor);
+	routerTest.add_test("testAmsRouterNotificationThreads",
+			    &TestAmsRouter::testAmsRouterNotificationThreads);
 	routerTest.add_test("testAmsRouterSetLocalAddress",
 			    &TestAmsRouter::testAmsRouterSetLocalAddress);
 	failedTests += routerTest.run();
@@ -1173,12 +2946,113 @@ int main()
 	ringBufferTest.add_test("testWriteChunk",
 				&TestRingBuffer::testWriteChunk);
 	failedTests += ringBufferTest.run();
+
+	TestNotificationDispatcher dispatcherTest(errorstream);
+	dispatcherTest.add_test("testDropNewest",
+				&TestNotificationDispatcher::testDropNewest);
+	dispatcherTest.add_test("testDropOldest",
+				&TestNotificationDispatcher::testDropOldest);
+	dispatcherTest.add_test("testGrow", &TestNotificationDispatcher::testGrow);
+	dispatcherTest.add_test("testBlock",
+				&TestNotificationDispatcher::testBlock);
+	failedTests += dispatcherTest.run();
+
+	TestLogger loggerTest(errorstream);
+	loggerTest.add_test("testFilteredNotFormatted",
+			    &TestLogger::testFilteredNotFormatted);
+	loggerTest.add_test("testAsync", &TestLogger::testAsync);
+	loggerTest.add_test("testStream", &TestLogger::testStream);
+	failedTests += loggerTest.run();
+
+	TestFrame frameTest(errorstream);
+	frameTest.add_test("testHeadroom", &TestFrame::testHeadroom);
+	frameTest.add_test("testPool", &TestFrame::testPool);
+	failedTests += frameTest.run();
+
+	TestPendingTable pendingTableTest(errorstream);
+	pendingTableTest.add_test("testInsertErase",
+				  &TestPendingTable::testInsertErase);
+	pendingTableTest.add_test("testGrow", &TestPendingTable::testGrow);
+	failedTests += pendingTableTest.run();
+
+	TestLatencyHistogram histogramTest(errorstream);
+	histogramTest.add_test("testPercentiles",
+			       &TestLatencyHistogram::testPercentiles);
+	failedTests += histogramTest.run();
+
+	TestLocalPerformance localPerformance(errorstream);
+	localPerformance.add_test(
+		"testRecvFramesPerSecond",
+		&TestLocalPerformance::testRecvFramesPerSecond);
+	localPerformance.add_test(
+		"testDispatcherSamplesPerSecond",
+		&TestLocalPerformance::testDispatcherSamplesPerSecond);
+	failedTests += localPerformance.run();
+
+	TestAdsServer adsServerTest(errorstream);
+	adsServerTest.add_test("testReadWrite", &TestAdsServer::testReadWrite);
+	adsServerTest.add_test("testRequestAllocations",
+			       &TestAdsServer::testRequestAllocations);
+	adsServerTest.add_test("testSumCommands",
+			       &TestAdsServer::testSumCommands);
+	adsServerTest.add_test("testSymbols", &TestAdsServer::testSymbols);
+	adsServerTest.add_test("testNotifications",
+			       &TestAdsServer::testNotifications);
+	adsServerTest.add_test("testLatency", &TestAdsServer::testLatency);
+	adsServerTest.add_test("testLatencyTracing",
+			       &TestAdsServer::testLatencyTracing);
+	adsServerTest.add_test("testMetrics", &TestAdsServer::testMetrics);
+	adsServerTest.add_test("testStripedRoute",
+			       &TestAdsServer::testStripedRoute);
+	adsServerTest.add_test("testAsyncTimeout",
+			       &TestAdsServer::testAsyncTimeout);
+	adsServerTest.add_test("testTrafficClasses",
+			       &TestAdsServer::testTrafficClasses);
+	adsServerTest.add_test("testReconnect", &TestAdsServer::testReconnect);
+	adsServerTest.add_test("testRestartDuringRead",
+			       &TestAdsServer::testRestartDuringRead);
+	adsServerTest.add_test("testSymbolCache",
+			       &TestAdsServer::testSymbolCache);
+	adsServerTest.add_test("testDataTypes",
+			       &TestAdsServer::testDataTypes);
+	adsServerTest.add_test("testGenerateHeader",
+			       &TestAdsServer::testGenerateHeader);
+	adsServerTest.add_test("testSymbolHandleCache",
+			       &TestAdsServer::testSymbolHandleCache);
+	failedTests += adsServerTest.run();
 #endif
+	if (emulated) {
+		static const AmsNetId emulatorNetId{ 127, 0, 0, 1, 2, 2 };
+		bhf::adstest::AdsServer emulator;
+		emulator.SetLatency(
+			std::chrono::microseconds(
+				(argc > 2) ? std::strtoul(argv[2], nullptr, 10) :
+					     0),
+			std::chrono::microseconds(
+				(argc > 3) ? std::strtoul(argv[3], nullptr, 10) :
+					     0));
+
+		TestAdsPerformance performance(
+			errorstream, { emulatorNetId, AMSPORT_R0_PLC_TC3 },
+			emulator.Host(), &emulator);
+		performance.add_test("testManyNotifications",
+				     &TestAdsPerformance::testManyNotifications);
+		performance.add_test(
+			"testParallelReadAndWrite",
+			&TestAdsPerformance::testParallelReadAndWrite);
+		performance.add_test("testPipelineDepth",
+				     &TestAdsPerformance::testPipelineDepth);
+		failedTests += performance.run();
+		bhf::ads::DelLocalRoute(emulatorNetId);
+		return failedTests;
+	}
+
 	TestAds adsTest(errorstream);
 	adsTest.add_test("testAdsPortOpenEx", &TestAds::testAdsPortOpenEx);
 	adsTest.add_test("testAdsReadReqEx2", &TestAds::testAdsReadReqEx2);
 	adsTest.add_test("testAdsReadReqEx2LargeBuffer",
 			 &TestAds::testAdsReadReqEx2LargeBuffer);
+	adsTest.add_test("testAdsReadReqAsync", &TestAds::testAdsReadReqAsync);
 	adsTest.add_test("testAdsReadDeviceInfoReqEx",
 			 &TestAds::testAdsReadDeviceInfoReqEx);
 	adsTest.add_test("testAdsReadStateReqEx",
@@ -1197,6 +3071,8 @@ int main()
 			     &TestAdsPerformance::testManyNotifications);
 	performance.add_test("testParallelReadAndWrite",
 			     &TestAdsPerformance::testParallelReadAndWrite);
+	performance.add_test("testPipelineDepth",
+			     &TestAdsPerformance::testPipelineDepth);
 	//	performance.add_test("testEndurance", &TestAdsPerformance::testEndurance);
 	failedTests += performance.run();
 
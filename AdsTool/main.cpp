@@ -19,8 +19,11 @@
 #include "bhf/StringToInteger.h"
 #include "bhf/WindowsQuirks.h"
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 #include <set>
 #include <thread>
 
@@ -72,6 +75,40 @@ COMMANDS:
 		Use 'guest' account to add a route with a selfdefined name
 		$ adstool 192.168.0.231 addroute --addr=192.168.0.1 --netid=192.168.0.1.1.1 --password=1 --username=guest --routename=Testroute
 
+	bench [CMD_OPTIONS...] <read|write|readwrite|notification> <IndexGroup> <IndexOffset>
+		Measure latency and throughput of the link to the device. Requests of
+		the selected workload are sent as fast as possible and the number of
+		requests per second, errors, timeouts and the min/p50/p99/p99.9/max
+		latency is printed to stdout. For the notification workload the
+		intervals between the samples are reported instead. The exit code is
+		non zero, if any request failed or timed out. CMD_OPTIONS are:
+		--threads=<n> number of AmsPorts used in parallel (optional, defaults to 1)
+		--depth=<n> number of requests in flight per thread (optional, defaults to 1)
+		--size=<bytes> of each request or notification sample (optional, defaults to 4)
+		--duration=<seconds> to run the benchmark (optional, defaults to 10)
+		--timeout=<ms> to wait for each response (optional, defaults to the AmsPort timeout)
+		--cycle=<us> of the notifications (optional, defaults to 1000)
+	examples:
+		Read 4 bytes from TC3 PLC index group 0x4020 offset 0 for 10 seconds:
+		$ adstool 5.24.37.144.1.1 bench read "0x4020" "0"
+		requests: 48231
+		errors: 0
+		timeouts: 0
+		duration: 10.0002 s
+		throughput: 4823 requests/s
+		bandwidth: 18.84 KiB/s
+		latency min: 154 us
+		latency p50: 198 us
+		latency p99: 411 us
+		latency p99.9: 1037 us
+		latency max: 2841 us
+
+		Write 1 KiB with 4 threads and 16 requests in flight each for one minute:
+		$ adstool 5.24.37.144.1.1 bench --threads=4 --depth=16 --size=1024 --duration=60 write "0x4020" "0"
+
+		Subscribe 100 notifications of 8 bytes with a cycle time of 1 ms:
+		$ adstool 5.24.37.144.1.1 bench --threads=100 --size=8 --cycle=1000 notification "0x4020" "0"
+
 	dc-diag <activate|deactivate|clear|print>
 		Manage the state of the Distributed Clock Diagnosis for a given EtherCAT Master.
 		To get the NetId of the EtherCAT Master use the 'ecat list-masters' command.
@@ -184,6 +221,20 @@ COMMANDS:
 		Write PLC symbol information into an out.json file
 		$ adstool 5.24.37.144.1.1 plc show-symbols > out.json
 
+	plc generate-header [<prefix>]
+		Print a C++ header with packed structs and constexpr index
+		group/offset descriptors for all symbols starting with <prefix>.
+		Sizes are checked with static_assert, so a whole structure can be
+		read with a single ReadReqEx2().
+	examples:
+		$ adstool 5.24.37.144.1.1 plc generate-header MAIN. > plc.h
+
+	plc --symbol-cache=<file> <plc command>
+		Keep the symbol upload in <file> and reuse it, as long as the
+		symbol version of the PLC doesn't change.
+	examples:
+		$ adstool 5.24.37.144.1.1 plc --symbol-cache=/tmp/plc.symbols read-symbol "MAIN.nNum1"
+
 	raw [--read=<number_of_bytes>] <IndexGroup> <IndexOffset>
 		This command gives low level access to:
 		- AdsSyncReadReqEx2()
@@ -343,6 +394,237 @@ int RunAddRoute(const std::string &remote, bhf::Commandline &args)
 		params.Get<std::string>("--password"));
 }
 
+struct BenchResult {
+	std::vector<uint32_t> latencies;
+	uint64_t errors = 0;
+	uint64_t timeouts = 0;
+	long status = 0;
+
+	void Add(long error, uint32_t latency)
+	{
+		if (ADSERR_CLIENT_SYNCTIMEOUT == error) {
+			++timeouts;
+		} else if (error) {
+			++errors;
+		} else {
+			latencies.push_back(latency);
+		}
+	}
+};
+
+/**
+ * Keep up to <depth> asynchronous requests in flight until <end> passed.
+ * Every request in flight uses its own slot of the read buffer.
+ */
+static void BenchWorker(const AdsDevice &device, const std::string &mode,
+			const uint32_t group, const uint32_t offset,
+			const size_t size, const size_t depth,
+			const std::chrono::steady_clock::time_point end,
+			BenchResult &result)
+{
+	std::vector<uint8_t> buffer(size * depth);
+	std::vector<size_t> idle;
+	for (size_t slot = 0; slot < depth; ++slot) {
+		idle.push_back(slot);
+	}
+	std::mutex mutex;
+	std::condition_variable completed;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!result.status && std::chrono::steady_clock::now() < end) {
+		completed.wait(lock, [&]() { return !idle.empty(); });
+		const auto slot = idle.back();
+		idle.pop_back();
+		lock.unlock();
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto completion = [&, slot, start](long error, uint32_t) {
+			const auto latency =
+				std::chrono::duration_cast<
+					std::chrono::microseconds>(
+					std::chrono::steady_clock::now() -
+					start)
+					.count();
+			std::lock_guard<std::mutex> guard(mutex);
+			result.Add(error, (uint32_t)latency);
+			idle.push_back(slot);
+			completed.notify_one();
+		};
+		const auto data = buffer.data() + slot * size;
+		long status;
+		if (!mode.compare("read")) {
+			status = device.ReadReqAsync(group, offset, size, data,
+						     completion);
+		} else if (!mode.compare("write")) {
+			status = device.WriteReqAsync(group, offset, size, data,
+						      completion);
+		} else {
+			status = device.ReadWriteReqAsync(group, offset, size,
+							  data, size, data,
+							  completion);
+		}
+
+		lock.lock();
+		if (status) {
+			result.status = status;
+			idle.push_back(slot);
+		}
+	}
+	completed.wait(lock, [&]() { return idle.size() == depth; });
+}
+
+static std::mutex benchNotificationMutex;
+static std::vector<std::chrono::steady_clock::time_point> benchLastSample;
+static BenchResult benchNotifications;
+
+static void BenchNotificationCallback(const AmsAddr *,
+				      const AdsNotificationHeader *,
+				      uint32_t hUser)
+{
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(benchNotificationMutex);
+	auto &last = benchLastSample[hUser];
+	if (last.time_since_epoch().count()) {
+		const auto interval =
+			std::chrono::duration_cast<std::chrono::microseconds>(
+				now - last)
+				.count();
+		benchNotifications.Add(0, (uint32_t)interval);
+	}
+	last = now;
+}
+
+/**
+ * Print the statistics of a benchmark to stdout
+ * @return non zero if any request failed or timed out
+ */
+static int BenchReport(BenchResult &result, const size_t size,
+		       const std::chrono::steady_clock::duration elapsed,
+		       const char *unit, const char *label)
+{
+	auto &samples = result.latencies;
+	std::sort(samples.begin(), samples.end());
+	const auto seconds =
+		std::chrono::duration_cast<std::chrono::duration<double> >(
+			elapsed)
+			.count();
+	const auto percentile = [&](double p) {
+		const auto i = std::min(samples.size() - 1,
+					(size_t)(p * samples.size()));
+		return samples[i];
+	};
+
+	std::cout << unit << ": " << samples.size() << '\n';
+	std::cout << "errors: " << result.errors << '\n';
+	std::cout << "timeouts: " << result.timeouts << '\n';
+	std::cout << "duration: " << seconds << " s\n";
+	std::cout << "throughput: " << samples.size() / seconds << ' ' << unit
+		  << "/s\n";
+	std::cout << "bandwidth: " << samples.size() * size / seconds / 1024
+		  << " KiB/s\n";
+	const int failed = result.errors || result.timeouts;
+	if (samples.empty()) {
+		return failed;
+	}
+	std::cout << label << " min: " << samples.front() << " us\n";
+	std::cout << label << " p50: " << percentile(0.5) << " us\n";
+	std::cout << label << " p99: " << percentile(0.99) << " us\n";
+	std::cout << label << " p99.9: " << percentile(0.999) << " us\n";
+	std::cout << label << " max: " << samples.back() << " us\n";
+	return failed;
+}
+
+int RunBench(const AmsNetId netid, const uint16_t port, const std::string &gw,
+	     bhf::Commandline &args)
+{
+	bhf::ParameterList params = {
+		{ "--cycle" }, { "--depth" },	{ "--duration" },
+		{ "--size" },  { "--threads" }, { "--timeout" },
+	};
+	args.Parse(params);
+
+	const auto mode = args.Pop<std::string>("Workload is missing");
+	const auto group = args.Pop<uint32_t>("IndexGroup is missing");
+	const auto offset = args.Pop<uint32_t>("IndexOffset is missing");
+	const auto threads =
+		std::max<size_t>(1, params.Get<size_t>("--threads", 1));
+	const auto depth =
+		std::max<size_t>(1, params.Get<size_t>("--depth", 1));
+	const auto size = params.Get<size_t>("--size", 4);
+	const auto duration =
+		std::chrono::seconds(params.Get<uint32_t>("--duration", 10));
+	const auto timeout = params.Get<uint32_t>("--timeout");
+
+	if (mode.compare("read") && mode.compare("write") &&
+	    mode.compare("readwrite") && mode.compare("notification")) {
+		LOG_ERROR(__FUNCTION__ << "(): Unknown workload '" << mode
+				       << "'\n");
+		return -1;
+	}
+
+	/* every thread uses its own AmsPort */
+	std::vector<AdsDevice> devices;
+	for (size_t i = 0; i < threads; ++i) {
+		devices.emplace_back(gw, netid,
+				     port ? port :
+					    uint16_t(AMSPORT_R0_PLC_TC3));
+		if (timeout) {
+			devices.back().SetTimeout(timeout);
+		}
+	}
+
+	if (!mode.compare("notification")) {
+		const auto cycle = params.Get<uint32_t>("--cycle", 1000);
+		const AdsNotificationAttrib attrib = {
+			(uint32_t)size, ADSTRANS_SERVERCYCLE, 0, { cycle * 10 }
+		};
+		benchLastSample.resize(threads);
+		std::vector<AdsHandle> handles;
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < threads; ++i) {
+			handles.push_back(devices[i].GetHandle(
+				group, offset, attrib,
+				&BenchNotificationCallback, (uint32_t)i));
+		}
+		std::this_thread::sleep_for(duration);
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		handles.clear();
+		std::lock_guard<std::mutex> lock(benchNotificationMutex);
+		return BenchReport(benchNotifications, size, elapsed, "samples",
+				   "interval");
+	}
+
+	std::vector<BenchResult> results(threads);
+	std::vector<std::thread> workers;
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < threads; ++i) {
+		workers.emplace_back(BenchWorker, std::cref(devices[i]),
+				     std::cref(mode), group, offset, size, depth,
+				     start + duration, std::ref(results[i]));
+	}
+	for (auto &w : workers) {
+		w.join();
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+
+	BenchResult total;
+	for (const auto &r : results) {
+		if (r.status && !total.status) {
+			total.status = r.status;
+		}
+		total.latencies.insert(total.latencies.end(),
+				       r.latencies.begin(), r.latencies.end());
+		total.errors += r.errors;
+		total.timeouts += r.timeouts;
+	}
+	if (total.status) {
+		LOG_ERROR(__FUNCTION__ << "(): failed with: 0x" << std::hex
+				       << total.status << '\n');
+		return total.status;
+	}
+	return BenchReport(total, size, elapsed, "requests", "latency");
+}
+
 int RunDCDiag(const AmsNetId netid, const uint16_t port, const std::string &gw,
 	      bhf::Commandline &args)
 {
@@ -384,15 +666,19 @@ int RunECat(const AmsNetId netid, const uint16_t port, const std::string &gw,
 int RunFile(const AmsNetId netid, const uint16_t port, const std::string &gw,
 	    bhf::Commandline &args)
 {
+	/* requests of other ports pass between the chunks of a transfer */
+	static const size_t FILE_CHUNK_SIZE = 64 * 1024;
 	const auto command = args.Pop<std::string>("file command is missing");
 	auto device = AdsDevice{ gw, netid, port ? port : uint16_t(10000) };
+	device.SetTrafficClass(bhf::ads::TRAFFIC_BULK);
 
 	if (!command.compare("read")) {
 		const auto path = args.Pop<std::string>("path is missing");
 		const AdsFile adsFile{ device, path,
 				       bhf::ads::FOPEN::READ |
 					       bhf::ads::FOPEN::BINARY |
-					       bhf::ads::FOPEN::ENSURE_DIR };
+					       bhf::ads::FOPEN::ENSURE_DIR,
+				       FILE_CHUNK_SIZE };
 		uint32_t bytesRead;
 		do {
 			std::vector<char> buf(1024 * 1024); // 1MB
@@ -413,7 +699,7 @@ int RunFile(const AmsNetId netid, const uint16_t port, const std::string &gw,
 				   bhf::ads::FOPEN::ENSURE_DIR;
 
 		const auto path = args.Pop<std::string>("path is missing");
-		const AdsFile adsFile{ device, path, flags };
+		const AdsFile adsFile{ device, path, flags, FILE_CHUNK_SIZE };
 		std::vector<char> buf(1024 * 1024); // 1MB
 		bhf::ForceBinaryInputOnWindows();
 		auto length = read(0, buf.data(), buf.size());
@@ -513,7 +799,14 @@ int RunPCIScan(const AmsNetId netid, const uint16_t port, const std::string &gw,
 int RunPLC(const AmsNetId netid, const uint16_t port, const std::string &gw,
 	   bhf::Commandline &args)
 {
-	auto device = bhf::ads::SymbolAccess{ gw, netid, port };
+	bhf::ParameterList params = {
+		{ "--symbol-cache" },
+	};
+	args.Parse(params);
+
+	auto device = bhf::ads::SymbolAccess{
+		gw, netid, port, params.Get<std::string>("--symbol-cache")
+	};
 	const auto command = args.Pop<std::string>("plc command is missing");
 
 	if (!command.compare("read-symbol")) {
@@ -527,6 +820,9 @@ int RunPLC(const AmsNetId netid, const uint16_t port, const std::string &gw,
 		return device.Write(name, value);
 	} else if (!command.compare("show-symbols")) {
 		return device.ShowSymbols(std::cout);
+	} else if (!command.compare("generate-header")) {
+		const auto prefix = args.Pop<std::string>();
+		return device.GenerateHeader(std::cout, prefix);
 	}
 	LOG_ERROR(__FUNCTION__ << "(): Unknown PLC command '" << command
 			       << "'\n");
@@ -919,6 +1215,7 @@ int ParseCommand(int argc, const char *argv[])
 	}
 
 	const auto commands = CommandMap{
+		{ "bench", RunBench },
 		{ "dc-diag", RunDCDiag },  { "ecat", RunECat },
 		{ "file", RunFile },	   { "registry", RunRegistry },
 		{ "license", RunLicense }, { "pciscan", RunPCIScan },